@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* participant threads step in lockstep on the barrier of a vector and
+ * report the mean cost of a step */
+
+#ifndef NUM_PARTICIPANTS
+#define NUM_PARTICIPANTS 6
+#endif
+
+#ifndef NUM_STEPS
+#define NUM_STEPS 100000
+#endif
+
+
+typedef struct participant {
+  const ri_vector_t *vec;
+  unsigned index;
+  uint64_t elapsed;
+} participant_t;
+
+
+static int step(void *arg)
+{
+  participant_t *participant = arg;
+
+  set_affinity(participant->index);
+
+  ri_barrier_t *barrier = ri_vector_barrier(participant->vec, participant->index);
+  if (!barrier)
+    error(-1, 0, "ri_vector_barrier failed");
+
+  uint64_t start = now_ns();
+
+  for (unsigned i = 0; i < NUM_STEPS; i++) {
+    if (ri_barrier_arrive(barrier) < 0)
+      error(-1, 0, "ri_barrier_arrive failed");
+
+    if (ri_barrier_wait(barrier, -1) < 0)
+      error(-1, 0, "ri_barrier_wait failed");
+  }
+
+  participant->elapsed = now_ns() - start;
+
+  ri_barrier_delete(barrier);
+
+  return 0;
+}
+
+
+int main()
+{
+  const ri_config_t config = {
+    .barrier_participants = NUM_PARTICIPANTS,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  participant_t participants[NUM_PARTICIPANTS];
+  thrd_t threads[NUM_PARTICIPANTS];
+
+  for (unsigned i = 0; i < NUM_PARTICIPANTS; i++) {
+    participants[i] = (participant_t) {
+      .vec = vec,
+      .index = i,
+    };
+
+    if (thrd_create(&threads[i], step, &participants[i]) != thrd_success)
+      error(-1, 0, "thrd_create failed");
+  }
+
+  for (unsigned i = 0; i < NUM_PARTICIPANTS; i++) {
+    thrd_join(threads[i], NULL);
+
+    LOG_INF("participant %u: %6.0f ns/step", i, (double)participants[i].elapsed / NUM_STEPS);
+  }
+
+  ri_vector_delete(vec);
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/connect.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a broker thread serves the registry, the main thread publishes a topic for
+ * several subscribers ahead of time, subscribes to it and reports how long
+ * each subscription took */
+
+#define BROKER_PATH "rtipc_broker.sock"
+#define TOPIC "sensor"
+#define NUM_SUBSCRIBERS 4
+
+/* each subscriber publishes, subscribes and finally looks up an unknown topic */
+#define NUM_REQUESTS (2 * NUM_SUBSCRIBERS + 1)
+
+
+typedef struct sample {
+  uint64_t seq;
+  double value;
+} sample_t;
+
+
+static int serve(void *arg)
+{
+  ri_broker_t *broker = arg;
+
+  for (unsigned i = 0; i < NUM_REQUESTS; i++) {
+    if (ri_broker_process(broker) < 0)
+      LOG_ERR("ri_broker_process failed");
+  }
+
+  return 0;
+}
+
+
+int main()
+{
+  const ri_attr_t samples[] = {
+    { .msg_size = sizeof(sample_t), .add_msgs = 2, .eventfd = true, .info = { .data = TOPIC, .size = sizeof(TOPIC) } },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = samples,
+  };
+
+  ri_broker_t *broker = ri_broker_new(BROKER_PATH, NUM_SUBSCRIBERS);
+  if (!broker)
+    error(-1, 0, "ri_broker_new failed");
+
+  thrd_t thread;
+
+  if (thrd_create(&thread, serve, broker) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  ri_producer_t *producers[NUM_SUBSCRIBERS];
+
+  for (unsigned i = 0; i < NUM_SUBSCRIBERS; i++) {
+    ri_vector_t *vec = ri_broker_publish(BROKER_PATH, TOPIC, &config);
+    if (!vec)
+      error(-1, 0, "ri_broker_publish failed");
+
+    producers[i] = ri_vector_take_producer(vec, 0);
+    ri_vector_delete(vec);
+  }
+
+  for (unsigned i = 0; i < NUM_SUBSCRIBERS; i++) {
+    uint64_t start = now_ns();
+
+    ri_vector_t *vec = ri_broker_subscribe(BROKER_PATH, TOPIC);
+
+    uint64_t elapsed = now_ns() - start;
+
+    if (!vec)
+      error(-1, 0, "ri_broker_subscribe failed");
+
+    ri_consumer_t *consumer = ri_vector_take_consumer(vec, 0);
+    ri_vector_delete(vec);
+
+    sample_t *sample = ri_producer_msg(producers[i]);
+    *sample = (sample_t) { .seq = i, .value = 0.5 * i };
+    ri_producer_force_push(producers[i]);
+
+    if (ri_consumer_pop(consumer) != RI_POP_RESULT_SUCCESS)
+      error(-1, 0, "subscriber %u got no message", i);
+
+    const sample_t *received = ri_consumer_msg(consumer);
+    ri_info_t info = ri_consumer_info(consumer);
+
+    LOG_INF("subscriber %u: topic=%s seq=%llu subscribe=%llu ns", i, (const char*)info.data,
+            (unsigned long long)received->seq, (unsigned long long)elapsed);
+
+    ri_consumer_delete(consumer);
+  }
+
+  if (ri_broker_subscribe(BROKER_PATH, "unknown"))
+    error(-1, 0, "unknown topic was found");
+
+  thrd_join(thread, NULL);
+
+  for (unsigned i = 0; i < NUM_SUBSCRIBERS; i++)
+    ri_producer_delete(producers[i]);
+
+  ri_broker_delete(broker);
+
+  return 0;
+}
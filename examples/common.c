@@ -0,0 +1,119 @@
+#define _GNU_SOURCE
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+
+#include "rtipc/log.h"
+
+#define MAX_FDS 16
+#define PATTERN_MUL UINT64_C(0x9e3779b97f4a7c15)
+
+
+void set_affinity(int cpu)
+{
+  if (cpu < 0)
+    return;
+
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  if (sched_setaffinity(0, sizeof(set), &set) < 0)
+    LOG_WRN("set_affinity cpu=%d failed errno=%d", cpu, errno);
+}
+
+
+uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+    error(-1, errno, "clock_gettime failed");
+
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/* the peer gets descriptors of its own, as if passed over a socket */
+static int serialize(const ri_vector_t *vec, void *req, size_t size, int fds[], unsigned *n_fds)
+{
+  if (ri_vector_serialize(vec, req, size, fds, n_fds) < 0)
+    return -1;
+
+  for (unsigned i = 0; i < *n_fds; i++)
+    fds[i] = dup(fds[i]);
+
+  return 0;
+}
+
+
+ri_vector_t* vector_peer(const ri_vector_t *vec)
+{
+  int fds[MAX_FDS];
+  unsigned n_fds = MAX_FDS;
+  size_t size = ri_vector_serialize_size(vec);
+
+  void *req = malloc(size);
+  if (!req)
+    return NULL;
+
+  ri_vector_t *peer = NULL;
+
+  if (serialize(vec, req, size, fds, &n_fds) < 0)
+    goto out;
+
+  peer = ri_vector_deserialize(req, size, fds, &n_fds);
+
+out:
+  free(req);
+  return peer;
+}
+
+
+ri_vector_t* vector_peer_init(const ri_vector_t *vec, void *req, size_t req_size,
+                              void *storage, size_t storage_size)
+{
+  int fds[MAX_FDS];
+  unsigned n_fds = MAX_FDS;
+  size_t size = ri_vector_serialize_size(vec);
+
+  if (size > req_size)
+    return NULL;
+
+  if (serialize(vec, req, size, fds, &n_fds) < 0)
+    return NULL;
+
+  return ri_vector_deserialize_init(req, size, fds, &n_fds, storage, storage_size);
+}
+
+
+void pattern_fill(void *msg, size_t size, uint64_t seq)
+{
+  uint64_t *words = msg;
+
+  words[0] = seq;
+
+  for (size_t i = 1; i < size / sizeof(uint64_t); i++)
+    words[i] = seq ^ (i * PATTERN_MUL);
+}
+
+
+uint64_t pattern_check(const void *msg, size_t size)
+{
+  const uint64_t *words = msg;
+  uint64_t seq = words[0];
+
+  for (size_t i = 1; i < size / sizeof(uint64_t); i++) {
+    if (words[i] != (seq ^ (i * PATTERN_MUL)))
+      return 0;
+  }
+
+  return seq;
+}
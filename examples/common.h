@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtipc/rtipc.h"
+
+/* pins the calling thread to cpu, a negative cpu keeps the affinity */
+void set_affinity(int cpu);
+
+/* monotonic clock in nanoseconds */
+uint64_t now_ns(void);
+
+/* maps the vector a second time, like the server would do */
+ri_vector_t* vector_peer(const ri_vector_t *vec);
+
+/* like vector_peer, with the request and the peer in caller-provided storage */
+ri_vector_t* vector_peer_init(const ri_vector_t *vec, void *req, size_t req_size,
+                              void *storage, size_t storage_size);
+
+/* fills a message of whole 64-bit words with a pattern derived from seq, seq > 0 */
+void pattern_fill(void *msg, size_t size, uint64_t seq);
+
+/* returns the seq of a message filled by pattern_fill, 0 if the pattern is broken */
+uint64_t pattern_check(const void *msg, size_t size);
@@ -0,0 +1,172 @@
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a writer thread updates the entries of a conflating table, mostly a few
+ * hot keys, while the reader takes updated keys and reads their entries.
+ * Every read must be intact, belong to its key and be at least as new as
+ * the previous read of the key, and the reader must end up with the last
+ * update of every key.
+ * Exits with a non-zero status on a violation. */
+
+#ifndef NUM_UPDATES
+#define NUM_UPDATES 1000000
+#endif
+
+#define NUM_KEYS 257
+#define NUM_HOT_KEYS 8
+#define ENTRY_SIZE 64
+
+
+typedef struct writer {
+  ri_table_t *table;
+  uint64_t versions[NUM_KEYS];
+  atomic_bool done;
+} writer_t;
+
+
+/* the pattern encodes key and version, versions start at 1 */
+static uint64_t entry_seq(unsigned key, uint64_t version)
+{
+  return version * NUM_KEYS + key;
+}
+
+
+static int writer_entry(void *arg)
+{
+  writer_t *writer = arg;
+  alignas(8) uint8_t entry[ENTRY_SIZE];
+  unsigned rnd = 1;
+
+  for (unsigned i = 1; i <= NUM_UPDATES; i++) {
+    rnd = rnd * 1103515245 + 12345;
+
+    unsigned key = ((rnd >> 16) % 8 == 0) ? (rnd >> 4) % NUM_KEYS : (rnd >> 8) % NUM_HOT_KEYS;
+    uint64_t seq = entry_seq(key, ++writer->versions[key]);
+
+    /* in place and copied updates */
+    if (i & 1) {
+      void *dst = ri_table_write_begin(writer->table, key);
+      if (!dst)
+        error(-1, 0, "ri_table_write_begin failed");
+
+      pattern_fill(dst, ENTRY_SIZE, seq);
+      ri_table_write_end(writer->table, key);
+    } else {
+      pattern_fill(entry, ENTRY_SIZE, seq);
+
+      if (ri_table_write(writer->table, key, entry) < 0)
+        error(-1, 0, "ri_table_write failed");
+    }
+
+    /* lets the reader interleave on machines with few cores */
+    if ((i % 64) == 0)
+      thrd_yield();
+  }
+
+  atomic_store_explicit(&writer->done, true, memory_order_release);
+
+  return 0;
+}
+
+
+int main()
+{
+  const ri_table_attr_t tables[] = {
+    { .entry_size = ENTRY_SIZE, .n_entries = NUM_KEYS, .conflate = true },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .table_writers = tables,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  static writer_t writer;
+
+  writer.table = ri_vector_take_table_writer(vec, 0);
+
+  ri_table_t *reader = ri_vector_take_table_reader(peer, 0);
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  thrd_t thread;
+
+  if (thrd_create(&thread, writer_entry, &writer) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  alignas(8) uint8_t entry[ENTRY_SIZE];
+  uint64_t versions[NUM_KEYS] = { 0 };
+  uint64_t pops = 0;
+  uint64_t retries = 0;
+
+  for (;;) {
+    bool done = atomic_load_explicit(&writer.done, memory_order_acquire);
+
+    int key = ri_table_pop(reader);
+
+    if (key == -ENOENT) {
+      if (done)
+        break;
+
+      thrd_yield();
+      continue;
+    }
+
+    if (key < 0)
+      error(-1, -key, "ri_table_pop failed");
+
+    int r;
+
+    while ((r = ri_table_read(reader, key, entry)) == -EAGAIN)
+      retries++;
+
+    if (r < 0)
+      error(-1, -r, "ri_table_read failed");
+
+    uint64_t seq = pattern_check(entry, ENTRY_SIZE);
+    if ((seq == 0) || (seq % NUM_KEYS != (unsigned)key))
+      error(-1, 0, "corrupted entry of key %d", key);
+
+    uint64_t version = seq / NUM_KEYS;
+    if (version < versions[key])
+      error(-1, 0, "key %d went back from version %llu to %llu", key,
+            (unsigned long long)versions[key], (unsigned long long)version);
+
+    versions[key] = version;
+    pops++;
+  }
+
+  thrd_join(thread, NULL);
+
+  for (unsigned key = 0; key < NUM_KEYS; key++) {
+    if (versions[key] != writer.versions[key])
+      error(-1, 0, "key %u ended at version %llu, expected %llu", key,
+            (unsigned long long)versions[key], (unsigned long long)writer.versions[key]);
+  }
+
+  LOG_INF("%u updates conflated into %llu pops, %llu read retries",
+          NUM_UPDATES, (unsigned long long)pops, (unsigned long long)retries);
+
+  ri_table_delete(writer.table);
+  ri_table_delete(reader);
+
+  return 0;
+}
@@ -0,0 +1,174 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* compares the write-back paths of the producer cache (plain memcpy,
+ * temporal SIMD and non-temporal streaming stores) across message sizes,
+ * while a consumer on another core reads every cacheline of each message */
+
+#ifndef SEND_NUM_BYTES
+#define SEND_NUM_BYTES (UINT64_C(4) << 30)
+#endif
+
+#ifndef CPU_PRODUCER
+#define CPU_PRODUCER 0
+#endif
+
+#ifndef CPU_CONSUMER
+#define CPU_CONSUMER 2
+#endif
+
+#define CACHELINE 64
+
+
+typedef struct bench {
+  ri_producer_t *producer;
+  ri_consumer_t *consumer;
+  size_t msg_size;
+  atomic_bool done;
+  uint64_t received;
+  uint64_t checksum;
+} bench_t;
+
+
+static int consumer_entry(void *arg)
+{
+  bench_t *bench = arg;
+
+  set_affinity(CPU_CONSUMER);
+
+  while (!atomic_load_explicit(&bench->done, memory_order_relaxed)) {
+    ri_pop_result_t r = ri_consumer_pop(bench->consumer);
+
+    if (r < RI_POP_RESULT_SUCCESS)
+      continue;
+
+    const uint8_t *msg = ri_consumer_msg(bench->consumer);
+
+    for (size_t i = 0; i < bench->msg_size; i += CACHELINE)
+      bench->checksum += msg[i];
+
+    bench->received++;
+  }
+
+  return 0;
+}
+
+
+static void produce(bench_t *bench, uint64_t n_msgs)
+{
+  for (uint64_t counter = 0; counter < n_msgs; counter++) {
+    uint8_t *msg = ri_producer_msg(bench->producer);
+
+    memcpy(msg, &counter, sizeof(counter));
+
+    ri_producer_force_push(bench->producer);
+  }
+}
+
+
+static int run(size_t msg_size, ri_copy_mode_t mode, const char *name)
+{
+  const ri_attr_t producers[] = {
+    { .add_msgs = 1, .msg_size = msg_size, .cache = true },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = producers,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    goto fail_vec;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    goto fail_peer;
+
+  bench_t bench = {
+    .producer = ri_vector_take_producer(vec, 0),
+    .consumer = ri_vector_take_consumer(peer, 0),
+    .msg_size = msg_size,
+  };
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  if (ri_producer_set_copy_mode(bench.producer, mode) < 0)
+    goto fail_mode;
+
+  if (ri_producer_cache_enable(bench.producer) < 0)
+    goto fail_mode;
+
+  /* the whole message is part of the producer's working set */
+  memset(ri_producer_msg(bench.producer), 0x5a, msg_size);
+
+  set_affinity(CPU_PRODUCER);
+
+  thrd_t consumer;
+
+  if (thrd_create(&consumer, consumer_entry, &bench) != thrd_success)
+    goto fail_mode;
+
+  uint64_t n_msgs = SEND_NUM_BYTES / msg_size;
+  uint64_t start = now_ns();
+
+  produce(&bench, n_msgs);
+
+  uint64_t elapsed = now_ns() - start;
+
+  atomic_store_explicit(&bench.done, true, memory_order_relaxed);
+  thrd_join(consumer, NULL);
+
+  LOG_INF("msg_size=%8zu %-9s: %9.1f ns/push %8.1f MB/s, consumer received %llu",
+          msg_size, name, (double)elapsed / n_msgs,
+          (double)n_msgs * msg_size / elapsed * 1000.0,
+          (unsigned long long)bench.received);
+
+  ri_producer_delete(bench.producer);
+  ri_consumer_delete(bench.consumer);
+
+  return 0;
+
+fail_mode:
+  ri_producer_delete(bench.producer);
+  ri_consumer_delete(bench.consumer);
+  return -1;
+fail_peer:
+  ri_vector_delete(vec);
+fail_vec:
+  return -1;
+}
+
+
+int main()
+{
+  static const size_t sizes[] = { 1024, 4096, 16384, 65536, 262144, 1048576 };
+
+  static const struct {
+    ri_copy_mode_t mode;
+    const char *name;
+  } modes[] = {
+    { RI_COPY_PLAIN, "plain" },
+    { RI_COPY_TEMPORAL, "temporal" },
+    { RI_COPY_STREAMING, "streaming" },
+  };
+
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (unsigned m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+      if (run(sizes[i], modes[m].mode, modes[m].name) < 0)
+        return -1;
+    }
+  }
+
+  return 0;
+}
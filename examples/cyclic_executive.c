@@ -0,0 +1,164 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a sensor thread pushes samples at its own pace, the main thread runs a
+ * 1 ms cyclic executive that filters the newest sample and publishes the
+ * result, then reports the timing statistics */
+
+#ifndef PERIOD_NS
+#define PERIOD_NS 1000000
+#endif
+
+#ifndef NUM_CYCLES
+#define NUM_CYCLES 2000
+#endif
+
+
+typedef struct sample {
+  uint64_t seq;
+  double value;
+} sample_t;
+
+
+typedef struct filter {
+  ri_cycle_t *cycle;
+  ri_consumer_t *input;
+  ri_producer_t *output;
+  double state;
+  uint64_t updates;
+} filter_t;
+
+
+typedef struct sensor {
+  ri_producer_t *producer;
+  atomic_bool run;
+} sensor_t;
+
+
+static int sense(void *arg)
+{
+  sensor_t *sensor = arg;
+
+  for (uint64_t seq = 0; atomic_load_explicit(&sensor->run, memory_order_relaxed); seq++) {
+    sample_t *sample = ri_producer_msg(sensor->producer);
+
+    *sample = (sample_t) { .seq = seq, .value = (double)(seq % 100) };
+
+    ri_producer_force_push(sensor->producer);
+
+    usleep(300);
+  }
+
+  return 0;
+}
+
+
+static int compute(void *arg, uint64_t number)
+{
+  filter_t *filter = arg;
+
+  (void)number;
+
+  if (!ri_cycle_updated(filter->cycle, 0))
+    return 0;
+
+  const sample_t *sample = ri_consumer_msg(filter->input);
+
+  filter->state = 0.9 * filter->state + 0.1 * sample->value;
+  filter->updates++;
+
+  sample_t *result = ri_producer_msg(filter->output);
+
+  *result = (sample_t) { .seq = sample->seq, .value = filter->state };
+
+  return ri_cycle_publish(filter->cycle, 0);
+}
+
+
+int main()
+{
+  const ri_attr_t channels[] = {
+    { .msg_size = sizeof(sample_t), .add_msgs = 2 },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = channels,
+    .consumers = channels,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  sensor_t sensor = {
+    .producer = ri_vector_take_producer(vec, 0),
+    .run = true,
+  };
+
+  ri_consumer_t *output = ri_vector_take_consumer(vec, 0);
+
+  filter_t filter = {
+    .input = ri_vector_take_consumer(peer, 0),
+    .output = ri_vector_take_producer(peer, 0),
+  };
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  filter.cycle = ri_cycle_new(PERIOD_NS, &filter.input, 1, &filter.output, 1);
+  if (!filter.cycle)
+    error(-1, 0, "ri_cycle_new failed");
+
+  thrd_t thread;
+
+  if (thrd_create(&thread, sense, &sensor) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  int r = ri_cycle_run(filter.cycle, compute, &filter, NUM_CYCLES);
+  if (r < 0)
+    error(-1, -r, "ri_cycle_run failed");
+
+  atomic_store(&sensor.run, false);
+  thrd_join(thread, NULL);
+
+  if (ri_consumer_flush(output) > RI_POP_RESULT_NO_UPDATE) {
+    const sample_t *result = ri_consumer_msg(output);
+    LOG_INF("last result seq=%llu value=%.2f", (unsigned long long)result->seq, result->value);
+  }
+
+  ri_cycle_stats_t stats;
+
+  ri_cycle_stats(filter.cycle, &stats);
+
+  LOG_INF("cycles=%llu updates=%llu missed=%llu overruns=%llu",
+          (unsigned long long)stats.cycles, (unsigned long long)filter.updates,
+          (unsigned long long)stats.missed, (unsigned long long)stats.overruns);
+  LOG_INF("latency min=%llu mean=%.0f max=%llu ns, jitter=%llu ns",
+          (unsigned long long)stats.latency_min, (double)stats.latency_sum / stats.cycles,
+          (unsigned long long)stats.latency_max,
+          (unsigned long long)(stats.latency_max - stats.latency_min));
+  LOG_INF("execution mean=%.0f max=%llu ns",
+          (double)stats.exec_sum / stats.cycles, (unsigned long long)stats.exec_max);
+
+  ri_cycle_delete(filter.cycle);
+  ri_producer_delete(sensor.producer);
+  ri_consumer_delete(output);
+  ri_consumer_delete(filter.input);
+  ri_producer_delete(filter.output);
+
+  return 0;
+}
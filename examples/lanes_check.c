@@ -0,0 +1,163 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a producer thread pushes bulk traffic into the lowest lane of a channel
+ * and numbered messages of their own into the higher lanes, while the
+ * consumer checks that every message is intact, arrives in the lane it
+ * was pushed to and in order within its lane, and that the last message
+ * of every lane arrives.
+ * Exits with a non-zero status on a violation. */
+
+#ifndef NUM_MSGS
+#define NUM_MSGS 200000
+#endif
+
+#define NUM_LANES 3
+#define MSG_SIZE 64
+
+
+typedef struct producer {
+  ri_producer_t *producer;
+  /* last number pushed to every lane */
+  uint64_t pushed[NUM_LANES];
+  atomic_bool done;
+} producer_t;
+
+
+/* the pattern encodes lane and number, numbers start at 1 */
+static uint64_t msg_seq(unsigned lane, uint64_t number)
+{
+  return number * NUM_LANES + lane;
+}
+
+
+static int producer_entry(void *arg)
+{
+  producer_t *producer = arg;
+  uint64_t numbers[NUM_LANES] = { 0 };
+  unsigned rnd = 1;
+
+  for (unsigned i = 1; i <= NUM_MSGS; i++) {
+    rnd = rnd * 1103515245 + 12345;
+
+    unsigned lane = ((rnd >> 16) % 4 == 0) ? 1 + (rnd >> 8) % (NUM_LANES - 1) : 0;
+    uint64_t number = ++numbers[lane];
+
+    if (ri_producer_select_lane(producer->producer, lane) < 0)
+      error(-1, 0, "ri_producer_select_lane failed");
+
+    pattern_fill(ri_producer_msg(producer->producer), MSG_SIZE, msg_seq(lane, number));
+
+    /* the newest pushed message of a lane is never discarded */
+    if (i & 1) {
+      if (ri_producer_force_push(producer->producer) == RI_FORCE_PUSH_RESULT_ERROR)
+        error(-1, 0, "ri_producer_force_push failed");
+
+      producer->pushed[lane] = number;
+    } else if (ri_producer_try_push(producer->producer) == RI_TRY_PUSH_RESULT_SUCCESS) {
+      producer->pushed[lane] = number;
+    }
+
+    /* lets the consumer interleave on machines with few cores */
+    if ((i % 64) == 0)
+      thrd_yield();
+  }
+
+  atomic_store_explicit(&producer->done, true, memory_order_release);
+
+  return 0;
+}
+
+
+int main()
+{
+  const ri_attr_t channels[] = {
+    { .msg_size = MSG_SIZE, .add_msgs = 2, .lanes = NUM_LANES },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = channels,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  static producer_t producer;
+
+  producer.producer = ri_vector_take_producer(vec, 0);
+
+  ri_consumer_t *consumer = ri_vector_take_consumer(peer, 0);
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  thrd_t thread;
+
+  if (thrd_create(&thread, producer_entry, &producer) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  uint64_t last[NUM_LANES] = { 0 };
+  uint64_t received[NUM_LANES] = { 0 };
+
+  for (;;) {
+    bool done = atomic_load_explicit(&producer.done, memory_order_acquire);
+
+    ri_pop_result_t r = ri_consumer_pop(consumer);
+    if (r == RI_POP_RESULT_ERROR)
+      error(-1, 0, "ri_consumer_pop failed");
+
+    if (r < RI_POP_RESULT_SUCCESS) {
+      if (done)
+        break;
+
+      thrd_yield();
+      continue;
+    }
+
+    unsigned lane = ri_consumer_lane(consumer);
+    if (lane >= NUM_LANES)
+      error(-1, 0, "message in lane %u", lane);
+
+    uint64_t seq = pattern_check(ri_consumer_msg(consumer), MSG_SIZE);
+    if ((seq == 0) || (seq % NUM_LANES != lane))
+      error(-1, 0, "corrupted message in lane %u after %llu", lane, (unsigned long long)last[lane]);
+
+    uint64_t number = seq / NUM_LANES;
+    if (number <= last[lane])
+      error(-1, 0, "message %llu after %llu in lane %u", (unsigned long long)number,
+            (unsigned long long)last[lane], lane);
+
+    last[lane] = number;
+    received[lane]++;
+  }
+
+  thrd_join(thread, NULL);
+
+  for (unsigned lane = 0; lane < NUM_LANES; lane++) {
+    if (last[lane] != producer.pushed[lane])
+      error(-1, 0, "last message %llu in lane %u, expected %llu", (unsigned long long)last[lane],
+            lane, (unsigned long long)producer.pushed[lane]);
+
+    LOG_INF("lane %u: received %llu messages up to %llu intact and in order", lane,
+            (unsigned long long)received[lane], (unsigned long long)producer.pushed[lane]);
+  }
+
+  ri_producer_delete(producer.producer);
+  ri_consumer_delete(consumer);
+
+  return 0;
+}
@@ -0,0 +1,197 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <errno.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a producer thread pushes numbered messages while the consumer keeps a
+ * sliding window of leased messages, releasing them in random order, and
+ * checks that popped messages arrive in order and leased ones stay intact
+ * until they are released.
+ * Exits with a non-zero status on a corrupted, changed or reordered message. */
+
+#ifndef NUM_MSGS
+#define NUM_MSGS 200000
+#endif
+
+#define MSG_SIZE 128
+#define MAX_LEASES 4
+
+
+typedef struct producer {
+  ri_producer_t *producer;
+  atomic_bool done;
+} producer_t;
+
+
+typedef struct window {
+  int ids[MAX_LEASES];
+  uint64_t seqs[MAX_LEASES];
+  unsigned n;
+} window_t;
+
+
+static int producer_entry(void *arg)
+{
+  producer_t *producer = arg;
+
+  for (uint64_t seq = 1; seq <= NUM_MSGS; seq++) {
+    pattern_fill(ri_producer_msg(producer->producer), MSG_SIZE, seq);
+
+    /* a full queue makes the producer take the spare slots of leased messages */
+    if ((seq & 1) || (seq == NUM_MSGS))
+      ri_producer_force_push(producer->producer);
+    else
+      ri_producer_try_push(producer->producer);
+
+    /* lets the consumer interleave on machines with few cores */
+    if ((seq % 64) == 0)
+      thrd_yield();
+  }
+
+  atomic_store_explicit(&producer->done, true, memory_order_release);
+
+  return 0;
+}
+
+
+static void window_release(ri_consumer_t *consumer, window_t *window, unsigned i)
+{
+  int r = ri_consumer_release(consumer, window->ids[i]);
+  if (r < 0)
+    error(-1, -r, "ri_consumer_release failed");
+
+  window->n--;
+  memmove(&window->ids[i], &window->ids[i + 1], (window->n - i) * sizeof(window->ids[0]));
+  memmove(&window->seqs[i], &window->seqs[i + 1], (window->n - i) * sizeof(window->seqs[0]));
+}
+
+
+static void window_check(const ri_consumer_t *consumer, const window_t *window)
+{
+  for (unsigned i = 0; i < window->n; i++) {
+    const void *msg = ri_consumer_lease_msg(consumer, window->ids[i]);
+
+    if (!msg || (pattern_check(msg, MSG_SIZE) != window->seqs[i]))
+      error(-1, 0, "leased message %llu changed", (unsigned long long)window->seqs[i]);
+  }
+}
+
+
+int main()
+{
+  const ri_attr_t channels[] = {
+    { .msg_size = MSG_SIZE, .add_msgs = 1, .max_leases = MAX_LEASES },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = channels,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  producer_t producer = {
+    .producer = ri_vector_take_producer(vec, 0),
+  };
+
+  ri_consumer_t *consumer = ri_vector_take_consumer(peer, 0);
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  thrd_t thread;
+
+  if (thrd_create(&thread, producer_entry, &producer) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  window_t window = { .n = 0 };
+  uint64_t last = 0;
+  uint64_t received = 0;
+  uint64_t leased = 0;
+  unsigned rnd = 1;
+
+  for (;;) {
+    bool done = atomic_load_explicit(&producer.done, memory_order_acquire);
+
+    ri_pop_result_t r = ri_consumer_pop(consumer);
+    if (r == RI_POP_RESULT_ERROR)
+      error(-1, 0, "ri_consumer_pop failed");
+
+    if (r < RI_POP_RESULT_SUCCESS) {
+      if (done)
+        break;
+
+      thrd_yield();
+      continue;
+    }
+
+    uint64_t seq = pattern_check(ri_consumer_msg(consumer), MSG_SIZE);
+    if (seq == 0)
+      error(-1, 0, "corrupted message after %llu", (unsigned long long)last);
+
+    if (seq <= last)
+      error(-1, 0, "message %llu after %llu", (unsigned long long)seq, (unsigned long long)last);
+
+    last = seq;
+    received++;
+
+    window_check(consumer, &window);
+
+    /* releases the oldest lease of a full window, or a random one now and then */
+    rnd = rnd * 1103515245 + 12345;
+
+    if (window.n == MAX_LEASES)
+      window_release(consumer, &window, 0);
+    else if ((window.n > 0) && ((rnd >> 16) % 3 == 0))
+      window_release(consumer, &window, (rnd >> 8) % window.n);
+
+    int id = ri_consumer_lease(consumer);
+
+    /* the slot of a released lease returns with the producer's next push */
+    if (id == -EBUSY)
+      continue;
+
+    if (id < 0)
+      error(-1, -id, "ri_consumer_lease failed");
+
+    if (ri_consumer_lease(consumer) != -EALREADY)
+      error(-1, 0, "message %llu leased twice", (unsigned long long)seq);
+
+    window.ids[window.n] = id;
+    window.seqs[window.n] = seq;
+    window.n++;
+    leased++;
+  }
+
+  thrd_join(thread, NULL);
+
+  window_check(consumer, &window);
+
+  while (window.n > 0)
+    window_release(consumer, &window, 0);
+
+  if (last != NUM_MSGS)
+    error(-1, 0, "last message %llu, expected %u", (unsigned long long)last, NUM_MSGS);
+
+  LOG_INF("received %llu of %u messages in order, %llu leases stayed intact",
+          (unsigned long long)received, NUM_MSGS, (unsigned long long)leased);
+
+  ri_producer_delete(producer.producer);
+  ri_consumer_delete(consumer);
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a producer thread pushes numbered messages while the consumer takes them
+ * alternately with ri_consumer_pop and ri_consumer_pop_into, and checks
+ * that they arrive intact and in order and that the private copies stay
+ * intact after their slots were handed back to the producer.
+ * Exits with a non-zero status on a corrupted or reordered message. */
+
+#ifndef NUM_MSGS
+#define NUM_MSGS 200000
+#endif
+
+#define MSG_SIZE 512
+
+
+typedef struct producer {
+  ri_producer_t *producer;
+  atomic_bool done;
+} producer_t;
+
+
+static int producer_entry(void *arg)
+{
+  producer_t *producer = arg;
+
+  for (uint64_t seq = 1; seq <= NUM_MSGS; seq++) {
+    pattern_fill(ri_producer_msg(producer->producer), MSG_SIZE, seq);
+
+    if ((seq & 1) || (seq == NUM_MSGS))
+      ri_producer_force_push(producer->producer);
+    else
+      ri_producer_try_push(producer->producer);
+
+    /* lets the consumer interleave on machines with few cores */
+    if ((seq % 64) == 0)
+      thrd_yield();
+  }
+
+  atomic_store_explicit(&producer->done, true, memory_order_release);
+
+  return 0;
+}
+
+
+int main()
+{
+  const ri_attr_t channels[] = {
+    { .msg_size = MSG_SIZE, .add_msgs = 1 },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = channels,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  producer_t producer = {
+    .producer = ri_vector_take_producer(vec, 0),
+  };
+
+  ri_consumer_t *consumer = ri_vector_take_consumer(peer, 0);
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  thrd_t thread;
+
+  if (thrd_create(&thread, producer_entry, &producer) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  static alignas(64) uint8_t buf[MSG_SIZE];
+  uint64_t last = 0;
+  uint64_t received = 0;
+  uint64_t copied = 0;
+
+  for (uint64_t i = 0;; i++) {
+    bool done = atomic_load_explicit(&producer.done, memory_order_acquire);
+    bool into = i & 1;
+
+    ri_pop_result_t r = into ? ri_consumer_pop_into(consumer, buf, sizeof(buf))
+                             : ri_consumer_pop(consumer);
+    if (r == RI_POP_RESULT_ERROR)
+      error(-1, 0, "popping failed");
+
+    if (r < RI_POP_RESULT_SUCCESS) {
+      if (done)
+        break;
+
+      thrd_yield();
+      continue;
+    }
+
+    if (into && ri_consumer_msg(consumer))
+      error(-1, 0, "the consumer still holds a slot after ri_consumer_pop_into");
+
+    const void *msg = into ? buf : ri_consumer_msg(consumer);
+
+    uint64_t seq = pattern_check(msg, MSG_SIZE);
+    if (seq == 0)
+      error(-1, 0, "corrupted message after %llu", (unsigned long long)last);
+
+    if (seq <= last)
+      error(-1, 0, "message %llu after %llu", (unsigned long long)seq, (unsigned long long)last);
+
+    last = seq;
+    received++;
+
+    if (!into)
+      continue;
+
+    /* the producer may reuse the slot by now, the copy is ours */
+    thrd_yield();
+
+    if (pattern_check(buf, MSG_SIZE) != seq)
+      error(-1, 0, "copy of message %llu changed", (unsigned long long)seq);
+
+    copied++;
+  }
+
+  thrd_join(thread, NULL);
+
+  if (last != NUM_MSGS)
+    error(-1, 0, "last message %llu, expected %u", (unsigned long long)last, NUM_MSGS);
+
+  LOG_INF("received %llu of %u messages intact and in order, %llu copied out",
+          (unsigned long long)received, NUM_MSGS, (unsigned long long)copied);
+
+  ri_producer_delete(producer.producer);
+  ri_consumer_delete(consumer);
+
+  return 0;
+}
@@ -0,0 +1,169 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* measures the effect of prefetching the next message slot on both sides.
+ * The producer writes every message in place and the consumer reads every
+ * cacheline of it. Choose CPU_PRODUCER and CPU_CONSUMER on different
+ * sockets to see the cross-socket case. */
+
+#ifndef SEND_NUM_BYTES
+#define SEND_NUM_BYTES (UINT64_C(4) << 30)
+#endif
+
+#ifndef CPU_PRODUCER
+#define CPU_PRODUCER 0
+#endif
+
+#ifndef CPU_CONSUMER
+#define CPU_CONSUMER 2
+#endif
+
+#define CACHELINE 64
+#define N_MSGS 4
+
+
+typedef struct bench {
+  ri_producer_t *producer;
+  ri_consumer_t *consumer;
+  size_t msg_size;
+  atomic_bool done;
+  uint64_t received;
+  uint64_t consume_ns;
+  uint64_t checksum;
+} bench_t;
+
+
+static int consumer_entry(void *arg)
+{
+  bench_t *bench = arg;
+
+  set_affinity(CPU_CONSUMER);
+
+  while (!atomic_load_explicit(&bench->done, memory_order_relaxed)) {
+    uint64_t start = now_ns();
+    ri_pop_result_t r = ri_consumer_pop(bench->consumer);
+
+    if (r < RI_POP_RESULT_SUCCESS)
+      continue;
+
+    const uint8_t *msg = ri_consumer_msg(bench->consumer);
+
+    for (size_t i = 0; i < bench->msg_size; i += CACHELINE)
+      bench->checksum += msg[i];
+
+    bench->consume_ns += now_ns() - start;
+    bench->received++;
+  }
+
+  return 0;
+}
+
+
+static void produce(bench_t *bench, uint64_t n_msgs)
+{
+  for (uint64_t counter = 0; counter < n_msgs; counter++) {
+    uint8_t *msg = ri_producer_msg(bench->producer);
+
+    for (size_t i = 0; i < bench->msg_size; i += CACHELINE)
+      msg[i] = counter;
+
+    ri_producer_force_push(bench->producer);
+  }
+}
+
+
+static int run(size_t msg_size, size_t distance)
+{
+  const ri_attr_t producers[] = {
+    { .add_msgs = N_MSGS, .msg_size = msg_size },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = producers,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    goto fail_vec;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    goto fail_peer;
+
+  bench_t bench = {
+    .producer = ri_vector_take_producer(vec, 0),
+    .consumer = ri_vector_take_consumer(peer, 0),
+    .msg_size = msg_size,
+  };
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  ri_producer_set_prefetch(bench.producer, distance);
+  ri_consumer_set_prefetch(bench.consumer, distance);
+
+  set_affinity(CPU_PRODUCER);
+
+  thrd_t consumer;
+
+  if (thrd_create(&consumer, consumer_entry, &bench) != thrd_success)
+    goto fail_thread;
+
+  uint64_t n_msgs = SEND_NUM_BYTES / msg_size;
+  uint64_t start = now_ns();
+
+  produce(&bench, n_msgs);
+
+  uint64_t elapsed = now_ns() - start;
+
+  atomic_store_explicit(&bench.done, true, memory_order_relaxed);
+  thrd_join(consumer, NULL);
+
+  LOG_INF("msg_size=%8zu prefetch=%8zu: producer %9.1f ns/push, consumer %9.1f ns/msg, received %llu",
+          msg_size, distance < msg_size ? distance : msg_size, (double)elapsed / n_msgs,
+          bench.received ? (double)bench.consume_ns / bench.received : 0.0,
+          (unsigned long long)bench.received);
+
+  ri_producer_delete(bench.producer);
+  ri_consumer_delete(bench.consumer);
+
+  return 0;
+
+fail_thread:
+  ri_producer_delete(bench.producer);
+  ri_consumer_delete(bench.consumer);
+  return -1;
+fail_peer:
+  ri_vector_delete(vec);
+fail_vec:
+  return -1;
+}
+
+
+int main()
+{
+  static const size_t sizes[] = { 4096, 16384, 65536, 262144, 1048576 };
+  static const size_t distances[] = { 0, 1024, 4096, 16384, SIZE_MAX };
+
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (unsigned d = 0; d < sizeof(distances) / sizeof(distances[0]); d++) {
+      if ((d > 1) && (distances[d - 1] >= sizes[i]))
+        break;
+
+      if (run(sizes[i], distances[d]) < 0)
+        return -1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,201 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a source thread pushes numbered messages into a relay channel, a relay
+ * thread forwards them without copying into a second relay channel and the
+ * main thread checks that they arrive intact and in order.
+ * Exits with a non-zero status on a corrupted or reordered message. */
+
+#ifndef NUM_MSGS
+#define NUM_MSGS 200000
+#endif
+
+#define MSG_SIZE 256
+
+
+typedef struct source {
+  ri_producer_t *producer;
+  atomic_bool done;
+} source_t;
+
+
+typedef struct relay {
+  ri_consumer_t *consumer;
+  ri_producer_t *producer;
+  source_t *source;
+  atomic_bool done;
+  uint64_t relayed;
+} relay_t;
+
+
+static int source_entry(void *arg)
+{
+  source_t *source = arg;
+
+  for (uint64_t seq = 1; seq <= NUM_MSGS; seq++) {
+    pattern_fill(ri_producer_msg(source->producer), MSG_SIZE, seq);
+
+    /* a failed try push leaves the message to be overwritten by the next one */
+    if ((seq & 1) || (seq == NUM_MSGS))
+      ri_producer_force_push(source->producer);
+    else
+      ri_producer_try_push(source->producer);
+
+    /* lets the other threads interleave on machines with few cores */
+    if ((seq % 64) == 0)
+      thrd_yield();
+  }
+
+  atomic_store_explicit(&source->done, true, memory_order_release);
+
+  return 0;
+}
+
+
+static int relay_entry(void *arg)
+{
+  relay_t *relay = arg;
+  uint64_t last = 0;
+
+  for (;;) {
+    bool done = atomic_load_explicit(&relay->source->done, memory_order_acquire);
+
+    ri_pop_result_t r = ri_consumer_pop(relay->consumer);
+    if (r == RI_POP_RESULT_ERROR)
+      error(-1, 0, "relay: ri_consumer_pop failed");
+
+    if (r < RI_POP_RESULT_SUCCESS) {
+      if (done)
+        break;
+
+      thrd_yield();
+      continue;
+    }
+
+    uint64_t seq = pattern_check(ri_consumer_msg(relay->consumer), MSG_SIZE);
+    if (seq == 0)
+      error(-1, 0, "relay: corrupted message after %llu", (unsigned long long)last);
+
+    if (seq <= last)
+      error(-1, 0, "relay: message %llu after %llu", (unsigned long long)seq, (unsigned long long)last);
+
+    last = seq;
+
+    int ret = ri_consumer_relay(relay->consumer, relay->producer);
+    if (ret < 0)
+      error(-1, -ret, "ri_consumer_relay failed");
+
+    if (ri_consumer_msg(relay->consumer))
+      error(-1, 0, "relay: consumer still holds message %llu", (unsigned long long)seq);
+
+    if (pattern_check(ri_producer_msg(relay->producer), MSG_SIZE) != seq)
+      error(-1, 0, "relay: message %llu changed while relayed", (unsigned long long)seq);
+
+    ri_producer_force_push(relay->producer);
+    relay->relayed++;
+  }
+
+  atomic_store_explicit(&relay->done, true, memory_order_release);
+
+  return 0;
+}
+
+
+int main()
+{
+  const ri_attr_t channels[] = {
+    { .msg_size = MSG_SIZE, .add_msgs = 2, .relay = true },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = channels,
+    .consumers = channels,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  source_t source = {
+    .producer = ri_vector_take_producer(vec, 0),
+  };
+
+  relay_t relay = {
+    .consumer = ri_vector_take_consumer(peer, 0),
+    .producer = ri_vector_take_producer(peer, 0),
+    .source = &source,
+  };
+
+  ri_consumer_t *sink = ri_vector_take_consumer(vec, 0);
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  thrd_t source_thread;
+  thrd_t relay_thread;
+
+  if (thrd_create(&relay_thread, relay_entry, &relay) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  if (thrd_create(&source_thread, source_entry, &source) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  uint64_t last = 0;
+  uint64_t received = 0;
+
+  for (;;) {
+    bool done = atomic_load_explicit(&relay.done, memory_order_acquire);
+
+    ri_pop_result_t r = ri_consumer_pop(sink);
+    if (r == RI_POP_RESULT_ERROR)
+      error(-1, 0, "sink: ri_consumer_pop failed");
+
+    if (r < RI_POP_RESULT_SUCCESS) {
+      if (done)
+        break;
+
+      thrd_yield();
+      continue;
+    }
+
+    uint64_t seq = pattern_check(ri_consumer_msg(sink), MSG_SIZE);
+    if (seq == 0)
+      error(-1, 0, "sink: corrupted message after %llu", (unsigned long long)last);
+
+    if (seq <= last)
+      error(-1, 0, "sink: message %llu after %llu", (unsigned long long)seq, (unsigned long long)last);
+
+    last = seq;
+    received++;
+  }
+
+  thrd_join(source_thread, NULL);
+  thrd_join(relay_thread, NULL);
+
+  /* force pushes never discard the newest message */
+  if (last != NUM_MSGS)
+    error(-1, 0, "sink: last message %llu, expected %u", (unsigned long long)last, NUM_MSGS);
+
+  LOG_INF("relayed %llu, received %llu of %u messages intact and in order",
+          (unsigned long long)relay.relayed, (unsigned long long)received, NUM_MSGS);
+
+  ri_producer_delete(source.producer);
+  ri_consumer_delete(relay.consumer);
+  ri_producer_delete(relay.producer);
+  ri_consumer_delete(sink);
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a server thread answers calls of the main thread, with one and with
+ * several calls in flight, and reports the call latency */
+
+#ifndef NUM_CALLS
+#define NUM_CALLS 1000000
+#endif
+
+#ifndef CPU_CLIENT
+#define CPU_CLIENT 0
+#endif
+
+#ifndef CPU_SERVER
+#define CPU_SERVER 2
+#endif
+
+#define MAX_PENDING 32
+#define MAX_BATCH 16
+
+typedef struct request {
+  uint64_t a;
+  uint64_t b;
+} request_t;
+
+
+typedef struct response {
+  uint64_t sum;
+} response_t;
+
+
+typedef struct bench {
+  ri_rpc_client_t *client;
+  ri_rpc_server_t *server;
+  atomic_bool run;
+} bench_t;
+
+
+static void add(void *arg, const void *request, void *response)
+{
+  (void)arg;
+
+  const request_t *req = request;
+  response_t *rsp = response;
+
+  rsp->sum = req->a + req->b;
+}
+
+
+static int serve(void *arg)
+{
+  bench_t *bench = arg;
+
+  set_affinity(CPU_SERVER);
+
+  while (atomic_load_explicit(&bench->run, memory_order_relaxed)) {
+    int r = ri_rpc_server_process(bench->server, add, NULL, MAX_BATCH);
+    if (r < 0)
+      error(-1, -r, "server failed");
+
+    if (r == 0)
+      thrd_yield();
+  }
+
+  return 0;
+}
+
+
+static void run(bench_t *bench, unsigned depth)
+{
+  uint64_t sent = 0;
+  uint64_t done = 0;
+  uint64_t latency_sum = 0;
+  uint64_t latency_max = 0;
+
+  while (done < NUM_CALLS) {
+    while ((sent < NUM_CALLS) && (ri_rpc_client_pending(bench->client) < depth)) {
+      request_t *req = ri_rpc_client_request(bench->client);
+
+      req->a = sent;
+      req->b = 1;
+
+      if (ri_rpc_client_send(bench->client, NULL) < 0)
+        break;
+
+      sent++;
+    }
+
+    ri_rpc_result_t result;
+    int r = ri_rpc_client_poll(bench->client, &result);
+
+    if (r < 0)
+      error(-1, -r, "client poll failed");
+
+    if (r == 0) {
+      thrd_yield();
+      continue;
+    }
+
+    const response_t *rsp = result.response;
+
+    if (rsp->sum != result.id + 1)
+      error(-1, 0, "wrong response %llu for call %llu", (unsigned long long)rsp->sum,
+            (unsigned long long)result.id);
+
+    latency_sum += result.latency;
+    latency_max = result.latency > latency_max ? result.latency : latency_max;
+    done++;
+  }
+
+  LOG_INF("depth=%2u latency mean=%6.0f ns max=%8llu ns", depth,
+          (double)latency_sum / done, (unsigned long long)latency_max);
+}
+
+
+int main()
+{
+  static const unsigned depths[] = { 1, 4, MAX_PENDING };
+
+  const ri_attr_t requests[] = {
+    { .msg_size = RI_RPC_HEADER_SIZE + sizeof(request_t), .add_msgs = MAX_PENDING },
+    { 0 },
+  };
+
+  const ri_attr_t responses[] = {
+    { .msg_size = RI_RPC_HEADER_SIZE + sizeof(response_t), .add_msgs = MAX_PENDING },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = requests,
+    .consumers = responses,
+  };
+
+  for (unsigned i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+    ri_vector_t *vec = ri_vector_new(&config);
+    if (!vec)
+      return -1;
+
+    ri_vector_t *peer = vector_peer(vec);
+    if (!peer)
+      return -1;
+
+    ri_producer_t *request_producer = ri_vector_take_producer(vec, 0);
+    ri_consumer_t *response_consumer = ri_vector_take_consumer(vec, 0);
+    ri_consumer_t *request_consumer = ri_vector_take_consumer(peer, 0);
+    ri_producer_t *response_producer = ri_vector_take_producer(peer, 0);
+
+    ri_vector_delete(peer);
+    ri_vector_delete(vec);
+
+    bench_t bench = {
+      .client = ri_rpc_client_new(request_producer, response_consumer, MAX_PENDING),
+      .server = ri_rpc_server_new(request_consumer, response_producer),
+      .run = true,
+    };
+
+    if (!bench.client || !bench.server)
+      return -1;
+
+    thrd_t thread;
+
+    if (thrd_create(&thread, serve, &bench) != thrd_success)
+      error(-1, 0, "thrd_create failed");
+
+    set_affinity(CPU_CLIENT);
+
+    run(&bench, depths[i]);
+
+    atomic_store(&bench.run, false);
+    thrd_join(thread, NULL);
+
+    ri_rpc_client_delete(bench.client);
+    ri_rpc_server_delete(bench.server);
+
+    ri_producer_delete(request_producer);
+    ri_consumer_delete(response_consumer);
+    ri_consumer_delete(request_consumer);
+    ri_producer_delete(response_producer);
+  }
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* compares the throughput of padded (cacheline aligned) and compact
+ * (densely packed) message slots for tiny messages */
+
+#ifndef ADDITIONAL_MSGS
+#define ADDITIONAL_MSGS 100000
+#endif
+
+#ifndef SEND_NUM_MSGS
+#define SEND_NUM_MSGS 10000000
+#endif
+
+#ifndef CPU_PRODUCER
+#define CPU_PRODUCER 0
+#endif
+
+#ifndef CPU_CONSUMER
+#define CPU_CONSUMER 2
+#endif
+
+
+typedef struct bench {
+  ri_producer_t *producer;
+  ri_consumer_t *consumer;
+  size_t msg_size;
+  int cpu;
+  uint64_t received;
+  uint64_t checksum;
+} bench_t;
+
+
+static int consumer_entry(void *arg)
+{
+  bench_t *bench = arg;
+
+  set_affinity(bench->cpu);
+
+  while (bench->received < SEND_NUM_MSGS) {
+    ri_pop_result_t r = ri_consumer_pop(bench->consumer);
+
+    if (r < RI_POP_RESULT_SUCCESS)
+      continue;
+
+    const uint8_t *msg = ri_consumer_msg(bench->consumer);
+
+    bench->checksum += msg[0];
+    bench->received++;
+  }
+
+  return 0;
+}
+
+
+static void produce(bench_t *bench)
+{
+  for (uint64_t counter = 0; counter < SEND_NUM_MSGS; counter++) {
+    uint8_t *msg = ri_producer_msg(bench->producer);
+
+    memcpy(msg, &counter, bench->msg_size < sizeof(counter) ? bench->msg_size : sizeof(counter));
+
+    while (ri_producer_try_push(bench->producer) == RI_TRY_PUSH_RESULT_FAIL)
+      ;
+  }
+}
+
+
+static int run(size_t msg_size, unsigned msg_align)
+{
+  const ri_attr_t producers[] = {
+    { .add_msgs = ADDITIONAL_MSGS, .msg_size = msg_size, .msg_align = msg_align },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = producers,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    goto fail_vec;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    goto fail_peer;
+
+  bench_t bench = {
+    .producer = ri_vector_take_producer(vec, 0),
+    .consumer = ri_vector_take_consumer(peer, 0),
+    .msg_size = msg_size,
+    .cpu = CPU_CONSUMER,
+  };
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  set_affinity(CPU_PRODUCER);
+
+  thrd_t consumer;
+
+  uint64_t start = now_ns();
+
+  if (thrd_create(&consumer, consumer_entry, &bench) != thrd_success)
+    goto fail_thread;
+
+  produce(&bench);
+
+  thrd_join(consumer, NULL);
+
+  uint64_t elapsed = now_ns() - start;
+  double rate = (double)SEND_NUM_MSGS / (double)elapsed * 1000000000.0;
+
+  LOG_INF("msg_size=%2zu msg_align=%2u: %10.0f msg/s %8.1f MB/s payload",
+          msg_size, msg_align, rate, rate * msg_size / 1e6);
+
+  ri_producer_delete(bench.producer);
+  ri_consumer_delete(bench.consumer);
+
+  return 0;
+
+fail_thread:
+  ri_producer_delete(bench.producer);
+  ri_consumer_delete(bench.consumer);
+  return -1;
+fail_peer:
+  ri_vector_delete(vec);
+fail_vec:
+  return -1;
+}
+
+
+int main()
+{
+  static const size_t sizes[] = { 4, 8, 16, 32 };
+
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    /* padded (default) */
+    if (run(sizes[i], 0) < 0)
+      return -1;
+
+    /* compact */
+    if (run(sizes[i], sizes[i]) < 0)
+      return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* runs a vector from static storage and verifies that the steady state
+ * (push, pop, producer cache) never allocates.
+ * malloc and friends are interposed to catch allocations that bypass the
+ * allocator hooks. Exits with a non-zero status on any steady state allocation. */
+
+#ifndef NUM_ITERATIONS
+#define NUM_ITERATIONS 100000
+#endif
+
+#define POOL_SIZE 0x10000
+#define STORAGE_SIZE 0x10000
+#define REQUEST_SIZE 0x1000
+
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+
+static volatile bool s_steady = false;
+static volatile unsigned s_steady_mallocs = 0;
+
+
+void* malloc(size_t size)
+{
+  if (s_steady)
+    s_steady_mallocs++;
+  return __libc_malloc(size);
+}
+
+
+void* calloc(size_t n, size_t size)
+{
+  if (s_steady)
+    s_steady_mallocs++;
+  return __libc_calloc(n, size);
+}
+
+
+void* realloc(void *ptr, size_t size)
+{
+  if (s_steady)
+    s_steady_mallocs++;
+  return __libc_realloc(ptr, size);
+}
+
+
+void* aligned_alloc(size_t align, size_t size)
+{
+  if (s_steady)
+    s_steady_mallocs++;
+  return __libc_memalign(align, size);
+}
+
+
+typedef struct pool {
+  uint8_t *mem;
+  size_t size;
+  size_t offset;
+  unsigned n_allocs;
+  unsigned n_steady_allocs;
+} pool_t;
+
+
+static void* pool_alloc(size_t size, size_t align, void *user_data)
+{
+  pool_t *pool = user_data;
+  size_t offset = (pool->offset + align - 1) & ~(align - 1);
+
+  if (s_steady)
+    pool->n_steady_allocs++;
+
+  if (offset + size > pool->size)
+    return NULL;
+
+  pool->offset = offset + size;
+  pool->n_allocs++;
+
+  return &pool->mem[offset];
+}
+
+
+static void pool_free(void *ptr, void *user_data)
+{
+  /* static pool, memory is never reused */
+  (void) ptr;
+  (void) user_data;
+}
+
+
+static alignas(64) uint8_t s_pool_mem[POOL_SIZE];
+static alignas(64) uint8_t s_client_storage[STORAGE_SIZE];
+static alignas(64) uint8_t s_server_storage[STORAGE_SIZE];
+static uint8_t s_request[REQUEST_SIZE];
+
+
+static int steady_state(ri_producer_t *producer, ri_consumer_t *consumer)
+{
+  size_t msg_size = ri_producer_msg_size(producer);
+
+  for (uint32_t i = 0; i < NUM_ITERATIONS; i++) {
+    if ((i % 16) == 0) {
+      if (ri_producer_cache_enable(producer) < 0)
+        return -1;
+    }
+
+    uint8_t *msg = ri_producer_msg(producer);
+    memset(msg, i & 0xff, msg_size);
+
+    if (i & 1)
+      ri_producer_force_push(producer);
+    else
+      ri_producer_try_push(producer);
+
+    if ((i % 16) == 8)
+      ri_producer_cache_disable(producer);
+
+    if (i & 2)
+      ri_consumer_flush(consumer);
+    else
+      ri_consumer_pop(consumer);
+  }
+
+  return 0;
+}
+
+
+int main()
+{
+  pool_t pool = {
+    .mem = s_pool_mem,
+    .size = sizeof(s_pool_mem),
+  };
+
+  const ri_allocator_t allocator = {
+    .alloc = pool_alloc,
+    .free = pool_free,
+    .user_data = &pool,
+  };
+
+  ri_set_allocator(&allocator);
+
+  const ri_attr_t producers[] = {
+    { .add_msgs = 10, .msg_size = 48, .eventfd = true, .cache = true },
+    { .add_msgs = 0, .msg_size = 100, .msg_align = 4 },
+    { 0 },
+  };
+
+  const ri_attr_t consumers[] = {
+    { .add_msgs = 2, .msg_size = 16 },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = producers,
+    .consumers = consumers,
+    .layout = RI_LAYOUT_SPLIT,
+  };
+
+  size_t storage_size = ri_vector_storage_size(&config);
+
+  LOG_INF("vector storage_size=%zu", storage_size);
+
+  if (storage_size > STORAGE_SIZE)
+    return -1;
+
+  ri_vector_t *vec = ri_vector_init(&config, s_client_storage, sizeof(s_client_storage));
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer_init(vec, s_request, sizeof(s_request),
+                                       s_server_storage, sizeof(s_server_storage));
+  if (!peer) {
+    ri_vector_delete(vec);
+    return -1;
+  }
+
+  ri_producer_t *producer = ri_vector_take_producer(vec, 0);
+  ri_consumer_t *consumer = ri_vector_take_consumer(peer, 0);
+
+  LOG_INF("init: %u allocations from the pool, %zu bytes", pool.n_allocs, pool.offset);
+
+  s_steady = true;
+
+  int r = steady_state(producer, consumer);
+
+  s_steady = false;
+
+  ri_producer_delete(producer);
+  ri_consumer_delete(consumer);
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  if (r < 0) {
+    LOG_ERR("steady state failed");
+    return -1;
+  }
+
+  if (s_steady_mallocs || pool.n_steady_allocs) {
+    LOG_ERR("steady state allocated: malloc=%u hooks=%u", s_steady_mallocs, pool.n_steady_allocs);
+    return -1;
+  }
+
+  LOG_INF("no allocations in %u steady state iterations", NUM_ITERATIONS);
+
+  return 0;
+}
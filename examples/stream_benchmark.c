@@ -0,0 +1,189 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <errno.h>
+#include <unistd.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* moves a byte stream from one thread to another, through a pipe and
+ * through an rtipc stream, in chunks of varying size */
+
+#ifndef SEND_NUM_BYTES
+#define SEND_NUM_BYTES (UINT64_C(1) << 30)
+#endif
+
+#ifndef STREAM_SIZE
+#define STREAM_SIZE (64 * 1024)
+#endif
+
+#ifndef CPU_WRITER
+#define CPU_WRITER 0
+#endif
+
+#ifndef CPU_READER
+#define CPU_READER 2
+#endif
+
+
+typedef struct bench {
+  size_t chunk;
+  int pipe[2];
+  ri_stream_t *writer;
+  ri_stream_t *reader;
+  uint64_t checksum;
+} bench_t;
+
+
+static int pipe_reader(void *arg)
+{
+  bench_t *bench = arg;
+  uint8_t buf[STREAM_SIZE];
+  uint64_t received = 0;
+
+  set_affinity(CPU_READER);
+
+  while (received < SEND_NUM_BYTES) {
+    ssize_t n = read(bench->pipe[0], buf, sizeof(buf));
+    if (n <= 0)
+      error(-1, errno, "pipe read failed");
+
+    bench->checksum += buf[0];
+    received += n;
+  }
+
+  return 0;
+}
+
+
+static int stream_reader(void *arg)
+{
+  bench_t *bench = arg;
+  uint64_t received = 0;
+
+  set_affinity(CPU_READER);
+
+  while (received < SEND_NUM_BYTES) {
+    size_t n;
+    const uint8_t *span = ri_stream_acquire(bench->reader, &n);
+
+    if (n == 0) {
+      thrd_yield();
+      continue;
+    }
+
+    bench->checksum += span[0];
+    ri_stream_commit(bench->reader, n);
+    received += n;
+  }
+
+  return 0;
+}
+
+
+static void pipe_write(bench_t *bench, const uint8_t *chunk)
+{
+  for (uint64_t sent = 0; sent < SEND_NUM_BYTES; sent += bench->chunk) {
+    if (write(bench->pipe[1], chunk, bench->chunk) != (ssize_t)bench->chunk)
+      error(-1, errno, "pipe write failed");
+  }
+}
+
+
+static void stream_write(bench_t *bench, const uint8_t *chunk)
+{
+  for (uint64_t sent = 0; sent < SEND_NUM_BYTES; ) {
+    ssize_t n = ri_stream_write(bench->writer, chunk, bench->chunk);
+
+    if (n == 0)
+      thrd_yield();
+
+    sent += n;
+  }
+}
+
+
+static void run(bench_t *bench, const char *name, thrd_start_t reader,
+                void (*writer)(bench_t *bench, const uint8_t *chunk))
+{
+  static uint8_t chunk[STREAM_SIZE];
+  thrd_t thread;
+
+  memset(chunk, 0x5a, sizeof(chunk));
+
+  if (thrd_create(&thread, reader, bench) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  uint64_t start = now_ns();
+
+  writer(bench, chunk);
+  thrd_join(thread, NULL);
+
+  uint64_t elapsed = now_ns() - start;
+
+  LOG_INF("chunk=%6zu %-6s: %8.1f MB/s", bench->chunk, name,
+          (double)SEND_NUM_BYTES / elapsed * 1000.0);
+}
+
+
+int main()
+{
+  static const size_t chunks[] = { 64, 512, 4096, 16384 };
+
+  const ri_attr_t producers[] = {
+    { .msg_size = 8 },
+    { 0 },
+  };
+
+  const ri_stream_attr_t streams[] = {
+    { .size = STREAM_SIZE },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = producers,
+    .stream_writers = streams,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  bench_t bench = {
+    .writer = ri_vector_take_stream_writer(vec, 0),
+    .reader = ri_vector_take_stream_reader(peer, 0),
+  };
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  if (pipe(bench.pipe) < 0)
+    error(-1, errno, "pipe failed");
+
+  set_affinity(CPU_WRITER);
+
+  for (unsigned i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+    bench.chunk = chunks[i];
+
+    run(&bench, "pipe", pipe_reader, pipe_write);
+    run(&bench, "stream", stream_reader, stream_write);
+  }
+
+  close(bench.pipe[0]);
+  close(bench.pipe[1]);
+
+  ri_stream_delete(bench.writer);
+  ri_stream_delete(bench.reader);
+
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <threads.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+
+#include "common.h"
+
+/* a producer thread commits numbered messages to several channels as one
+ * transaction, aborting some transactions halfway, while the consumer takes
+ * snapshots with ri_vector_pop_consistent. Every snapshot must hold intact
+ * messages of a single commit matching the epoch, commits must not go
+ * back and the last commit must arrive.
+ * Exits with a non-zero status on a violation. */
+
+#ifndef NUM_COMMITS
+#define NUM_COMMITS 100000
+#endif
+
+#define NUM_CHANNELS 3
+
+
+static const size_t msg_sizes[NUM_CHANNELS] = { 16, 64, 200 };
+
+
+typedef struct producer {
+  ri_vector_t *vec;
+  ri_producer_t *producers[NUM_CHANNELS];
+  atomic_bool done;
+} producer_t;
+
+
+static void stage(producer_t *producer, uint64_t seq)
+{
+  for (unsigned i = 0; i < NUM_CHANNELS; i++) {
+    pattern_fill(ri_producer_msg(producer->producers[i]), msg_sizes[i], seq);
+
+    int r = ri_vector_tx_stage(producer->vec, producer->producers[i]);
+    if (r < 0)
+      error(-1, -r, "ri_vector_tx_stage failed");
+
+    /* gives the consumer a chance to look at a half staged transaction */
+    if (i == 0)
+      thrd_yield();
+  }
+}
+
+
+static int producer_entry(void *arg)
+{
+  producer_t *producer = arg;
+
+  for (uint64_t seq = 1; seq <= NUM_COMMITS; seq++) {
+    /* an aborted transaction must never become visible */
+    if ((seq % 16) == 0) {
+      stage(producer, UINT64_MAX);
+      ri_vector_tx_abort(producer->vec);
+    }
+
+    stage(producer, seq);
+
+    int r = ri_vector_tx_commit(producer->vec);
+    if (r < 0)
+      error(-1, -r, "ri_vector_tx_commit failed");
+  }
+
+  atomic_store_explicit(&producer->done, true, memory_order_release);
+
+  return 0;
+}
+
+
+int main()
+{
+  const ri_attr_t channels[] = {
+    { .msg_size = msg_sizes[0], .add_msgs = 2 },
+    { .msg_size = msg_sizes[1] },
+    { .msg_size = msg_sizes[2], .add_msgs = 5 },
+    { 0 },
+  };
+
+  const ri_config_t config = {
+    .producers = channels,
+  };
+
+  ri_vector_t *vec = ri_vector_new(&config);
+  if (!vec)
+    return -1;
+
+  ri_vector_t *peer = vector_peer(vec);
+  if (!peer)
+    return -1;
+
+  /* transactions need the vectors of both sides */
+  producer_t producer = {
+    .vec = vec,
+  };
+
+  ri_consumer_t *consumers[NUM_CHANNELS];
+
+  for (unsigned i = 0; i < NUM_CHANNELS; i++) {
+    producer.producers[i] = ri_vector_take_producer(vec, i);
+    consumers[i] = ri_vector_take_consumer(peer, i);
+  }
+
+  thrd_t thread;
+
+  if (thrd_create(&thread, producer_entry, &producer) != thrd_success)
+    error(-1, 0, "thrd_create failed");
+
+  uint64_t last = 0;
+  uint64_t snapshots = 0;
+  uint64_t retries = 0;
+
+  for (;;) {
+    bool done = atomic_load_explicit(&producer.done, memory_order_acquire);
+    uint64_t epoch;
+
+    int r = ri_vector_pop_consistent(peer, consumers, NUM_CHANNELS, &epoch);
+
+    if (r == -EAGAIN) {
+      retries++;
+      thrd_yield();
+      continue;
+    }
+
+    if (r < 0)
+      error(-1, -r, "ri_vector_pop_consistent failed");
+
+    if (r == 0) {
+      if (done)
+        break;
+
+      thrd_yield();
+      continue;
+    }
+
+    uint64_t seq = pattern_check(ri_consumer_msg(consumers[0]), msg_sizes[0]);
+
+    for (unsigned i = 1; i < NUM_CHANNELS; i++) {
+      uint64_t other = pattern_check(ri_consumer_msg(consumers[i]), msg_sizes[i]);
+
+      if (other != seq)
+        error(-1, 0, "snapshot mixes commit %llu of channel 0 with %llu of channel %u",
+              (unsigned long long)seq, (unsigned long long)other, i);
+    }
+
+    if ((seq == 0) || (seq == UINT64_MAX))
+      error(-1, 0, "corrupted or aborted message in snapshot after commit %llu", (unsigned long long)last);
+
+    if (seq < last)
+      error(-1, 0, "commit %llu after %llu", (unsigned long long)seq, (unsigned long long)last);
+
+    if (epoch != seq)
+      error(-1, 0, "commit %llu in snapshot of epoch %llu", (unsigned long long)seq, (unsigned long long)epoch);
+
+    last = seq;
+    snapshots++;
+  }
+
+  thrd_join(thread, NULL);
+
+  if (last != NUM_COMMITS)
+    error(-1, 0, "last commit %llu, expected %u", (unsigned long long)last, NUM_COMMITS);
+
+  LOG_INF("%llu consistent snapshots of %u commits, %llu retries",
+          (unsigned long long)snapshots, NUM_COMMITS, (unsigned long long)retries);
+
+  for (unsigned i = 0; i < NUM_CHANNELS; i++) {
+    ri_producer_delete(producer.producers[i]);
+    ri_consumer_delete(consumers[i]);
+  }
+
+  ri_vector_delete(peer);
+  ri_vector_delete(vec);
+
+  return 0;
+}
@@ -129,6 +129,106 @@ ri_vector_t* ri_client_connect(const char *path, const ri_config_t *vconfig);
 
 
 
+/**
+ * @def RI_BROKER_TOPIC_MAX
+ * @brief Maximum length of a topic name including the terminating NUL.
+ */
+#define RI_BROKER_TOPIC_MAX 56
+
+/**
+ * @typedef ri_broker_t
+ * @brief Opaque handle representing a topic broker.
+ *
+ * A broker is a small local registry of named topics. Publishers create the
+ * vector of a topic themselves and register it, subscribers look it up by
+ * name and map the shared memory and eventfds handed over by the broker.
+ * The broker never maps a vector, so it is not part of the data path.
+ */
+typedef struct ri_broker ri_broker_t;
+
+
+/**
+ * @brief Create a broker listening on a UNIX domain socket.
+ *
+ * @param path    Filesystem path for the UNIX domain socket.
+ * @param backlog Maximum length for the queue of pending connections (passed to listen()).
+ * @return Pointer to the created broker, or NULL on failure.
+ */
+ri_broker_t* ri_broker_new(const char *path, int backlog);
+
+
+/**
+ * @brief Destroy a broker.
+ *
+ * Closes the listening socket, removes the socket file and closes the
+ * descriptors of all topics that were not claimed by a subscriber.
+ *
+ * @param broker Pointer to the broker to destroy.
+ */
+void ri_broker_delete(ri_broker_t *broker);
+
+
+/**
+ * @brief Get the broker's listening socket, e.g. to poll for new connections.
+ *
+ * @param broker Pointer to an initialized broker.
+ * @return File descriptor of the listening socket, owned by the broker.
+ */
+int ri_broker_socket(const ri_broker_t *broker);
+
+
+/**
+ * @brief Accept one connection and handle its request.
+ *
+ * A publish request is validated and stored together with its descriptors,
+ * a subscribe request claims the oldest registration of the topic. Blocks
+ * until a client connects.
+ *
+ * @param broker Pointer to an initialized broker.
+ * @return 0 if the request was handled (also if it was answered with an
+ *         error), or a negative errno if accepting or receiving failed.
+ */
+int ri_broker_process(ri_broker_t *broker);
+
+
+/**
+ * @brief Create a vector and register it as a topic.
+ *
+ * Creates the vector like @ref ri_client_connect, but sends it to the broker
+ * under the name @p topic instead of to a server. The returned vector holds
+ * the publisher side, a subscriber gets the peer side.
+ *
+ * Channels have a single consumer, so every registration is claimed by one
+ * subscriber. To serve several subscribers, a publisher registers the topic
+ * several times, e.g. ahead of time, so subscribing never waits for the
+ * publisher.
+ *
+ * A vector with a barrier (@ref ri_config_t::barrier_participants) but no
+ * channels, streams or tables is not claimed, every subscriber maps the
+ * same barrier.
+ *
+ * @param path   Filesystem path of the broker's UNIX domain socket.
+ * @param topic  Topic name, shorter than @ref RI_BROKER_TOPIC_MAX.
+ * @param config Configuration of the topic's vector.
+ * @return Pointer to the publisher's vector, or NULL on failure.
+ */
+ri_vector_t* ri_broker_publish(const char *path, const char *topic, const ri_config_t *config);
+
+
+/**
+ * @brief Look up a topic and map its vector.
+ *
+ * Claims the oldest registration of @p topic (or shares it if it only
+ * holds a barrier), receives its layout, shared memory and eventfds from
+ * the broker and maps them. No configuration is needed, the layout is
+ * taken from the registration.
+ *
+ * @param path  Filesystem path of the broker's UNIX domain socket.
+ * @param topic Topic name.
+ * @return Pointer to the subscriber's vector, or NULL if the topic has no
+ *         unclaimed registration or on failure.
+ */
+ri_vector_t* ri_broker_subscribe(const char *path, const char *topic);
 
 
 #ifdef __cplusplus
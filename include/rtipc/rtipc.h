@@ -25,6 +25,8 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 
 #ifdef __cplusplus
@@ -70,6 +72,52 @@ typedef void (*ri_log_fn)(int priority,
  */
 void ri_set_log_handler(ri_log_fn log_handler);
 
+/**
+ * @brief Memory allocation hooks.
+ *
+ * All heap memory used by the library is obtained through these callbacks.
+ *
+ * @var ri_allocator_t::alloc
+ * Returns @p size bytes aligned to at least @p align (a power of two),
+ * or @c NULL on failure.
+ *
+ * @var ri_allocator_t::free
+ * Releases memory returned by @c alloc. Never called with @c NULL.
+ *
+ * @var ri_allocator_t::user_data
+ * Passed unchanged to both callbacks.
+ */
+typedef struct ri_allocator {
+  void* (*alloc)(size_t size, size_t align, void *user_data);
+  void (*free)(void *ptr, void *user_data);
+  void *user_data;
+} ri_allocator_t;
+
+/**
+ * @brief Sets custom memory allocation hooks for the library.
+ *
+ * The allocator is copied. It must be installed before any other library
+ * function is called and must not be changed while objects allocated
+ * through it are still alive.
+ *
+ * Memory is only allocated while vectors are created, (de)serialized or
+ * connected. Pushing, popping and enabling the producer cache never
+ * allocate.
+ *
+ * Vectors, merges, RPC clients and servers and cyclic executives also
+ * have an @c _init variant placing them in caller-provided storage, so
+ * they can be created without any allocator. The exceptions are the
+ * connection helpers of rtipc/connect.h: servers, clients and the broker,
+ * whose topic registry grows at run time, always allocate through the
+ * hooks. Serializing a vector and @ref ri_vector_deserialize_init also
+ * allocate temporary memory for the parsed request.
+ *
+ * Passing @c NULL restores the default (malloc based) allocator.
+ *
+ * @param allocator Pointer to the allocation hooks, or @c NULL.
+ */
+void ri_set_allocator(const ri_allocator_t *allocator);
+
 /**
  * @typedef ri_vector_t
  * @brief Opaque handle to a channel vector connecting producer and consumer channels
@@ -91,6 +139,18 @@ typedef struct ri_info {
 } ri_info_t;
 
 
+/**
+ * @brief Maximum number of priority lanes of a channel, see @ref ri_attr_t::lanes.
+ */
+#define RI_MAX_LANES 4
+
+
+/**
+ * @brief Maximum number of participants of a barrier, see @ref ri_config_t::barrier_participants.
+ */
+#define RI_MAX_BARRIER_PARTICIPANTS 256
+
+
 /**
  * @typedef ri_attr_t
  * @brief Configuration for creating a producer or consumer channel.
@@ -118,6 +178,107 @@ typedef struct ri_attr {
    */
   bool eventfd;
 
+  /**
+   * Alignment of the message slots in bytes.
+   *
+   * 0 selects the default: every message is padded to a full cacheline,
+   * so the producer writing one message never touches the cacheline of
+   * a message read by the consumer.
+   *
+   * A smaller power of two packs messages densely (compact mode), e.g.
+   * 8 byte messages with msg_align = 8 occupy 8 bytes instead of a whole
+   * cacheline. This reduces the memory footprint and bandwidth of deep
+   * queues with tiny messages at the cost of false sharing between
+   * neighbouring messages. Must not exceed the cacheline size.
+   */
+  unsigned msg_align;
+
+  /**
+   * Block size in bytes for dirty tracking, a power of two.
+   *
+   * 0 disables dirty tracking. Otherwise the message is divided into
+   * blocks of this size. With the producer cache enabled, a push only
+   * copies the blocks marked with @ref ri_producer_mark_dirty that the
+   * slot is missing, and consumers can query which blocks changed since
+   * their previous message with @ref ri_consumer_dirty.
+   */
+  unsigned dirty_block;
+
+  /**
+   * Maximum number of messages the consumer can lease at once.
+   *
+   * A leased message stays valid after newer messages were popped, until
+   * it is released with @ref ri_consumer_release. The channel gets this
+   * many additional slots, which the producer uses in place of leased
+   * ones, so leases never reduce the queue capacity. 0 disables leases.
+   */
+  unsigned max_leases;
+
+  /**
+   * Enables zero-copy relaying with @ref ri_consumer_relay.
+   *
+   * The slots of relay channels refer to their buffers through a table of
+   * offsets in shared memory, so a buffer can move between channels of
+   * the same vector. Not supported together with dirty_block.
+   */
+  bool relay;
+
+  /**
+   * Size of the channel's blob heap in bytes, at most 4 GiB.
+   *
+   * Large, variable-size payloads are allocated from the heap with
+   * @ref ri_producer_blob_alloc and referenced from a message by a compact
+   * @ref ri_blob_t handle, so the message slots only need to fit the
+   * small fixed-size part. Blobs are freed when the producer reuses the
+   * slot of the referencing message. 0 disables the heap. Not supported
+   * together with relay.
+   */
+  size_t blob_size;
+
+  /**
+   * Number of priority lanes, at most @ref RI_MAX_LANES.
+   *
+   * 0 or 1 creates a plain channel. Otherwise every lane is a queue of its
+   * own with the capacity given by add_msgs, all lanes share the message
+   * size and the eventfd. The producer picks the lane of the next message
+   * with @ref ri_producer_select_lane, @ref ri_consumer_pop returns the
+   * oldest message of the highest lane holding one. A force push only
+   * discards messages of its own lane, so bulk traffic in a low lane never
+   * pushes out messages of a higher one. Not supported together with
+   * dirty_block, max_leases, relay, blob_size and watermark.
+   */
+  unsigned lanes;
+
+  /**
+   * Lets the consumer publish which messages it wants.
+   *
+   * The channel gets a word in shared memory holding a type mask and a
+   * rate cap, set by the consumer with @ref ri_consumer_set_interest.
+   * The producer asks @ref ri_producer_should_push before preparing a
+   * message and skips the work for unwanted ones.
+   */
+  bool interest;
+
+  /**
+   * Lets the producer see how far the consumer got.
+   *
+   * The producer numbers its messages and the consumer publishes the
+   * number of every message it pops on a cacheline of its own. The
+   * producer reads both with @ref ri_producer_progress, e.g. to lower its
+   * rate before messages get discarded, or to monitor the lag.
+   * Not supported together with lanes.
+   */
+  bool watermark;
+
+  /**
+   * Reserves the buffer of the producer cache.
+   *
+   * The producer's storage then holds a private copy of a message, which
+   * @ref ri_producer_cache_enable uses without allocating. Without it
+   * enabling the cache fails.
+   */
+  bool cache;
+
   /**
    * Optional user-defined metadata associated with the channel.
    *
@@ -129,6 +290,78 @@ typedef struct ri_attr {
 } ri_attr_t;
 
 
+/**
+ * @enum ri_layout_t
+ * @brief Placement of the channels inside the shared memory of a vector.
+ */
+typedef enum ri_layout {
+  /**
+   * Each channel's control words (tail, head and chain) are placed
+   * directly in front of its messages.
+   */
+  RI_LAYOUT_INTERLEAVED = 0,
+
+  /**
+   * The control words of all channels are gathered in one contiguous
+   * control region in front of the message payload. The head indices of
+   * each direction are packed into a single array, so
+   * @ref ri_vector_poll_ready can check many channels with a few cache misses.
+   *
+   * This is a deliberate trade-off: the heads are not padded, so many
+   * channels of one direction share a cacheline. Producers of these
+   * channels running on different threads false-share that line on every
+   * push, while the polling consumer saves a cache miss per channel. Use
+   * the split layout when one thread produces for all channels of a
+   * direction (or the producers push rarely), and
+   * @ref RI_LAYOUT_INTERLEAVED when producers of the same direction run on
+   * different cores at high rates.
+   */
+  RI_LAYOUT_SPLIT = 1,
+} ri_layout_t;
+
+
+/**
+ * @typedef ri_stream_attr_t
+ * @brief Configuration of a byte-stream channel.
+ */
+typedef struct ri_stream_attr {
+  /**
+   * Capacity of the stream in bytes, rounded up to whole pages.
+   */
+  size_t size;
+} ri_stream_attr_t;
+
+
+/**
+ * @typedef ri_table_attr_t
+ * @brief Configuration of a shared state table.
+ */
+typedef struct ri_table_attr {
+  /**
+   * Size of a single entry in bytes. Every entry occupies its own
+   * cachelines together with its sequence counter, so updates of one entry
+   * don't invalidate the cachelines of others.
+   */
+  size_t entry_size;
+
+  /**
+   * Number of entries, entries are addressed by their index.
+   */
+  unsigned n_entries;
+
+  /**
+   * Queues the keys of updated entries for the reader (conflation).
+   *
+   * A key is queued at most once until the reader takes it with
+   * @ref ri_table_pop; further updates only replace the entry in place.
+   * The queue therefore never holds more than n_entries keys, however
+   * fast the writer updates, and the reader always gets the newest value
+   * of every key instead of a backlog of stale ones.
+   */
+  bool conflate;
+} ri_table_attr_t;
+
+
 /**
  * @typedef ri_config_t
  * @brief Configuration parameters for creating a channel vector.
@@ -156,6 +389,45 @@ typedef struct ri_config {
    */
   const ri_attr_t *producers;
 
+  /**
+   * Optional array of byte streams read by this side.
+   *
+   * The array must be terminated by a sentinel element where
+   * @ref ri_stream_attr_t::size is set to 0. Streams share the memory of
+   * the vector, which needs at least one message channel.
+   */
+  const ri_stream_attr_t *stream_readers;
+
+  /**
+   * Optional array of byte streams written by this side,
+   * terminated like @ref stream_readers.
+   */
+  const ri_stream_attr_t *stream_writers;
+
+  /**
+   * Optional array of state tables read by this side.
+   *
+   * The array must be terminated by a sentinel element where
+   * @ref ri_table_attr_t::entry_size is set to 0. Like streams, tables
+   * share the memory of the vector.
+   */
+  const ri_table_attr_t *table_readers;
+
+  /**
+   * Optional array of state tables written by this side,
+   * terminated like @ref table_readers.
+   */
+  const ri_table_attr_t *table_writers;
+
+  /**
+   * Number of participants of the vector's step barrier, 0 for none.
+   *
+   * At most @ref RI_MAX_BARRIER_PARTICIPANTS. The participants may be
+   * spread over any number of processes mapping the vector, see
+   * @ref ri_vector_barrier.
+   */
+  unsigned barrier_participants;
+
   /**
    * Optional user-defined metadata associated with the vector.
    *
@@ -164,6 +436,13 @@ typedef struct ri_config {
    */
   ri_info_t info;
 
+  /**
+   * Shared memory layout of the channels.
+   *
+   * The layout is transmitted to the server during vector creation.
+   */
+  ri_layout_t layout;
+
 } ri_config_t;
 
 
@@ -183,6 +462,38 @@ typedef struct ri_config {
 ri_vector_t* ri_vector_new(const ri_config_t *config);
 
 
+/**
+ * @brief Returns the storage size needed by @ref ri_vector_init.
+ *
+ * The size covers the vector, all of its channel handles, their local
+ * message caches and the info blocks. It is the same for both ends of a
+ * connection, so it can also be used for @ref ri_vector_deserialize_init
+ * when the peer's configuration is known.
+ *
+ * @param config Pointer to a vector configuration
+ * @return The number of bytes required.
+ */
+size_t ri_vector_storage_size(const ri_config_t *config);
+
+
+/**
+ * @brief Creates a channel vector in caller-provided storage.
+ *
+ * Behaves like @ref ri_vector_new, but all local objects of the vector,
+ * including the channels taken from it, are placed in @p storage instead of
+ * being allocated. The storage must stay valid until the vector and all
+ * channels taken from it are deleted.
+ *
+ * @param config  Pointer to a static vector configuration
+ * @param storage Caller-provided memory, no alignment required
+ * @param size    Size of @p storage in bytes, at least
+ *                @ref ri_vector_storage_size
+ *
+ * @return The vector on success, or NULL on failure.
+ */
+ri_vector_t* ri_vector_init(const ri_config_t *config, void *storage, size_t size);
+
+
 /**
  * @brief Destroys a channel vector.
  *
@@ -254,6 +565,29 @@ int ri_vector_serialize(const ri_vector_t *vec, void* req, size_t size, int fds[
  */
 ri_vector_t* ri_vector_deserialize(const void* req, size_t size, int fds[], unsigned *n_fds);
 
+
+/**
+ * Deserializes a channel vector into caller-provided storage.
+ *
+ * Behaves like @ref ri_vector_deserialize, but places the vector and its
+ * channels in @p storage, see @ref ri_vector_init. Fails if @p storage is
+ * too small for the received configuration.
+ *
+ * The configuration is parsed into a temporary buffer obtained from the
+ * allocator hooks (@ref ri_set_allocator).
+ *
+ * @param req          Pointer to the serialized channel vector data.
+ * @param size         Size of the serialized data buffer in bytes.
+ * @param fds          Array containing associated file descriptors.
+ * @param n_fds        See @ref ri_vector_deserialize.
+ * @param storage      Caller-provided memory, no alignment required
+ * @param storage_size Size of @p storage in bytes.
+ *
+ * @return The vector on success, or NULL on failure.
+ */
+ri_vector_t* ri_vector_deserialize_init(const void* req, size_t size, int fds[], unsigned *n_fds,
+                                        void *storage, size_t storage_size);
+
 /**
  * @brief Returns the user-defined metadata associated with the vector.
  *
@@ -283,6 +617,95 @@ unsigned ri_vector_num_consumers(const ri_vector_t *vec);
 unsigned ri_vector_num_producers(const ri_vector_t *vec);
 
 
+/**
+ * @brief Checks all consumer channels of the vector for new messages.
+ *
+ * Sets bit (i % 64) of @p ready[i / 64] if consumer channel i has a message
+ * newer than the one it currently holds, meaning that the next
+ * @ref ri_consumer_pop will return a message. Consumers whose ownership was
+ * transferred via @ref ri_vector_take_consumer are never reported.
+ *
+ * With @ref RI_LAYOUT_SPLIT the packed head indices are compared with SIMD
+ * instructions, otherwise each channel is checked separately.
+ *
+ * This function never blocks and doesn't modify any channel.
+ *
+ * @param vec     Pointer to the vector.
+ * @param ready   Output bitmask.
+ * @param n_words Number of elements in @p ready, must be at least
+ *                (number of consumers + 63) / 64.
+ * @return Number of ready consumers, or a negative error code.
+ */
+int ri_vector_poll_ready(const ri_vector_t *vec, uint64_t ready[], unsigned n_words);
+
+
+/**
+ * @typedef ri_channel_layout_info_t
+ * @brief Placement and memory footprint of a single channel.
+ *
+ * All offsets are relative to the start of the vector's shared memory.
+ */
+typedef struct ri_channel_layout_info {
+  size_t tail_offset;  /**< Offset of the tail index */
+  size_t head_offset;  /**< Offset of the head index */
+  size_t chain_offset; /**< Offset of the chain indices */
+  size_t control_size; /**< Bytes used by tail, head, chain and the optional per-slot tables */
+  size_t msgs_offset;  /**< Offset of the first message slot */
+  size_t msg_size;     /**< Size of a message in bytes */
+  size_t msg_stride;   /**< Distance between two message slots in bytes */
+  unsigned n_msgs;     /**< Number of message slots */
+  size_t payload_size; /**< Bytes reserved for the message slots */
+  size_t padding;      /**< Bytes of @c payload_size not holding message data */
+  size_t resident;     /**< Bytes of the payload of all lanes currently resident in RAM */
+  size_t blob_offset;  /**< Offset of the blob heap */
+  size_t blob_size;    /**< Size of the blob heap, 0 without blobs */
+  unsigned n_lanes;    /**< Number of priority lanes, the fields above except @c resident describe lane 0 */
+  size_t lanes_offset; /**< Offset of the queues of the lanes above 0 */
+  size_t lanes_size;   /**< Size of the queues of the lanes above 0, 0 without lanes */
+} ri_channel_layout_info_t;
+
+
+/**
+ * @typedef ri_vector_layout_info_t
+ * @brief Memory footprint of a vector.
+ */
+typedef struct ri_vector_layout_info {
+  ri_layout_t layout;  /**< Shared memory layout of the channels */
+  size_t shm_size;     /**< Total size of the shared memory */
+  size_t control_size; /**< Bytes used by the control words of all channels */
+  size_t payload_size; /**< Bytes used by the message data of all channels */
+  size_t stream_size;  /**< Bytes used by the byte streams, including their positions */
+  size_t table_size;   /**< Bytes used by the state tables, including their sequence counters */
+  size_t padding;      /**< Remaining bytes of the shared memory, lost to alignment */
+  size_t storage_size; /**< Process local memory used by the vector and its channels */
+  size_t resident;     /**< Bytes of the shared memory resident in RAM */
+  size_t locked;       /**< Bytes of the shared memory locked in RAM */
+  size_t hugepage;     /**< Bytes of the shared memory backed by huge pages */
+} ri_vector_layout_info_t;
+
+
+/**
+ * @brief Describes the shared memory layout and footprint of a vector.
+ *
+ * Reports where the control words and the payload of each channel are
+ * placed, how much of the memory is padding, and how much of the shared
+ * memory is resident (mincore), locked and backed by huge pages
+ * (/proc/self/smaps). Channels taken out of the vector are reported as well.
+ *
+ * Intended for diagnostics; reading /proc may allocate and block, so this
+ * must not be called from a real-time context.
+ *
+ * @param vec       Pointer to the vector.
+ * @param info      Receives the vector footprint, may be NULL.
+ * @param consumers Receives one entry per consumer channel, may be NULL.
+ * @param producers Receives one entry per producer channel, may be NULL.
+ * @return 0 on success, or a negative error code.
+ */
+int ri_vector_layout(const ri_vector_t *vec, ri_vector_layout_info_t *info,
+                     ri_channel_layout_info_t consumers[],
+                     ri_channel_layout_info_t producers[]);
+
+
 /**
  * @typedef ri_consumer_t
  * @brief Handle for receiving messages from a peer process.
@@ -322,7 +745,8 @@ void ri_consumer_delete(ri_consumer_t *consumer);
  *
  * The pointer remains valid until the next call to
  * @ref ri_consumer_pop or @ref ri_consumer_flush.
- * If no message was produced yet, NULL will be returned.
+ * If no message was produced yet, or the message was copied out with
+ * @ref ri_consumer_pop_into, NULL will be returned.
  *
  * The returned memory is owned by the library and must not be freed.
  */
@@ -394,12 +818,164 @@ ri_pop_result_t ri_consumer_pop(ri_consumer_t *consumer);
 /**
  * @brief ri_consumer_flush get message from the head, discarding all older messages
  *
+ * On a channel with priority lanes only the highest lane holding a new
+ * message is flushed, the lower lanes keep their messages.
+ *
  * @param consumer pointer to consumer
  * @return result
  */
 ri_pop_result_t ri_consumer_flush(ri_consumer_t *consumer);
 
 
+/**
+ * @brief Returns the priority lane of the consumer's current message.
+ *
+ * @param consumer Pointer to the consumer.
+ * @return The lane, 0 for plain channels.
+ */
+unsigned ri_consumer_lane(const ri_consumer_t *consumer);
+
+
+/**
+ * @brief Publishes the messages the consumer is interested in.
+ *
+ * Only available for channels with @ref ri_attr_t::interest set. Until
+ * the consumer calls this, all messages are wanted. The filter is
+ * advisory: a producer that doesn't ask @ref ri_producer_should_push
+ * still pushes every message.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param mask     Bit t set if messages of type t (0..63) are wanted.
+ * @param interval Minimum time between two messages in nanoseconds,
+ *                 0 for no rate cap.
+ * @return 0 on success, -ENOTSUP if the channel has no interest word.
+ */
+int ri_consumer_set_interest(ri_consumer_t *consumer, uint64_t mask, uint64_t interval);
+
+
+/**
+ * @brief Returns the number of messages waiting behind the current one.
+ *
+ * Calculated in constant time from the message numbers of
+ * @ref ri_attr_t::watermark and the head index, without walking the
+ * chain. The result is a snapshot, the producer may push concurrently.
+ *
+ * @param consumer Pointer to the consumer.
+ * @return Number of messages a pop loop would return now, at most the
+ *         capacity of the queue, -ENOTSUP if the channel has no
+ *         watermark, -EIO if the shared memory holds an invalid head.
+ */
+int ri_consumer_backlog(const ri_consumer_t *consumer);
+
+
+/**
+ * @brief Pops the next message into a private buffer and releases its slot.
+ *
+ * Works like @ref ri_consumer_pop, but copies the message to @p dst and
+ * hands the slot back to the producer right away. While a consumer holds
+ * a slot, a producer on a full queue has to jump over it and discard the
+ * message after it; a released slot is reused instead, so consumers that
+ * process messages slowly don't cause extra discards.
+ *
+ * @ref ri_consumer_msg returns NULL afterwards.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param dst      Destination, only written if a message was popped.
+ * @param size     Size of @p dst, at least the message size.
+ *
+ * @return Same as @ref ri_consumer_pop, RI_POP_RESULT_ERROR if @p size
+ *         is too small.
+ */
+ri_pop_result_t ri_consumer_pop_into(ri_consumer_t *consumer, void *dst, size_t size);
+
+
+/**
+ * @brief Leases the consumer's current message.
+ *
+ * The message stays valid and unchanged after the consumer popped newer
+ * messages, until the lease is released. This allows windowed processing
+ * of the last few messages without copying them.
+ *
+ * A lease released after the producer replaced its slot becomes available
+ * again with the producer's next push.
+ *
+ * @param consumer Pointer to the consumer.
+ * @return The lease id (< @ref ri_attr_t::max_leases) on success,
+ *         -ENOTSUP if the channel has no leases,
+ *         -ENOENT if the consumer holds no message,
+ *         -EALREADY if the current message is leased already,
+ *         -EBUSY if all leases are in use.
+ */
+int ri_consumer_lease(ri_consumer_t *consumer);
+
+
+/**
+ * @brief Returns the message of a lease.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param id       Lease id returned by @ref ri_consumer_lease.
+ * @return The leased message, NULL if @p id is not leased.
+ */
+const void* ri_consumer_lease_msg(const ri_consumer_t *consumer, unsigned id);
+
+
+/**
+ * @brief Releases a lease, leases can be released in any order.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param id       Lease id returned by @ref ri_consumer_lease.
+ * @return 0 on success, -EINVAL if @p id is not leased.
+ */
+int ri_consumer_release(ri_consumer_t *consumer, unsigned id);
+
+
+/**
+ * @brief Returns the blocks that changed with the current message.
+ *
+ * Only available for channels with @ref ri_attr_t::dirty_block set.
+ * Bit (b % 64) of word b / 64 is set if block b of the message held by the
+ * consumer differs from the previously popped message. If messages were
+ * skipped (discarded, flushed or the first message) or the producer
+ * wrote the message without its cache, all blocks are reported.
+ *
+ * The bitmap stays valid until the next pop or flush.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param n_blocks Receives the number of blocks, may be NULL.
+ * @return The bitmap, or NULL if dirty tracking is disabled or no
+ *         message was popped yet.
+ */
+const uint64_t* ri_consumer_dirty(const ri_consumer_t *consumer, unsigned *n_blocks);
+
+
+/**
+ * @typedef ri_blob_t
+ * @brief Handle of a blob in the heap of a channel.
+ *
+ * Handles are plain values, they are stored in a message by the producer
+ * and resolved by the consumer with @ref ri_consumer_blob.
+ */
+typedef struct ri_blob {
+  uint32_t offset; /**< Offset inside the blob heap */
+  uint32_t size;   /**< Size of the blob in bytes */
+} ri_blob_t;
+
+
+/**
+ * @brief Resolves a blob handle found in the consumer's current message.
+ *
+ * A blob stays valid as long as the message referencing it: while it is
+ * the consumer's current message or leased. After
+ * @ref ri_consumer_pop_into the producer may reuse the blob at any time.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param blob     Handle written by the producer.
+ * @return Pointer to the blob, NULL if the channel has no blob heap or
+ *         the handle lies outside of it.
+ */
+const void* ri_consumer_blob(const ri_consumer_t *consumer, ri_blob_t blob);
+
+
 /**
  * @brief Get the size of messages in the consumer's message queue.
  *
@@ -441,9 +1017,9 @@ ri_info_t ri_consumer_info(const ri_consumer_t *consumer);
 /**
  * @brief Delete the user-defined metadata associated with a consumer channel.
  *
- * Frees any application-specific information attached to the consumer.
- * This should be called when the metadata is no longer needed to avoid
- * unnecessary memory usage.
+ * Detaches any application-specific information from the consumer.
+ * The memory holding it is part of the consumer's storage and is released
+ * together with the vector storage.
  *
  * @param consumer Pointer to the consumer.
  */
@@ -616,45 +1192,832 @@ int ri_producer_take_eventfd(ri_producer_t *producer);
 
 
 /**
- * @brief Enables producer-side message caching.
- *
- * When caching is enabled, @ref ri_producer_msg returns a pointer to an
- * internal buffer owned by the producer instead of directly exposing the
- * shared memory slot. This cache is written back to shared memory on the
- * next successful push operation.
- *
- * Caching provides two important guarantees:
- *
- * - **Isolation from the peer:** The producer operates on a private copy
- *   of the message that cannot be modified by the consumer process. This
- *   protects reads from accidental corruption or malicious interference
- *   originating from the peer.
- *
- * - **Safe partial updates:** The cache is initialized with the current
- *   message contents, allowing the producer to modify only selected fields
- *   while the rest of the message remains valid. This prevents accidental
- *   reuse of undefined data from a previous message slot.
+ * @brief Allocates a blob for the producer's current message.
  *
- * The trade-off is that the channel is no longer zero-copy while caching
- * is enabled, as each push requires copying the cached buffer into shared
- * memory.
+ * The blob belongs to the message pushed next and is freed when the
+ * producer reuses that message's slot, all blobs of a message are
+ * allocated before it is pushed. The returned memory lies in shared
+ * memory, it is written in place and published with the push.
  *
- * @return 0 on success, negative on error
+ * @param producer Pointer to the producer.
+ * @param size     Size of the blob in bytes.
+ * @param blob     Receives the handle to store in the message.
+ * @return Pointer to the blob, NULL if the channel has no blob heap,
+ *         @p size is 0 or the heap has no contiguous space left.
  */
-int ri_producer_cache_enable(ri_producer_t *producer);
+void* ri_producer_blob_alloc(ri_producer_t *producer, size_t size, ri_blob_t *blob);
 
 
 /**
- * @brief Disables message caching and writes cached data back.
+ * @brief Selects the priority lane of the following messages.
  *
- * After this call, @ref ri_producer_msg returns a direct pointer to the
- * shared memory message slot again.
+ * Every lane has a current message of its own, @ref ri_producer_msg and
+ * the push functions operate on the selected lane until another one is
+ * selected. Lane 0 is selected initially.
+ *
+ * @param producer Pointer to the producer.
+ * @param lane     Lane, below @ref ri_attr_t::lanes.
+ * @return 0 on success, -EINVAL if the channel has no such lane.
  */
-void ri_producer_cache_disable(ri_producer_t *producer);
+int ri_producer_select_lane(ri_producer_t *producer, unsigned lane);
 
 
 /**
- * @brief Returns the user-defined metadata associated with the producer channel.
+ * @brief Checks whether the consumer wants the next message.
+ *
+ * Called before the message is prepared, so a decimated or filtering
+ * consumer saves the producer the work, the copy and the notification.
+ * A true result counts as a push for the rate cap, the next message is
+ * granted once the consumer's interval has passed. The clock is only
+ * read if the consumer set a rate cap.
+ *
+ * @param producer Pointer to the producer.
+ * @param type     Application defined type of the message, 0..63.
+ * @return true if the message should be pushed, always true for
+ *         channels without @ref ri_attr_t::interest.
+ */
+bool ri_producer_should_push(ri_producer_t *producer, unsigned type);
+
+
+/**
+ * @brief Reports the progress of the consumer.
+ *
+ * Messages are numbered from 1 in push order. The difference of both
+ * numbers is the consumer's lag: messages still queued plus the ones
+ * discarded or flushed without being seen. Reading the progress costs a
+ * single load of a cacheline the producer doesn't write.
+ *
+ * @param producer Pointer to the producer.
+ * @param pushed   Receives the number of the latest pushed message,
+ *                 may be NULL.
+ * @param consumed Receives the number of the latest message popped by
+ *                 the consumer, 0 if none, may be NULL.
+ * @return 0 on success, -ENOTSUP if the channel has no
+ *         @ref ri_attr_t::watermark.
+ */
+int ri_producer_progress(const ri_producer_t *producer, uint64_t *pushed, uint64_t *consumed);
+
+
+/**
+ * @brief Returns the number of messages queued for the consumer.
+ *
+ * Calculated in constant time from the message numbers of
+ * @ref ri_attr_t::watermark, neither the chain nor the payload are read.
+ * The result is a snapshot, the consumer may pop concurrently.
+ *
+ * @param producer Pointer to the producer.
+ * @return Number of pushed messages the consumer didn't pop yet, at most
+ *         the capacity of the queue, -ENOTSUP if the channel has no
+ *         watermark.
+ */
+int ri_producer_occupancy(const ri_producer_t *producer);
+
+
+/**
+ * @brief Enables producer-side message caching.
+ *
+ * When caching is enabled, @ref ri_producer_msg returns a pointer to an
+ * internal buffer owned by the producer instead of directly exposing the
+ * shared memory slot. This cache is written back to shared memory on the
+ * next successful push operation.
+ *
+ * Caching provides two important guarantees:
+ *
+ * - **Isolation from the peer:** The producer operates on a private copy
+ *   of the message that cannot be modified by the consumer process. This
+ *   protects reads from accidental corruption or malicious interference
+ *   originating from the peer.
+ *
+ * - **Safe partial updates:** The cache is initialized with the current
+ *   message contents, allowing the producer to modify only selected fields
+ *   while the rest of the message remains valid. This prevents accidental
+ *   reuse of undefined data from a previous message slot.
+ *
+ * The trade-off is that the channel is no longer zero-copy while caching
+ * is enabled, as each push requires copying the cached buffer into shared
+ * memory.
+ *
+ * The cache buffer is reserved when the producer is created with
+ * @ref ri_attr_t::cache, so enabling the cache never allocates.
+ *
+ * @return 0 on success, -ENOTSUP for channels with priority lanes,
+ *         -ENOBUFS if the channel reserved no cache buffer
+ */
+int ri_producer_cache_enable(ri_producer_t *producer);
+
+
+/**
+ * @brief Disables message caching and writes cached data back.
+ *
+ * After this call, @ref ri_producer_msg returns a direct pointer to the
+ * shared memory message slot again.
+ */
+void ri_producer_cache_disable(ri_producer_t *producer);
+
+
+/**
+ * @brief Marks a range of the cached message as modified.
+ *
+ * Only meaningful for channels with @ref ri_attr_t::dirty_block set and the
+ * producer cache enabled. The blocks overlapping the range are copied on
+ * the following pushes until every slot received them; unmarked blocks
+ * are never written back, so every modification of the cache must be
+ * marked. Marks are reported to consumers with the next push.
+ *
+ * @param producer Pointer to the producer.
+ * @param offset   Offset of the modified range in the message.
+ * @param size     Size of the modified range in bytes.
+ * @return 0 on success, -EINVAL if the range exceeds the message,
+ *         -ENOTSUP if dirty tracking is disabled.
+ */
+int ri_producer_mark_dirty(ri_producer_t *producer, size_t offset, size_t size);
+
+
+/**
+ * @enum ri_copy_mode_t
+ * @brief How the producer cache is written back to shared memory.
+ */
+typedef enum ri_copy_mode {
+  /**
+   * Plain copy for small messages, streaming stores for messages of at
+   * least RI_COPY_STREAM_THRESHOLD bytes (64 KiB unless overridden at
+   * build time).
+   */
+  RI_COPY_AUTO = 0,
+
+  /** memcpy */
+  RI_COPY_PLAIN,
+
+  /** Regular SIMD loads and stores, the message ends up in the producer's cache. */
+  RI_COPY_TEMPORAL,
+
+  /**
+   * SIMD non-temporal (streaming) stores, which bypass the producer's
+   * cache. Avoids evicting the producer's working set for large messages,
+   * but the consumer always reads the message from memory.
+   */
+  RI_COPY_STREAMING,
+} ri_copy_mode_t;
+
+
+/**
+ * @brief Selects how the producer cache is written back on push.
+ *
+ * The widest SIMD instruction set supported by the CPU (AVX-512, AVX2,
+ * SSE2 or NEON) is selected at runtime. Without SIMD support all modes
+ * fall back to a plain copy.
+ *
+ * @param producer Pointer to the producer.
+ * @param mode     Copy mode, @ref RI_COPY_AUTO by default.
+ * @return 0 on success, -EINVAL if @p mode is invalid.
+ */
+int ri_producer_set_copy_mode(ri_producer_t *producer, ri_copy_mode_t mode);
+
+
+/**
+ * @brief Enables write prefetching of the producer's next message slot.
+ *
+ * After every successful push the first @p distance bytes of the slot
+ * the producer writes next are prefetched with intent to write, so the
+ * cachelines are owned exclusively by the time the message is written.
+ * Mostly useful for large messages exchanged across sockets.
+ *
+ * @param producer Pointer to the producer.
+ * @param distance Bytes to prefetch, clamped to the message size.
+ *                 0 disables prefetching (default).
+ */
+void ri_producer_set_prefetch(ri_producer_t *producer, size_t distance);
+
+
+/**
+ * @brief Enables read prefetching of the consumer's next message.
+ *
+ * After every pop, if the producer already published a newer message,
+ * its chain entry and the first @p distance bytes of its payload are
+ * prefetched, so the next pop and the first reads of the message hit the
+ * cache. Unpublished slots are never touched.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param distance Bytes to prefetch, clamped to the message size.
+ *                 0 disables prefetching (default).
+ */
+void ri_consumer_set_prefetch(ri_consumer_t *consumer, size_t distance);
+
+
+/**
+ * @brief Forwards the consumer's current message to a producer without copying.
+ *
+ * Exchanges the buffer of the consumer's current message with the buffer
+ * of the producer's current message; afterwards @ref ri_producer_msg
+ * returns the relayed message, which can be modified and pushed as usual.
+ * The consumer's slot is handed back to its producer right away and
+ * @ref ri_consumer_msg returns NULL.
+ *
+ * Both channels need @ref ri_attr_t::relay and the same message size and
+ * alignment, and must belong to the same vector.
+ *
+ * @param consumer Pointer to the consumer.
+ * @param producer Pointer to the producer, its cache must be disabled.
+ * @return 0 on success,
+ *         -ENOTSUP if a channel wasn't created with relay,
+ *         -EXDEV if the channels don't share the shared memory,
+ *         -EINVAL if the message sizes differ or a buffer offset is invalid,
+ *         -EBUSY if the producer cache is enabled or the message is leased,
+ *         -ENOENT if the consumer holds no message.
+ */
+int ri_consumer_relay(ri_consumer_t *consumer, ri_producer_t *producer);
+
+
+/**
+ * @brief Stages the current message of a producer for the next transaction.
+ *
+ * Staged messages are pushed together by @ref ri_vector_tx_commit, so a
+ * consumer using @ref ri_vector_pop_consistent never combines messages
+ * of different commits. The producer must belong to @p vec, which must
+ * stay alive while its channels use transactions.
+ *
+ * @param vec      Pointer to the vector.
+ * @param producer Producer whose current message joins the transaction.
+ * @return 0 on success, -EINVAL if the producer wasn't created by @p vec,
+ *         -EALREADY if the producer is staged already,
+ *         -ENOSPC if more producers are staged than the vector has.
+ */
+int ri_vector_tx_stage(ri_vector_t *vec, ri_producer_t *producer);
+
+
+/**
+ * @brief Pushes all staged messages as one transaction.
+ *
+ * The vector's epoch is odd while the messages are pushed and is
+ * incremented to the next even value afterwards. Messages are pushed
+ * with @ref ri_producer_force_push.
+ *
+ * @param vec Pointer to the vector.
+ * @return 0 on success, -EIO if a push failed.
+ */
+int ri_vector_tx_commit(ri_vector_t *vec);
+
+
+/**
+ * @brief Drops all staged producers without pushing.
+ */
+void ri_vector_tx_abort(ri_vector_t *vec);
+
+
+/**
+ * @brief Flushes a set of consumers to a consistent snapshot.
+ *
+ * Every consumer gets the newest message of its channel (see
+ * @ref ri_consumer_flush), and all of them belong to the same commit of
+ * the peer's transactions or earlier ones: no consumer sees a message
+ * committed after the message of another one. The channels of the set
+ * should only be pushed through transactions.
+ *
+ * @param vec       Pointer to the vector.
+ * @param consumers Consumers of @p vec forming the set.
+ * @param n         Number of consumers.
+ * @param epoch     Receives the number of the peer's commits covered by
+ *                  the snapshot, may be NULL.
+ * @return 1 if a consumer got a new message, 0 if none did,
+ *         -EAGAIN if the peer kept committing during every attempt, the
+ *         messages of the consumers may be inconsistent then,
+ *         -EIO if a consumer failed.
+ */
+int ri_vector_pop_consistent(ri_vector_t *vec, ri_consumer_t *consumers[], unsigned n, uint64_t *epoch);
+
+
+/**
+ * @typedef ri_barrier_t
+ * @brief Opaque handle of a participant of a step barrier.
+ *
+ * The barrier lives in the shared memory of a vector created with
+ * @ref ri_config_t::barrier_participants. No participant completes step
+ * N + 1 before all participants arrived at step N. Waiting spins first and
+ * sleeps on a futex in the shared memory afterwards, so a step costs a few
+ * cache misses when all participants are running.
+ */
+typedef struct ri_barrier ri_barrier_t;
+
+
+/**
+ * @brief Creates the handle of a barrier participant.
+ *
+ * Every participant index must be used by one handle at a time, across
+ * all processes mapping the vector. A new handle of a participant
+ * continues at the participant's last step. The handles are part of the
+ * vector's storage, see @ref ri_vector_storage_size, and keep it and the
+ * shared memory alive after the vector is deleted.
+ *
+ * @param vec         Pointer to the vector.
+ * @param participant Index of the participant.
+ * @return Pointer to the handle, or NULL if the vector has no barrier,
+ *         @p participant is out of range or its handle of this vector
+ *         was not deleted yet.
+ */
+ri_barrier_t* ri_vector_barrier(const ri_vector_t *vec, unsigned participant);
+
+
+/**
+ * @brief Deletes a barrier handle.
+ *
+ * The participant's handle can be created from the vector again afterwards.
+ */
+void ri_barrier_delete(ri_barrier_t *barrier);
+
+
+/**
+ * @brief Returns the number of participants of the barrier.
+ */
+unsigned ri_barrier_num_participants(const ri_barrier_t *barrier);
+
+
+/**
+ * @brief Arrives at the next step.
+ *
+ * Announces that the participant finished its current step. Never waits,
+ * so work can be done before @ref ri_barrier_wait. The last participant
+ * to arrive releases the step and wakes sleeping participants.
+ *
+ * @param barrier Pointer to the handle.
+ * @return 0 on success, -EBUSY if the participant's previous step is not
+ *         complete yet.
+ */
+int ri_barrier_arrive(ri_barrier_t *barrier);
+
+
+/**
+ * @brief Waits until all participants arrived at the participant's step.
+ *
+ * @param barrier    Pointer to the handle.
+ * @param timeout_ns Maximum time to wait in nanoseconds, negative to wait
+ *                   forever, 0 to only spin.
+ * @return 0 once the step is complete, -ETIMEDOUT otherwise. The
+ *         participant stays arrived and may wait again.
+ */
+int ri_barrier_wait(ri_barrier_t *barrier, int64_t timeout_ns);
+
+
+/**
+ * @brief Returns the last step a participant arrived at.
+ *
+ * Every participant has its own step counter, e.g. to find the
+ * participant holding up a step.
+ *
+ * @param barrier     Pointer to a handle of the barrier.
+ * @param participant Index of the participant.
+ * @return The step, 0 before the first arrival or if @p participant is
+ *         out of range.
+ */
+uint64_t ri_barrier_step(const ri_barrier_t *barrier, unsigned participant);
+
+
+/**
+ * @typedef ri_merge_t
+ * @brief Opaque handle of a merge consumer, see @ref ri_merge_new.
+ */
+typedef struct ri_merge ri_merge_t;
+
+
+/**
+ * @brief Creates a consumer returning the messages of several channels
+ *        in timestamp order.
+ *
+ * Every message carries a uint64_t timestamp at @p ts_offset, in a unit
+ * chosen by the application. The merge holds the oldest unreturned
+ * message of every consumer in its slot and keeps a small heap of them,
+ * messages are neither copied nor reordered in shared memory.
+ *
+ * The consumers must stay valid and must not be popped by anyone else
+ * until the merge is deleted. Channels with timestamps in non-decreasing
+ * order are merged in global order, except for messages arriving after
+ * the lateness bound, which are returned as soon as possible.
+ *
+ * @param consumers Consumers to merge.
+ * @param n         Number of consumers, at least 1.
+ * @param ts_offset Offset of the timestamp inside the messages.
+ * @param lateness  Time a message is held back waiting for silent
+ *                  consumers, in timestamp units.
+ * @return The merge, NULL if the timestamp doesn't fit into the messages
+ *         of a consumer or on allocation failure.
+ */
+ri_merge_t* ri_merge_new(ri_consumer_t *consumers[], unsigned n, size_t ts_offset, uint64_t lateness);
+
+
+/**
+ * @brief Returns the storage size needed by @ref ri_merge_init.
+ *
+ * @param n Number of consumers.
+ * @return The number of bytes required.
+ */
+size_t ri_merge_storage_size(unsigned n);
+
+
+/**
+ * @brief Creates a merge in caller-provided storage.
+ *
+ * Behaves like @ref ri_merge_new, but places the merge in @p storage, which
+ * must stay valid until the merge is deleted.
+ *
+ * @param storage Caller-provided memory, no alignment required.
+ * @param size    Size of @p storage in bytes, at least
+ *                @ref ri_merge_storage_size.
+ * @return The merge, or NULL on failure.
+ */
+ri_merge_t* ri_merge_init(ri_consumer_t *consumers[], unsigned n, size_t ts_offset, uint64_t lateness,
+                          void *storage, size_t size);
+
+
+/**
+ * @brief Deletes a merge, the consumers are left untouched.
+ */
+void ri_merge_delete(ri_merge_t *merge);
+
+
+/**
+ * @brief Returns the next message in timestamp order.
+ *
+ * The oldest message is returned once every consumer has a message
+ * pending, or once it is older than @p now minus the lateness bound.
+ * Until then a silent consumer may still deliver an older message.
+ * The message stays valid until the next call.
+ *
+ * @param merge Pointer to the merge.
+ * @param now   Current time in timestamp units.
+ * @param msg   Receives the message.
+ * @return Index of the consumer the message came from, -EAGAIN if no
+ *         message is due, -EIO if a consumer failed.
+ */
+int ri_merge_next(ri_merge_t *merge, uint64_t now, const void **msg);
+
+
+/**
+ * @brief Size of the header in front of every RPC request and response.
+ *
+ * The channels of an RPC connection need messages of this size plus the
+ * largest payload.
+ */
+#define RI_RPC_HEADER_SIZE 8
+
+
+/**
+ * @typedef ri_rpc_client_t
+ * @brief Opaque handle of the calling side of an RPC connection.
+ *
+ * An RPC connection is a request channel from the client to the server
+ * and a response channel back. Every request carries a call id, so many
+ * calls can be outstanding at once. Requests and responses are written in
+ * place into the channel slots, and both sides only use try push, so
+ * calls are never discarded; a full channel is reported as -EAGAIN.
+ */
+typedef struct ri_rpc_client ri_rpc_client_t;
+
+
+/**
+ * @typedef ri_rpc_server_t
+ * @brief Opaque handle of the serving side of an RPC connection.
+ */
+typedef struct ri_rpc_server ri_rpc_server_t;
+
+
+/**
+ * @typedef ri_rpc_result_t
+ * @brief A completed call, returned by @ref ri_rpc_client_poll.
+ */
+typedef struct ri_rpc_result {
+  uint64_t id;          /**< Id returned by @ref ri_rpc_client_send */
+  const void *response; /**< Response payload, valid until the next poll */
+  uint64_t latency;     /**< Time from the send to the poll in nanoseconds */
+} ri_rpc_result_t;
+
+
+/**
+ * @brief Handles one request on the server.
+ *
+ * @param arg      User argument passed to @ref ri_rpc_server_process.
+ * @param request  Request payload.
+ * @param response Response payload, written in place into the slot.
+ */
+typedef void (*ri_rpc_handler_fn)(void *arg, const void *request, void *response);
+
+
+/**
+ * @brief Creates the client side of an RPC connection.
+ *
+ * The channels stay owned by the caller and must outlive the client,
+ * they must not be used by anyone else meanwhile.
+ *
+ * @param requests    Producer of the request channel.
+ * @param responses   Consumer of the response channel.
+ * @param max_pending Maximum number of outstanding calls.
+ * @return The client, NULL if a channel's messages are smaller than
+ *         @ref RI_RPC_HEADER_SIZE or on allocation failure.
+ */
+ri_rpc_client_t* ri_rpc_client_new(ri_producer_t *requests, ri_consumer_t *responses, unsigned max_pending);
+
+
+/**
+ * @brief Returns the storage size needed by @ref ri_rpc_client_init.
+ *
+ * @param max_pending Maximum number of outstanding calls.
+ * @return The number of bytes required.
+ */
+size_t ri_rpc_client_storage_size(unsigned max_pending);
+
+
+/**
+ * @brief Creates an RPC client in caller-provided storage.
+ *
+ * Behaves like @ref ri_rpc_client_new, but places the client in
+ * @p storage, which must stay valid until the client is deleted.
+ *
+ * @param storage Caller-provided memory, no alignment required.
+ * @param size    Size of @p storage in bytes, at least
+ *                @ref ri_rpc_client_storage_size.
+ * @return The client, or NULL on failure.
+ */
+ri_rpc_client_t* ri_rpc_client_init(ri_producer_t *requests, ri_consumer_t *responses, unsigned max_pending,
+                                    void *storage, size_t size);
+
+
+/**
+ * @brief Deletes the client, the channels are left untouched.
+ */
+void ri_rpc_client_delete(ri_rpc_client_t *client);
+
+
+/**
+ * @brief Returns the payload of the next request.
+ *
+ * The payload lies in the slot of the request channel, it is sent with
+ * @ref ri_rpc_client_send and keeps its content if the send fails.
+ *
+ * @return The payload, NULL if max_pending calls are outstanding.
+ */
+void* ri_rpc_client_request(const ri_rpc_client_t *client);
+
+
+/**
+ * @brief Sends the request written to @ref ri_rpc_client_request.
+ *
+ * @param client Pointer to the client.
+ * @param id     Receives the id of the call, may be NULL.
+ * @return 0 on success, -EBUSY if max_pending calls are outstanding,
+ *         -EAGAIN if the request channel is full, -EIO on error.
+ */
+int ri_rpc_client_send(ri_rpc_client_t *client, uint64_t *id);
+
+
+/**
+ * @brief Returns the next completed call.
+ *
+ * Responses arrive in request order.
+ *
+ * @param client Pointer to the client.
+ * @param result Receives the call, only written if 1 is returned.
+ * @return 1 if a call completed, 0 if no response is available,
+ *         -EPROTO if the response doesn't answer the oldest pending call,
+ *         -EIO on error.
+ */
+int ri_rpc_client_poll(ri_rpc_client_t *client, ri_rpc_result_t *result);
+
+
+/**
+ * @brief Returns the number of outstanding calls.
+ */
+unsigned ri_rpc_client_pending(const ri_rpc_client_t *client);
+
+
+/**
+ * @brief Creates the server side of an RPC connection.
+ *
+ * The channels stay owned by the caller and must outlive the server.
+ *
+ * @param requests  Consumer of the request channel.
+ * @param responses Producer of the response channel.
+ * @return The server, NULL if a channel's messages are smaller than
+ *         @ref RI_RPC_HEADER_SIZE or on allocation failure.
+ */
+ri_rpc_server_t* ri_rpc_server_new(ri_consumer_t *requests, ri_producer_t *responses);
+
+
+/**
+ * @brief Returns the storage size needed by @ref ri_rpc_server_init.
+ *
+ * @return The number of bytes required.
+ */
+size_t ri_rpc_server_storage_size(void);
+
+
+/**
+ * @brief Creates an RPC server in caller-provided storage.
+ *
+ * Behaves like @ref ri_rpc_server_new, but places the server in
+ * @p storage, which must stay valid until the server is deleted.
+ *
+ * @param storage Caller-provided memory, no alignment required.
+ * @param size    Size of @p storage in bytes, at least
+ *                @ref ri_rpc_server_storage_size.
+ * @return The server, or NULL on failure.
+ */
+ri_rpc_server_t* ri_rpc_server_init(ri_consumer_t *requests, ri_producer_t *responses,
+                                    void *storage, size_t size);
+
+
+/**
+ * @brief Deletes the server, the channels are left untouched.
+ */
+void ri_rpc_server_delete(ri_rpc_server_t *server);
+
+
+/**
+ * @brief Handles a batch of queued requests.
+ *
+ * Calls @p handler for up to @p max_batch requests in arrival order and
+ * pushes every response right after its handler returned. If the
+ * response channel is full, the written response is kept and pushed by
+ * the next call before further requests are handled. Never blocks.
+ *
+ * @param server    Pointer to the server.
+ * @param handler   Request handler.
+ * @param arg       Passed to @p handler.
+ * @param max_batch Maximum number of requests handled by this call.
+ * @return Number of responses pushed, -EIO on error.
+ */
+int ri_rpc_server_process(ri_rpc_server_t *server, ri_rpc_handler_fn handler, void *arg,
+                          unsigned max_batch);
+
+
+/**
+ * @typedef ri_cycle_t
+ * @brief Opaque handle of a cyclic executive, see @ref ri_cycle_new.
+ */
+typedef struct ri_cycle ri_cycle_t;
+
+
+/**
+ * @brief Timing statistics of a cyclic executive, in nanoseconds.
+ *
+ * The latency is the delay of the wake-up after the start of the period,
+ * its jitter is latency_max - latency_min.
+ */
+typedef struct ri_cycle_stats {
+  uint64_t cycles;      /**< Executed cycles */
+  uint64_t missed;      /**< Periods without a cycle, after an overrun or a late wake-up */
+  uint64_t overruns;    /**< Cycles that ended after the start of the next period */
+  uint64_t latency_min; /**< Minimal wake-up latency */
+  uint64_t latency_max; /**< Maximal wake-up latency */
+  uint64_t latency_sum; /**< Sum of the wake-up latencies */
+  uint64_t exec_max;    /**< Maximal execution time from wake-up to the end of the publish */
+  uint64_t exec_sum;    /**< Sum of the execution times */
+} ri_cycle_stats_t;
+
+
+/**
+ * @brief Computes one cycle.
+ *
+ * @param arg   User argument passed to @ref ri_cycle_step.
+ * @param cycle Number of the period, counting skipped ones.
+ * @return 0 to continue, a positive value to stop @ref ri_cycle_run,
+ *         a negative errno to stop with an error.
+ */
+typedef int (*ri_cycle_fn)(void *arg, uint64_t cycle);
+
+
+/**
+ * @brief Creates a cyclic executive.
+ *
+ * Every cycle waits for the next period of a timerfd on CLOCK_MONOTONIC,
+ * flushes all consumers to their newest message, calls the cycle function
+ * and pushes the producers marked with @ref ri_cycle_publish. The channels
+ * stay owned by the caller and must outlive the executive.
+ *
+ * @param period_ns   Period in nanoseconds.
+ * @param consumers   Consumers flushed at the start of every cycle.
+ * @param n_consumers Number of consumers.
+ * @param producers   Producers published at the end of a cycle.
+ * @param n_producers Number of producers.
+ * @return Pointer to the executive, or NULL on failure.
+ */
+ri_cycle_t* ri_cycle_new(uint64_t period_ns, ri_consumer_t *consumers[], unsigned n_consumers,
+                         ri_producer_t *producers[], unsigned n_producers);
+
+
+/**
+ * @brief Returns the storage size needed by @ref ri_cycle_init.
+ *
+ * @param n_consumers Number of consumers.
+ * @param n_producers Number of producers.
+ * @return The number of bytes required.
+ */
+size_t ri_cycle_storage_size(unsigned n_consumers, unsigned n_producers);
+
+
+/**
+ * @brief Creates a cyclic executive in caller-provided storage.
+ *
+ * Behaves like @ref ri_cycle_new, but places the executive in @p storage,
+ * which must stay valid until the executive is deleted.
+ *
+ * @param storage Caller-provided memory, no alignment required.
+ * @param size    Size of @p storage in bytes, at least
+ *                @ref ri_cycle_storage_size.
+ * @return Pointer to the executive, or NULL on failure.
+ */
+ri_cycle_t* ri_cycle_init(uint64_t period_ns, ri_consumer_t *consumers[], unsigned n_consumers,
+                          ri_producer_t *producers[], unsigned n_producers, void *storage, size_t size);
+
+
+/**
+ * @brief Deletes a cyclic executive, the channels are not deleted.
+ */
+void ri_cycle_delete(ri_cycle_t *cycle);
+
+
+/**
+ * @brief Returns the timerfd of the executive, owned by the executive.
+ *
+ * It becomes readable at the start of every period once the executive was
+ * started, so it can be polled together with other descriptors before
+ * calling @ref ri_cycle_step.
+ */
+int ri_cycle_fd(const ri_cycle_t *cycle);
+
+
+/**
+ * @brief Starts the periods, the first one begins one period from now.
+ *
+ * Called by the first @ref ri_cycle_step if needed. Calling it again
+ * restarts the periods.
+ *
+ * @return 0 on success, -errno if the timer can't be armed.
+ */
+int ri_cycle_start(ri_cycle_t *cycle);
+
+
+/**
+ * @brief Executes one cycle.
+ *
+ * Blocks until the next period starts, flushes the consumers, calls
+ * @p fn, pushes the marked producers and updates the statistics.
+ *
+ * @param cycle Pointer to the executive.
+ * @param fn    Cycle function, may be NULL.
+ * @param arg   Passed to @p fn.
+ * @return The result of @p fn, -EIO if a channel failed, -errno if waiting
+ *         failed (e.g. -EINTR).
+ */
+int ri_cycle_step(ri_cycle_t *cycle, ri_cycle_fn fn, void *arg);
+
+
+/**
+ * @brief Executes cycles until @p fn stops them.
+ *
+ * @param n_cycles Maximum number of cycles, 0 for no limit.
+ * @return 0 if @p fn returned a positive value or all cycles were
+ *         executed, a negative errno like @ref ri_cycle_step otherwise.
+ */
+int ri_cycle_run(ri_cycle_t *cycle, ri_cycle_fn fn, void *arg, uint64_t n_cycles);
+
+
+/**
+ * @brief Tells whether a consumer got a new message in the current cycle.
+ *
+ * @param cycle Pointer to the executive.
+ * @param index Index of the consumer as passed to @ref ri_cycle_new.
+ * @return true if the flush at the start of the cycle returned a new
+ *         message, false otherwise or if @p index is out of range.
+ */
+bool ri_cycle_updated(const ri_cycle_t *cycle, unsigned index);
+
+
+/**
+ * @brief Marks a producer to be pushed at the end of the current cycle.
+ *
+ * The cycle function writes the message with @ref ri_producer_msg and
+ * marks it, all marked producers are pushed together after the function
+ * returned.
+ *
+ * @param cycle Pointer to the executive.
+ * @param index Index of the producer as passed to @ref ri_cycle_new.
+ * @return 0 on success, -EINVAL if @p index is out of range.
+ */
+int ri_cycle_publish(ri_cycle_t *cycle, unsigned index);
+
+
+/**
+ * @brief Returns the timing statistics since creation or the last reset.
+ */
+void ri_cycle_stats(const ri_cycle_t *cycle, ri_cycle_stats_t *stats);
+
+
+/**
+ * @brief Resets the timing statistics.
+ */
+void ri_cycle_stats_reset(ri_cycle_t *cycle);
+
+
+/**
+ * @brief Returns the user-defined metadata associated with the producer channel.
  *
  * Retrieves the application-specific information previously attached to
  * the producer instance.
@@ -668,15 +2031,257 @@ ri_info_t ri_producer_info(const ri_producer_t *producer);
 /**
  * @brief Delete the user-defined metadata associated with a producer channel.
  *
- * Frees any application-specific information attached to the producer.
- * This should be called when the metadata is no longer needed to avoid
- * unnecessary memory usage.
+ * Detaches any application-specific information from the producer.
+ * The memory holding it is part of the producer's storage and is released
+ * together with the vector storage.
  *
  * @param producer Pointer to the producer.
  */
 void ri_producer_free_info(ri_producer_t *producer);
 
 
+/**
+ * @typedef ri_stream_t
+ * @brief Handle for one end of a byte stream.
+ *
+ * A byte stream is a pipe-like channel without message boundaries. Its
+ * ring is mapped twice back to back, so the spans returned by
+ * @ref ri_stream_acquire are always contiguous, also when they wrap.
+ * Like message channels, streams are wait-free and never block.
+ */
+typedef struct ri_stream ri_stream_t;
+
+
+/**
+ * @brief Transfer ownership of a stream read by this side to the caller.
+ *
+ * @param vec   Pointer to the vector.
+ * @param index Index into @ref ri_config_t::stream_readers.
+ * @return Pointer to the stream on success; NULL on error.
+ */
+ri_stream_t* ri_vector_take_stream_reader(ri_vector_t *vec, unsigned index);
+
+
+/**
+ * @brief Transfer ownership of a stream written by this side to the caller.
+ *
+ * @param vec   Pointer to the vector.
+ * @param index Index into @ref ri_config_t::stream_writers.
+ * @return Pointer to the stream on success; NULL on error.
+ */
+ri_stream_t* ri_vector_take_stream_writer(ri_vector_t *vec, unsigned index);
+
+
+/**
+ * @brief Get the number of streams read by this side.
+ */
+unsigned ri_vector_num_stream_readers(const ri_vector_t *vec);
+
+
+/**
+ * @brief Get the number of streams written by this side.
+ */
+unsigned ri_vector_num_stream_writers(const ri_vector_t *vec);
+
+
+/**
+ * @brief Destroys one end of a stream.
+ */
+void ri_stream_delete(ri_stream_t *stream);
+
+
+/**
+ * @brief Get the capacity of the stream in bytes.
+ */
+size_t ri_stream_size(const ri_stream_t *stream);
+
+
+/**
+ * @brief Writes up to @p size bytes to the stream.
+ *
+ * Like a non-blocking pipe write, but without a system call.
+ *
+ * @return The number of bytes written, 0 if the stream is full,
+ *         -EPERM if @p stream is the reading end.
+ */
+ssize_t ri_stream_write(ri_stream_t *stream, const void *data, size_t size);
+
+
+/**
+ * @brief Reads up to @p size bytes from the stream.
+ *
+ * @return The number of bytes read, 0 if the stream is empty,
+ *         -EPERM if @p stream is the writing end.
+ */
+ssize_t ri_stream_read(ri_stream_t *stream, void *data, size_t size);
+
+
+/**
+ * @brief Returns the contiguous span of the stream available to this end.
+ *
+ * For the writing end the span is the free space, for the reading end
+ * it holds the bytes written but not read yet. The data is accessed in
+ * place and handed over with @ref ri_stream_commit.
+ *
+ * @param stream Pointer to the stream.
+ * @param size   Receives the size of the span, 0 if nothing is available.
+ * @return Start of the span.
+ */
+void* ri_stream_acquire(ri_stream_t *stream, size_t *size);
+
+
+/**
+ * @brief Publishes (writer) or frees (reader) the first bytes of the
+ *        span returned by the last @ref ri_stream_acquire.
+ *
+ * @return 0 on success, -EINVAL if @p size exceeds the span.
+ */
+int ri_stream_commit(ri_stream_t *stream, size_t size);
+
+
+/**
+ * @typedef ri_table_t
+ * @brief Handle for one end of a shared state table.
+ *
+ * A table holds fixed-size entries in shared memory, updated in place by
+ * a single writer. Every entry is protected by its own sequence counter
+ * (seqlock): readers access entries in place without locks or copies and
+ * detect concurrent updates afterwards. The writer never waits.
+ *
+ * With @ref ri_table_attr_t::conflate a table also works as a keyed
+ * conflation channel: the reader takes updated keys with @ref ri_table_pop.
+ */
+typedef struct ri_table ri_table_t;
+
+
+/**
+ * @brief Transfer ownership of a table read by this side to the caller.
+ *
+ * @param vec   Pointer to the vector.
+ * @param index Index into @ref ri_config_t::table_readers.
+ * @return Pointer to the table on success; NULL on error.
+ */
+ri_table_t* ri_vector_take_table_reader(ri_vector_t *vec, unsigned index);
+
+
+/**
+ * @brief Transfer ownership of a table written by this side to the caller.
+ *
+ * @param vec   Pointer to the vector.
+ * @param index Index into @ref ri_config_t::table_writers.
+ * @return Pointer to the table on success; NULL on error.
+ */
+ri_table_t* ri_vector_take_table_writer(ri_vector_t *vec, unsigned index);
+
+
+/**
+ * @brief Get the number of tables read by this side.
+ */
+unsigned ri_vector_num_table_readers(const ri_vector_t *vec);
+
+
+/**
+ * @brief Get the number of tables written by this side.
+ */
+unsigned ri_vector_num_table_writers(const ri_vector_t *vec);
+
+
+/**
+ * @brief Destroys one end of a table.
+ */
+void ri_table_delete(ri_table_t *table);
+
+
+/**
+ * @brief Get the number of entries of the table.
+ */
+unsigned ri_table_num_entries(const ri_table_t *table);
+
+
+/**
+ * @brief Get the size of a table entry in bytes.
+ */
+size_t ri_table_entry_size(const ri_table_t *table);
+
+
+/**
+ * @brief Starts an in-place update of an entry.
+ *
+ * Readers see the entry as busy until @ref ri_table_write_end.
+ *
+ * @param table Pointer to the writing end.
+ * @param key   Index of the entry.
+ * @return The entry, NULL if @p key is out of range or @p table is the
+ *         reading end.
+ */
+void* ri_table_write_begin(ri_table_t *table, unsigned key);
+
+
+/**
+ * @brief Finishes the update started with @ref ri_table_write_begin.
+ */
+void ri_table_write_end(ri_table_t *table, unsigned key);
+
+
+/**
+ * @brief Copies @ref ri_table_entry_size bytes from @p data into an entry.
+ *
+ * @return 0 on success, -EINVAL if @p key is out of range or @p table is
+ *         the reading end.
+ */
+int ri_table_write(ri_table_t *table, unsigned key, const void *data);
+
+
+/**
+ * @brief Starts an in-place read of an entry.
+ *
+ * The entry may be changed by the writer at any time; the values read
+ * are only consistent if @ref ri_table_read_check succeeds afterwards.
+ * The version also serves to detect whether an entry changed since an
+ * earlier read.
+ *
+ * @param table   Pointer to the table.
+ * @param key     Index of the entry.
+ * @param version Receives the version of the entry.
+ * @return The entry, NULL if @p key is out of range or the entry is
+ *         being written right now.
+ */
+const void* ri_table_read_begin(const ri_table_t *table, unsigned key, uint64_t *version);
+
+
+/**
+ * @brief Checks that an entry wasn't changed since @ref ri_table_read_begin.
+ *
+ * @return true if everything read from the entry is consistent.
+ */
+bool ri_table_read_check(const ri_table_t *table, unsigned key, uint64_t version);
+
+
+/**
+ * @brief Copies an entry to @p dst.
+ *
+ * @return 0 on success, -EINVAL if @p key is out of range, -EAGAIN if the
+ *         entry was written concurrently, @p dst is undefined then.
+ */
+int ri_table_read(const ri_table_t *table, unsigned key, void *dst);
+
+
+/**
+ * @brief Takes the next updated key of a table with
+ *        @ref ri_table_attr_t::conflate set.
+ *
+ * Keys are returned in the order of their first update since they were
+ * taken last. Read the entry afterwards, e.g. with @ref ri_table_read;
+ * an update racing with the read queues the key again.
+ *
+ * @param table Pointer to the reading end.
+ * @return The key, -ENOENT if no key is queued, -ENOTSUP if the table
+ *         doesn't conflate, -EPERM for the writing end, -EINVAL if the
+ *         peer queued an invalid key.
+ */
+int ri_table_pop(ri_table_t *table);
+
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,99 @@
+#include "alloc.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rtipc/rtipc.h"
+#include "mem_utils.h"
+
+
+static void* alloc_std(size_t size, size_t align, void *user_data)
+{
+  (void) user_data;
+
+  if (align <= alignof(max_align_t))
+    return malloc(size);
+
+  return aligned_alloc(align, mem_align(size, align));
+}
+
+
+static void free_std(void *ptr, void *user_data)
+{
+  (void) user_data;
+
+  free(ptr);
+}
+
+
+static ri_allocator_t ri_allocator = {
+  .alloc = alloc_std,
+  .free = free_std,
+};
+
+
+void ri_set_allocator(const ri_allocator_t *allocator)
+{
+  if (allocator && allocator->alloc && allocator->free) {
+    ri_allocator = *allocator;
+  } else {
+    ri_allocator = (ri_allocator_t) {
+      .alloc = alloc_std,
+      .free = free_std,
+    };
+  }
+}
+
+
+void* ri_alloc(size_t size)
+{
+  return ri_allocator.alloc(size, alignof(max_align_t), ri_allocator.user_data);
+}
+
+
+void* ri_alloc_aligned(size_t size, size_t align)
+{
+  return ri_allocator.alloc(size, align, ri_allocator.user_data);
+}
+
+
+void* ri_calloc(size_t n, size_t size)
+{
+  if (size && (n > SIZE_MAX / size))
+    return NULL;
+
+  void *ptr = ri_alloc(n * size);
+
+  if (ptr)
+    memset(ptr, 0, n * size);
+
+  return ptr;
+}
+
+
+void ri_free(void *ptr)
+{
+  if (ptr)
+    ri_allocator.free(ptr, ri_allocator.user_data);
+}
+
+
+size_t ri_storage_size(size_t size)
+{
+  /* worst case alignment of caller-provided storage */
+  return size + alignof(max_align_t) - 1;
+}
+
+
+void* ri_storage_place(void *storage, size_t storage_size, size_t size)
+{
+  uintptr_t start = mem_align((uintptr_t)storage, alignof(max_align_t));
+  size_t padding = start - (uintptr_t)storage;
+
+  if (!storage || (storage_size < padding) || (storage_size - padding < size))
+    return NULL;
+
+  return (void*)start;
+}
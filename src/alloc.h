@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+
+/* all heap allocations of the library go through these functions,
+ * see ri_set_allocator() */
+
+void* ri_alloc(size_t size);
+
+void* ri_alloc_aligned(size_t size, size_t align);
+
+void* ri_calloc(size_t n, size_t size);
+
+void ri_free(void *ptr);
+
+/* caller-provided storage for an object of size bytes, aligned like ri_alloc() */
+size_t ri_storage_size(size_t size);
+
+/* places an object of size bytes in storage, NULL if storage is too small */
+void* ri_storage_place(void *storage, size_t storage_size, size_t size);
@@ -0,0 +1,109 @@
+#include "arena.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rtipc/log.h"
+#include "alloc.h"
+#include "mem_utils.h"
+
+
+struct ri_arena {
+  atomic_int ref_cnt;
+  bool owned;
+  size_t size;
+  size_t offset;
+  void *mem;
+};
+
+
+size_t ri_arena_storage_size(size_t size)
+{
+  /* header + worst case alignment of caller-provided storage */
+  return cacheline_aligned(sizeof(ri_arena_t)) + cacheline_aligned(size) + cacheline_size();
+}
+
+
+static ri_arena_t* arena_init(void *storage, size_t storage_size, bool owned)
+{
+  uintptr_t start = mem_align((uintptr_t)storage, cacheline_size());
+  size_t header_size = cacheline_aligned(sizeof(ri_arena_t));
+  size_t padding = start - (uintptr_t)storage;
+
+  if (storage_size < padding + header_size) {
+    LOG_ERR("arena storage too small size=%zu", storage_size);
+    return NULL;
+  }
+
+  ri_arena_t *arena = (ri_arena_t*)start;
+  size_t size = (storage_size - padding - header_size) & ~(cacheline_size() - 1);
+
+  *arena = (ri_arena_t) {
+    .ref_cnt = 1,
+    .owned = owned,
+    .size = size,
+    .mem = mem_offset(arena, header_size),
+  };
+
+  memset(arena->mem, 0, size);
+
+  return arena;
+}
+
+
+ri_arena_t* ri_arena_new(size_t size)
+{
+  size_t storage_size = cacheline_aligned(sizeof(ri_arena_t)) + cacheline_aligned(size);
+
+  void *storage = ri_alloc_aligned(storage_size, cacheline_size());
+  if (!storage)
+    return NULL;
+
+  return arena_init(storage, storage_size, true);
+}
+
+
+ri_arena_t* ri_arena_init(void *storage, size_t storage_size)
+{
+  return arena_init(storage, storage_size, false);
+}
+
+
+void ri_arena_ref(ri_arena_t *arena)
+{
+  atomic_fetch_add(&arena->ref_cnt, 1);
+}
+
+
+void ri_arena_unref(ri_arena_t *arena)
+{
+  if (atomic_fetch_sub(&arena->ref_cnt, 1) == 1) {
+    if (arena->owned)
+      ri_free(arena);
+  }
+}
+
+
+void* ri_arena_alloc(ri_arena_t *arena, size_t size)
+{
+  size = cacheline_aligned(size);
+
+  if (arena->offset + size > arena->size) {
+    LOG_ERR("arena exhausted size=%zu offset=%zu request=%zu", arena->size, arena->offset, size);
+    return NULL;
+  }
+
+  void *ptr = mem_offset(arena->mem, arena->offset);
+
+  arena->offset += size;
+
+  return ptr;
+}
+
+
+size_t ri_arena_used(const ri_arena_t *arena)
+{
+  return arena->offset;
+}
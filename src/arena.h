@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Reference counted memory block holding the local handles of all channels
+ * of a vector. All allocations are cacheline aligned and contiguous, so the
+ * handles don't share cachelines with unrelated heap objects.
+ * The arena is released when the last reference is dropped.
+ */
+typedef struct ri_arena ri_arena_t;
+
+/* storage needed for an arena with size bytes usable space */
+size_t ri_arena_storage_size(size_t size);
+
+ri_arena_t* ri_arena_new(size_t size);
+
+/* places the arena in caller-provided storage, which is not freed on release */
+ri_arena_t* ri_arena_init(void *storage, size_t storage_size);
+
+void ri_arena_ref(ri_arena_t *arena);
+
+void ri_arena_unref(ri_arena_t *arena);
+
+void* ri_arena_alloc(ri_arena_t *arena, size_t size);
+
+/* bytes handed out so far */
+size_t ri_arena_used(const ri_arena_t *arena);
@@ -0,0 +1,276 @@
+#define _GNU_SOURCE
+
+#include "barrier.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "rtipc/log.h"
+#include "clock.h"
+#include "mem_utils.h"
+
+/* polls of the release word before a waiter sleeps on the futex */
+#define RI_BARRIER_SPINS 4096
+
+/*
+ * Shared memory layout, each part on its own cacheline:
+ *   arrivals   total number of arrivals, step s is complete at s * n_participants
+ *   released   low 32 bits of the last completed step (futex word), waiters
+ *   steps      last step each participant arrived at
+ */
+struct ri_barrier {
+  /* handles live in the vector arena, one per participant */
+  atomic_bool mapped;
+  _Atomic uint64_t *arrivals;
+  _Atomic uint32_t *released;
+  _Atomic uint32_t *waiters;
+  _Atomic uint64_t *steps;
+  size_t stride;
+  unsigned n_participants;
+  unsigned participant;
+  /* last step this participant arrived at */
+  uint64_t step;
+  ri_shm_t *shm;
+  ri_arena_t *arena;
+};
+
+
+static inline void spin_pause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
+}
+
+
+/* process shared, so without FUTEX_PRIVATE_FLAG */
+static int futex_wait(_Atomic uint32_t *word, uint32_t value, const struct timespec *timeout)
+{
+  return syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+
+static void futex_wake(_Atomic uint32_t *word)
+{
+  syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+size_t ri_barrier_shm_size(unsigned n_participants)
+{
+  if (n_participants == 0)
+    return 0;
+
+  return (2 + n_participants) * cacheline_size();
+}
+
+
+size_t ri_barrier_layout_calc(size_t offset, unsigned n_participants, size_t *barrier_offset)
+{
+  *barrier_offset = cacheline_aligned(offset);
+
+  return *barrier_offset + ri_barrier_shm_size(n_participants);
+}
+
+
+/* handles of different participants don't share cachelines */
+static size_t handle_stride(void)
+{
+  return cacheline_aligned(sizeof(ri_barrier_t));
+}
+
+
+static ri_barrier_t* handle_at(ri_barrier_t *handles, unsigned participant)
+{
+  return (ri_barrier_t*)((uint8_t*)handles + participant * handle_stride());
+}
+
+
+size_t ri_barrier_alloc_size(unsigned n_participants)
+{
+  return n_participants * handle_stride();
+}
+
+
+ri_barrier_t* ri_barrier_alloc(ri_arena_t *arena, unsigned n_participants)
+{
+  if (n_participants == 0)
+    return NULL;
+
+  ri_barrier_t *handles = ri_arena_alloc(arena, ri_barrier_alloc_size(n_participants));
+  if (!handles)
+    return NULL;
+
+  for (unsigned i = 0; i < n_participants; i++)
+    atomic_init(&handle_at(handles, i)->mapped, false);
+
+  return handles;
+}
+
+
+ri_barrier_t* ri_barrier_map(ri_barrier_t *handles, unsigned participant, ri_shm_t *shm, size_t offset,
+                             unsigned n_participants, ri_arena_t *arena)
+{
+  if ((n_participants == 0) || (participant >= n_participants)) {
+    LOG_ERR("invalid barrier participant=%u n_participants=%u", participant, n_participants);
+    goto fail_args;
+  }
+
+  if (offset + ri_barrier_shm_size(n_participants) > ri_shm_size(shm)) {
+    LOG_ERR("barrier at offset=%zu exceeds shared memory", offset);
+    goto fail_args;
+  }
+
+  ri_barrier_t *barrier = handle_at(handles, participant);
+
+  if (atomic_exchange_explicit(&barrier->mapped, true, memory_order_acquire)) {
+    LOG_ERR("barrier participant=%u is mapped already", participant);
+    goto fail_args;
+  }
+
+  size_t line = cacheline_size();
+
+  barrier->arrivals = ri_shm_ptr(shm, offset);
+  barrier->released = ri_shm_ptr(shm, offset + line);
+  barrier->waiters = ri_shm_ptr(shm, offset + line + sizeof(uint32_t));
+  barrier->steps = ri_shm_ptr(shm, offset + 2 * line);
+  barrier->stride = line / sizeof(uint64_t);
+  barrier->n_participants = n_participants;
+  barrier->participant = participant;
+  barrier->shm = shm;
+  barrier->arena = arena;
+
+  /* continues where a previous handle of the participant left off */
+  barrier->step = atomic_load_explicit(&barrier->steps[participant * barrier->stride], memory_order_relaxed);
+
+  ri_shm_ref(shm);
+  ri_arena_ref(arena);
+
+  return barrier;
+
+fail_args:
+  return NULL;
+}
+
+
+void ri_barrier_delete(ri_barrier_t *barrier)
+{
+  ri_shm_t *shm = barrier->shm;
+  ri_arena_t *arena = barrier->arena;
+
+  /* the handle may be mapped again right away, or freed with the arena */
+  atomic_store_explicit(&barrier->mapped, false, memory_order_release);
+
+  ri_shm_unref(shm);
+  ri_arena_unref(arena);
+}
+
+
+unsigned ri_barrier_num_participants(const ri_barrier_t *barrier)
+{
+  return barrier->n_participants;
+}
+
+
+uint64_t ri_barrier_step(const ri_barrier_t *barrier, unsigned participant)
+{
+  if (participant >= barrier->n_participants)
+    return 0;
+
+  return atomic_load_explicit(&barrier->steps[participant * barrier->stride], memory_order_relaxed);
+}
+
+
+int ri_barrier_arrive(ri_barrier_t *barrier)
+{
+  uint32_t released = atomic_load_explicit(barrier->released, memory_order_acquire);
+
+  /* the others can't complete a step without us, so released is our step or the one before */
+  if (released != (uint32_t)barrier->step)
+    return -EBUSY;
+
+  uint64_t step = ++barrier->step;
+
+  atomic_store_explicit(&barrier->steps[barrier->participant * barrier->stride], step, memory_order_relaxed);
+
+  uint64_t arrivals = atomic_fetch_add_explicit(barrier->arrivals, 1, memory_order_acq_rel) + 1;
+
+  if (arrivals != step * barrier->n_participants)
+    return 0;
+
+  /* last arrival, pairs with the waiters' increment and check in ri_barrier_wait */
+  atomic_store(barrier->released, (uint32_t)step);
+
+  if (atomic_load(barrier->waiters) > 0)
+    futex_wake(barrier->released);
+
+  return 0;
+}
+
+
+static struct timespec to_timespec(uint64_t ns)
+{
+  return (struct timespec) {
+    .tv_sec = ns / 1000000000u,
+    .tv_nsec = ns % 1000000000u,
+  };
+}
+
+
+int ri_barrier_wait(ri_barrier_t *barrier, int64_t timeout_ns)
+{
+  uint32_t target = (uint32_t)barrier->step;
+
+  for (unsigned i = 0; i < RI_BARRIER_SPINS; i++) {
+    if (atomic_load_explicit(barrier->released, memory_order_acquire) == target)
+      return 0;
+
+    spin_pause();
+  }
+
+  if (timeout_ns == 0)
+    return -ETIMEDOUT;
+
+  uint64_t deadline = timeout_ns > 0 ? ri_clock_ns() + timeout_ns : 0;
+  int r = 0;
+
+  atomic_fetch_add(barrier->waiters, 1);
+
+  for (;;) {
+    uint32_t released = atomic_load(barrier->released);
+
+    if (released == target)
+      break;
+
+    struct timespec timeout;
+    const struct timespec *ptimeout = NULL;
+
+    if (timeout_ns > 0) {
+      uint64_t now = ri_clock_ns();
+
+      if (now >= deadline) {
+        r = -ETIMEDOUT;
+        break;
+      }
+
+      timeout = to_timespec(deadline - now);
+      ptimeout = &timeout;
+    }
+
+    /* returns immediately if the step was released meanwhile */
+    futex_wait(barrier->released, released, ptimeout);
+  }
+
+  atomic_fetch_sub(barrier->waiters, 1);
+
+  return r;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "rtipc/rtipc.h"
+#include "arena.h"
+#include "shm.h"
+
+
+/* bytes of shared memory used by a barrier, 0 without participants */
+size_t ri_barrier_shm_size(unsigned n_participants);
+
+/* places the barrier behind offset, returns the new end of the layout */
+size_t ri_barrier_layout_calc(size_t offset, unsigned n_participants, size_t *barrier_offset);
+
+/* arena bytes for the handles of all participants */
+size_t ri_barrier_alloc_size(unsigned n_participants);
+
+/* reserves the handles of all participants in the arena, all unmapped */
+ri_barrier_t* ri_barrier_alloc(ri_arena_t *arena, unsigned n_participants);
+
+/* maps the handle of participant, NULL if it is mapped already */
+ri_barrier_t* ri_barrier_map(ri_barrier_t *handles, unsigned participant, ri_shm_t *shm, size_t offset,
+                             unsigned n_participants, ri_arena_t *arena);
@@ -0,0 +1,110 @@
+#include "blob.h"
+
+#include <errno.h>
+
+#include "rtipc/log.h"
+#include "channel.h"
+#include "mem_utils.h"
+
+
+int ri_blob_attr_validate(const ri_attr_t *attr)
+{
+  /* handles store 32 bit offsets */
+  if (attr->blob_size > UINT32_MAX) {
+    LOG_ERR("blob_size=%zu exceeds 4 GiB", attr->blob_size);
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+
+size_t ri_blob_shm_size(const ri_attr_t *attr)
+{
+  return cacheline_aligned(attr->blob_size);
+}
+
+
+size_t ri_blob_local_size(const ri_attr_t *attr)
+{
+  return attr->blob_size ? ri_channel_queue_len(attr) * sizeof(ri_blob_range_t) : 0;
+}
+
+
+void ri_blob_heap_init(ri_blob_heap_t *heap, const ri_attr_t *attr, void *mem, void *local)
+{
+  *heap = (ri_blob_heap_t) {
+    .mem = mem,
+    .size = ri_blob_shm_size(attr),
+    .ranges = local,
+    .n_msgs = ri_channel_queue_len(attr),
+  };
+
+  for (unsigned i = 0; i < heap->n_msgs; i++)
+    ri_blob_recycle(heap, i);
+}
+
+
+static void reclaim(ri_blob_heap_t *heap)
+{
+  uint64_t tail = heap->head;
+
+  for (unsigned i = 0; i < heap->n_msgs; i++) {
+    const ri_blob_range_t *range = &heap->ranges[i];
+
+    if ((range->start != range->end) && (range->start < tail))
+      tail = range->start;
+  }
+
+  heap->tail = tail;
+}
+
+
+void* ri_blob_alloc(ri_blob_heap_t *heap, ri_index_t slot, size_t size, ri_blob_t *blob)
+{
+  size_t aligned = cacheline_aligned(size);
+
+  if ((size == 0) || (aligned > heap->size))
+    return NULL;
+
+  for (unsigned attempt = 0; attempt < 2; attempt++) {
+    uint64_t pos = heap->head;
+    size_t offset = pos % heap->size;
+
+    /* blobs are contiguous, skip the rest of the ring if it is too short */
+    if (offset + aligned > heap->size) {
+      pos += heap->size - offset;
+      offset = 0;
+    }
+
+    if (pos + aligned - heap->tail <= heap->size) {
+      ri_blob_range_t *range = &heap->ranges[slot];
+
+      if (range->start == range->end)
+        range->start = pos;
+
+      range->end = pos + aligned;
+      heap->head = pos + aligned;
+
+      *blob = (ri_blob_t) {
+        .offset = offset,
+        .size = size,
+      };
+
+      return &heap->mem[offset];
+    }
+
+    reclaim(heap);
+  }
+
+  return NULL;
+}
+
+
+const void* ri_blob_get(const void *mem, size_t size, ri_blob_t blob)
+{
+  if (!mem || ((uint64_t)blob.offset + blob.size > size))
+    return NULL;
+
+  return cmem_offset(mem, blob.offset);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtipc/rtipc.h"
+#include "index.h"
+
+/**
+ * Blob heap of a channel with ri_attr_t.blob_size set.
+ *
+ * The heap is a ring in shared memory, only the producer allocates from it.
+ * All blobs allocated while a slot is the producer's current slot belong
+ * to the message pushed from that slot and are contiguous in the ring
+ * (apart from the wrap-around). They are freed when the producer picks
+ * the slot again, at that point the consumer doesn't hold the old message
+ * anymore. Positions grow monotonically; the oldest position still
+ * referenced by a slot bounds the next allocation.
+ */
+
+typedef struct ri_blob_range {
+  uint64_t start;
+  uint64_t end;
+} ri_blob_range_t;
+
+
+typedef struct ri_blob_heap {
+  uint8_t *mem;
+  size_t size;
+  /* position of the next allocation */
+  uint64_t head;
+  /* oldest position still in use, recomputed when the heap runs full */
+  uint64_t tail;
+  /* blobs of every slot, empty if start == end */
+  ri_blob_range_t *ranges;
+  unsigned n_msgs;
+} ri_blob_heap_t;
+
+
+int ri_blob_attr_validate(const ri_attr_t *attr);
+
+/* size of the heap in shared memory, 0 without blobs */
+size_t ri_blob_shm_size(const ri_attr_t *attr);
+
+/* local memory needed by the producer */
+size_t ri_blob_local_size(const ri_attr_t *attr);
+
+void ri_blob_heap_init(ri_blob_heap_t *heap, const ri_attr_t *attr, void *mem, void *local);
+
+/* allocates size bytes for the message in slot */
+void* ri_blob_alloc(ri_blob_heap_t *heap, ri_index_t slot, size_t size, ri_blob_t *blob);
+
+/* frees the blobs of slot, the producer is about to reuse it */
+static inline void ri_blob_recycle(ri_blob_heap_t *heap, ri_index_t slot)
+{
+  heap->ranges[slot] = (ri_blob_range_t) { 0 };
+}
+
+/* validates a handle received from the producer */
+const void* ri_blob_get(const void *mem, size_t size, ri_blob_t blob);
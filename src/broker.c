@@ -0,0 +1,457 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/connect.h"
+#include "rtipc/log.h"
+#include "alloc.h"
+#include "channel.h"
+#include "request.h"
+#include "stream.h"
+#include "table.h"
+#include "unix.h"
+
+typedef enum {
+  BROKER_OP_PUBLISH = 1,
+  BROKER_OP_SUBSCRIBE = 2,
+} broker_op_t;
+
+/* prefix of every request and response, keeps the serialized vector 8-byte aligned */
+typedef struct {
+  uint32_t op;
+  int32_t result;
+  char topic[RI_BROKER_TOPIC_MAX];
+} broker_header_t;
+
+typedef struct ri_topic ri_topic_t;
+
+/* a registration, the publish request is kept as received and forwarded to the subscriber */
+struct ri_topic {
+  ri_topic_t *next;
+  ri_uxmsg_t *msg;
+  /* only a barrier, which any number of subscribers can map */
+  bool shared;
+};
+
+struct ri_broker {
+  ri_server_t *server;
+  ri_topic_t *topics;
+};
+
+
+static broker_header_t* topic_header(const ri_topic_t *topic)
+{
+  return ri_uxmsg_data(topic->msg, NULL);
+}
+
+
+static void topic_delete(ri_topic_t *topic)
+{
+  ri_uxmsg_delete(topic->msg);
+  ri_free(topic);
+}
+
+
+ri_broker_t* ri_broker_new(const char *path, int backlog)
+{
+  ri_broker_t *broker = ri_alloc(sizeof(ri_broker_t));
+  if (!broker)
+    goto fail_alloc;
+
+  broker->server = ri_server_new(path, backlog);
+  if (!broker->server)
+    goto fail_server;
+
+  broker->topics = NULL;
+
+  return broker;
+
+fail_server:
+  ri_free(broker);
+fail_alloc:
+  return NULL;
+}
+
+
+void ri_broker_delete(ri_broker_t *broker)
+{
+  while (broker->topics) {
+    ri_topic_t *topic = broker->topics;
+    broker->topics = topic->next;
+    topic_delete(topic);
+  }
+
+  ri_server_delete(broker->server);
+  ri_free(broker);
+}
+
+
+int ri_broker_socket(const ri_broker_t *broker)
+{
+  return ri_server_socket(broker->server);
+}
+
+
+static int broker_respond(int socket, const broker_header_t *header, int32_t result)
+{
+  broker_header_t response = *header;
+
+  response.result = result;
+
+  return ri_uxsocket_send(socket, &response, sizeof(response));
+}
+
+
+static unsigned count_eventfds(const ri_attr_t *attrs)
+{
+  unsigned n = 0;
+
+  if (!attrs)
+    return 0;
+
+  for (const ri_attr_t *attr = attrs; attr->msg_size != 0; attr++) {
+    if (attr->eventfd)
+      n++;
+  }
+
+  return n;
+}
+
+
+/* checks the layout and descriptors without mapping anything */
+static int publish_validate(ri_uxmsg_t *msg, bool *shared)
+{
+  size_t size;
+  unsigned n_fds;
+  const uint8_t *data = ri_uxmsg_data(msg, &size);
+  int *fds = ri_uxmsg_fds(msg, &n_fds);
+
+  if ((n_fds < 1) || (ri_memfd_verify(fds[0]) < 0))
+    return -EBADF;
+
+  ri_attr_t *attrs = NULL;
+  ri_config_t config = ri_request_parse(data + sizeof(broker_header_t),
+                                        size - sizeof(broker_header_t), &attrs);
+  if (!attrs)
+    return -EPROTO;
+
+  unsigned n_eventfds = count_eventfds(config.consumers) + count_eventfds(config.producers);
+
+  *shared = (config.barrier_participants > 0)
+         && (ri_count_channels(config.consumers) + ri_count_channels(config.producers) == 0)
+         && (ri_count_streams(config.stream_readers) + ri_count_streams(config.stream_writers) == 0)
+         && (ri_count_tables(config.table_readers) + ri_count_tables(config.table_writers) == 0);
+
+  ri_free(attrs);
+
+  if (n_fds != n_eventfds + 1)
+    return -EBADF;
+
+  for (unsigned i = 1; i < n_fds; i++) {
+    if (ri_eventfd_verify(fds[i]) < 0)
+      return -EBADF;
+  }
+
+  return 0;
+}
+
+
+static int broker_publish(ri_broker_t *broker, int socket, ri_uxmsg_t *msg)
+{
+  const broker_header_t *header = ri_uxmsg_data(msg, NULL);
+
+  bool shared = false;
+
+  int r = publish_validate(msg, &shared);
+  if (r < 0) {
+    LOG_ERR("invalid registration of topic %s", header->topic);
+    goto fail_validate;
+  }
+
+  ri_topic_t *topic = ri_alloc(sizeof(ri_topic_t));
+  if (!topic) {
+    r = -ENOMEM;
+    goto fail_validate;
+  }
+
+  *topic = (ri_topic_t) {
+    .next = NULL,
+    .msg = msg,
+    .shared = shared,
+  };
+
+  /* appended, subscribers claim registrations in order */
+  ri_topic_t **tail = &broker->topics;
+  while (*tail)
+    tail = &(*tail)->next;
+
+  *tail = topic;
+
+  LOG_INF("topic %s registered", header->topic);
+
+  broker_respond(socket, header, 0);
+
+  return 0;
+
+fail_validate:
+  broker_respond(socket, header, r);
+  ri_uxmsg_delete(msg);
+  return 0;
+}
+
+
+static int broker_subscribe(ri_broker_t *broker, int socket, ri_uxmsg_t *msg)
+{
+  const broker_header_t *header = ri_uxmsg_data(msg, NULL);
+
+  ri_topic_t **link = &broker->topics;
+
+  while (*link) {
+    if (strcmp(topic_header(*link)->topic, header->topic) == 0)
+      break;
+    link = &(*link)->next;
+  }
+
+  ri_topic_t *topic = *link;
+
+  if (!topic) {
+    LOG_INF("topic %s not found", header->topic);
+    broker_respond(socket, header, -ENOENT);
+    goto out;
+  }
+
+  broker_header_t *response = topic_header(topic);
+
+  response->op = BROKER_OP_SUBSCRIBE;
+  response->result = 0;
+
+  /* the descriptors are duplicated into the subscriber */
+  if (ri_uxmsg_send(topic->msg, socket) < 0) {
+    LOG_ERR("forwarding topic %s failed errno=%d", header->topic, errno);
+    goto out;
+  }
+
+  if (topic->shared) {
+    LOG_INF("topic %s mapped", header->topic);
+    goto out;
+  }
+
+  LOG_INF("topic %s claimed", header->topic);
+
+  *link = topic->next;
+  topic_delete(topic);
+
+out:
+  ri_uxmsg_delete(msg);
+  return 0;
+}
+
+
+static int broker_handle(ri_broker_t *broker, int socket)
+{
+  ri_uxmsg_t *msg = ri_uxmsg_receive(socket);
+  if (!msg) {
+    LOG_ERR("ri_uxmsg_receive failed");
+    return -EIO;
+  }
+
+  size_t size;
+  broker_header_t *header = ri_uxmsg_data(msg, &size);
+
+  if ((size < sizeof(broker_header_t))
+   || (header->topic[0] == '\0')
+   || (memchr(header->topic, '\0', sizeof(header->topic)) == NULL)) {
+    LOG_ERR("invalid broker request");
+    ri_uxmsg_delete(msg);
+    return -EPROTO;
+  }
+
+  switch (header->op) {
+    case BROKER_OP_PUBLISH:
+      return broker_publish(broker, socket, msg);
+    case BROKER_OP_SUBSCRIBE:
+      return broker_subscribe(broker, socket, msg);
+    default:
+      broker_respond(socket, header, -EINVAL);
+      ri_uxmsg_delete(msg);
+      return 0;
+  }
+}
+
+
+int ri_broker_process(ri_broker_t *broker)
+{
+  int socket = accept(ri_server_socket(broker->server), NULL, NULL);
+  if (socket < 0) {
+    int r = -errno;
+    LOG_ERR("accept failed errno=%d", -r);
+    return r;
+  }
+
+  int r = broker_handle(broker, socket);
+
+  close(socket);
+
+  return r;
+}
+
+
+static int set_topic(broker_header_t *header, const char *topic)
+{
+  size_t len = topic ? strlen(topic) : 0;
+
+  if ((len == 0) || (len >= sizeof(header->topic)))
+    return -EINVAL;
+
+  memcpy(header->topic, topic, len + 1);
+
+  return 0;
+}
+
+
+/* sends the request and receives the response, which has to start with a header */
+static ri_uxmsg_t* broker_exchange(const char *path, const ri_uxmsg_t *req)
+{
+  int socket = ri_uxsocket_connect(path);
+  if (socket < 0)
+    goto fail_connect;
+
+  if (ri_uxmsg_send(req, socket) < 0) {
+    LOG_ERR("ri_uxmsg_send failed errno=%d", errno);
+    goto fail_send;
+  }
+
+  ri_uxmsg_t *rsp = ri_uxmsg_receive(socket);
+  if (!rsp) {
+    LOG_ERR("ri_uxmsg_receive failed");
+    goto fail_send;
+  }
+
+  close(socket);
+
+  size_t size;
+  const broker_header_t *header = ri_uxmsg_data(rsp, &size);
+
+  if (size < sizeof(broker_header_t)) {
+    LOG_ERR("invalid broker response");
+    goto fail_response;
+  }
+
+  if (header->result < 0) {
+    LOG_ERR("broker rejected request for topic %s result=%d", header->topic, header->result);
+    goto fail_response;
+  }
+
+  return rsp;
+
+fail_response:
+  ri_uxmsg_delete(rsp);
+  return NULL;
+fail_send:
+  close(socket);
+fail_connect:
+  return NULL;
+}
+
+
+ri_vector_t* ri_broker_publish(const char *path, const char *topic, const ri_config_t *config)
+{
+  ri_vector_t *vec = ri_vector_new(config);
+  if (!vec) {
+    LOG_ERR("ri_vector_new failed");
+    goto fail_vec;
+  }
+
+  size_t vec_size = ri_vector_serialize_size(vec);
+
+  ri_uxmsg_t *req = ri_uxmsg_new(sizeof(broker_header_t) + vec_size);
+  if (!req)
+    goto fail_req;
+
+  uint8_t *data = ri_uxmsg_data(req, NULL);
+  broker_header_t *header = (broker_header_t*)data;
+
+  *header = (broker_header_t) {
+    .op = BROKER_OP_PUBLISH,
+  };
+
+  if (set_topic(header, topic) < 0) {
+    LOG_ERR("invalid topic name");
+    goto fail_construct;
+  }
+
+  unsigned n_fds;
+  int *fds = ri_uxmsg_fds(req, &n_fds);
+
+  int r = ri_vector_serialize(vec, data + sizeof(broker_header_t), vec_size, fds, &n_fds);
+  if (r < 0)
+    goto fail_construct;
+
+  r = ri_uxmsg_set_num_fds(req, n_fds);
+  if (r < 0)
+    goto fail_construct;
+
+  ri_uxmsg_t *rsp = broker_exchange(path, req);
+  if (!rsp)
+    goto fail_construct;
+
+  ri_uxmsg_delete(rsp);
+  ri_uxmsg_delete(req);
+
+  return vec;
+
+fail_construct:
+  ri_uxmsg_delete(req);
+fail_req:
+  ri_vector_delete(vec);
+fail_vec:
+  return NULL;
+}
+
+
+ri_vector_t* ri_broker_subscribe(const char *path, const char *topic)
+{
+  ri_uxmsg_t *req = ri_uxmsg_new(sizeof(broker_header_t));
+  if (!req)
+    goto fail_req;
+
+  broker_header_t *header = ri_uxmsg_data(req, NULL);
+
+  *header = (broker_header_t) {
+    .op = BROKER_OP_SUBSCRIBE,
+  };
+
+  if (set_topic(header, topic) < 0) {
+    LOG_ERR("invalid topic name");
+    goto fail_exchange;
+  }
+
+  ri_uxmsg_t *rsp = broker_exchange(path, req);
+  if (!rsp)
+    goto fail_exchange;
+
+  size_t size;
+  unsigned n_fds;
+  const uint8_t *data = ri_uxmsg_data(rsp, &size);
+  int *fds = ri_uxmsg_fds(rsp, &n_fds);
+
+  ri_vector_t *vec = ri_vector_deserialize(data + sizeof(broker_header_t),
+                                           size - sizeof(broker_header_t), fds, &n_fds);
+  if (!vec)
+    LOG_ERR("ri_vector_deserialize failed");
+
+  ri_uxmsg_delete(rsp);
+  ri_uxmsg_delete(req);
+
+  return vec;
+
+fail_exchange:
+  ri_uxmsg_delete(req);
+fail_req:
+  return NULL;
+}
@@ -7,111 +7,412 @@
 #include <errno.h>
 
 #include "rtipc/log.h"
+#include "arena.h"
+#include "blob.h"
+#include "copy.h"
+#include "dirty.h"
+#include "interest.h"
+#include "lane.h"
+#include "lease.h"
+#include "prefetch.h"
 #include "mem_utils.h"
 #include "producer.h"
 #include "consumer.h"
 #include "unix.h"
+#include "watermark.h"
 
 
+/* Channel handles are allocated from the vector's arena.
+ * The fields used by push and pop come first and the queue state
+ * is embedded, so the hot path touches as few cachelines as possible. */
 struct ri_consumer {
-  ri_consumer_queue_t *queue;
-  size_t shm_offset;
+  ri_consumer_queue_t queue;
+  /* lane of the current message, &queue without lanes */
+  ri_consumer_queue_t *lane;
+  ri_copy_fn copy_out;
+  size_t prefetch;
   int eventfd;
-  struct {
-    size_t size;
-    void *data;
-  } info;
+  ri_dirty_consumer_t dirty;
+  ri_lease_consumer_t leases;
+  ri_watermark_consumer_t watermark;
+  const void *blobs;
+  size_t blob_size;
+  /* cold */
+  ri_interest_t *interest;
+  unsigned msg_align;
+  /* only reported back, the producer holds the cache buffer */
+  bool cache;
+  unsigned n_lanes;
+  ri_consumer_queue_t *lanes[RI_MAX_LANES];
+  ri_channel_layout_t layout;
+  ri_arena_t *arena;
+  ri_info_t info;
 };
 
 struct ri_producer {
-  ri_producer_queue_t *queue;
-  size_t shm_offset;
-  int eventfd;
-  struct {
-    size_t size;
-    void *data;
-  } info;
+  ri_producer_queue_t queue;
+  /* selected lane, &queue without lanes */
+  ri_producer_queue_t *lane;
   void *cache;
+  ri_copy_fn cache_copy;
+  size_t prefetch;
+  int eventfd;
+  ri_dirty_producer_t dirty;
+  ri_blob_heap_t blobs;
+  ri_interest_producer_t interest;
+  ri_watermark_producer_t watermark;
+  /* cold */
+  unsigned msg_align;
+  unsigned n_lanes;
+  ri_producer_queue_t *lanes[RI_MAX_LANES];
+  ri_channel_layout_t layout;
+  ri_arena_t *arena;
+  void *cache_buf;
+  ri_info_t info;
+  /* local copy of the chain, ri_producer_queue_t.chain points here */
+  ri_index_t chain[];
 };
 
-static size_t ri_calc_data_size(unsigned n_msgs, size_t msg_size)
+size_t ri_calc_msg_stride(size_t msg_size, unsigned msg_align)
 {
-  return n_msgs * cacheline_aligned(msg_size);
+  if (msg_align == 0)
+    return cacheline_aligned(msg_size);
+
+  return mem_align(msg_size, msg_align);
 }
 
 
-size_t ri_calc_channel_shm_size(unsigned n_msgs, size_t msg_size)
+size_t ri_calc_data_size(unsigned n_msgs, size_t msg_stride)
+{
+  /* packed messages must not share a cacheline with the next channel */
+  return cacheline_aligned(n_msgs * msg_stride);
+}
+
+
+size_t ri_calc_channel_shm_size(unsigned n_msgs, size_t msg_stride)
 {
   /* tail + head + queue*/
-  return ri_calc_queue_size(n_msgs) + ri_calc_data_size(n_msgs, msg_size);
+  return ri_calc_queue_size(n_msgs) + ri_calc_data_size(n_msgs, msg_stride);
+}
+
+
+int ri_channel_attr_validate(const ri_attr_t *attr)
+{
+  if (attr->msg_size == 0)
+    return -EINVAL;
+
+  if (ri_dirty_attr_validate(attr) < 0)
+    return -EINVAL;
+
+  if (ri_blob_attr_validate(attr) < 0)
+    return -EINVAL;
+
+  if (ri_lane_attr_validate(attr) < 0)
+    return -EINVAL;
+
+  /* the producer's dirty state refers to the slot buffers, which a relay exchanges */
+  if (attr->relay && attr->dirty_block) {
+    LOG_ERR("relay channels don't support dirty tracking");
+    return -EINVAL;
+  }
+
+  /* blobs are freed when the slot of the referencing message is reused,
+   * a relayed message would refer to the heap of another channel */
+  if (attr->relay && attr->blob_size) {
+    LOG_ERR("relay channels don't support blobs");
+    return -EINVAL;
+  }
+
+  unsigned align = attr->msg_align;
+
+  if (align != 0) {
+    if ((align & (align - 1)) != 0) {
+      LOG_ERR("msg_align=%u is not a power of two", align);
+      return -EINVAL;
+    }
+
+    if (align > cacheline_size()) {
+      LOG_ERR("msg_align=%u exceeds cacheline size %zu", align, cacheline_size());
+      return -EINVAL;
+    }
+  }
+
+  return 0;
+}
+
+
+static void producer_cache_write(ri_producer_t *producer) {
+  size_t msg_size = ri_producer_queue_msg_size(&producer->queue);
+  void *msg = ri_producer_queue_msg(&producer->queue);
+
+  if (ri_dirty_enabled(&producer->dirty))
+    ri_dirty_write_back(&producer->dirty, producer->queue.current, msg, producer->cache, msg_size, producer->cache_copy);
+  else
+    producer->cache_copy(msg, producer->cache, msg_size);
+}
+
+
+/* called right before the current message is pushed */
+static void producer_write_back(ri_producer_t *producer) {
+  if (producer->cache)
+    producer_cache_write(producer);
+  else if (ri_dirty_enabled(&producer->dirty))
+    ri_dirty_write_all(&producer->dirty, producer->queue.current);
+}
+
+
+static size_t info_alloc_size(const ri_attr_t *attr)
+{
+  return attr->info.data ? cacheline_aligned(attr->info.size) : 0;
+}
+
+
+static int info_copy(ri_info_t *info, const ri_attr_t *attr, ri_arena_t *arena)
+{
+  *info = (ri_info_t) {
+    .size = attr->info.size,
+  };
+
+  if ((attr->info.size == 0) || !attr->info.data)
+    return 0;
+
+  void *data = ri_arena_alloc(arena, attr->info.size);
+  if (!data)
+    return -ENOMEM;
+
+  memcpy(data, attr->info.data, attr->info.size);
+  info->data = data;
+
+  return 0;
+}
+
+
+static int consumer_dirty_init(ri_dirty_consumer_t *dirty, const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
+{
+  void *records = NULL;
+  void *local = NULL;
+
+  if (attr->dirty_block) {
+    records = ri_shm_ptr(shm, layout->dirty);
+    local = ri_arena_alloc(arena, ri_dirty_consumer_size(attr));
+    if (!records || !local)
+      return -ENOMEM;
+  }
+
+  ri_dirty_consumer_init(dirty, attr, records, local);
+
+  return 0;
+}
+
+
+static int producer_dirty_init(ri_dirty_producer_t *dirty, const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
+{
+  void *records = NULL;
+  void *local = NULL;
+
+  if (attr->dirty_block) {
+    records = ri_shm_ptr(shm, layout->dirty);
+    local = ri_arena_alloc(arena, ri_dirty_producer_size(attr));
+    if (!records || !local)
+      return -ENOMEM;
+  }
+
+  ri_dirty_producer_init(dirty, attr, records, local);
+
+  return 0;
+}
+
+
+static int producer_blobs_init(ri_blob_heap_t *heap, const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
+{
+  if (attr->blob_size == 0) {
+    *heap = (ri_blob_heap_t) { 0 };
+    return 0;
+  }
+
+  void *mem = ri_shm_ptr(shm, layout->blobs);
+  void *local = ri_arena_alloc(arena, ri_blob_local_size(attr));
+  if (!mem || !local)
+    return -ENOMEM;
+
+  ri_blob_heap_init(heap, attr, mem, local);
+
+  return 0;
+}
+
+
+/* lane 0 is the embedded queue, the others are allocated behind the handle */
+static int consumer_lanes_init(ri_consumer_t *consumer, const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
+{
+  consumer->n_lanes = ri_lane_count(attr);
+  consumer->lanes[0] = &consumer->queue;
+  consumer->lane = &consumer->queue;
+
+  for (unsigned i = 1; i < consumer->n_lanes; i++) {
+    ri_channel_layout_t lane_layout;
+    ri_consumer_queue_t *lane = ri_arena_alloc(arena, sizeof(ri_consumer_queue_t));
+    if (!lane)
+      return -ENOMEM;
+
+    ri_lane_layout(attr, layout, i, &lane_layout);
+
+    int r = ri_consumer_queue_init(lane, attr, shm, &lane_layout);
+    if (r < 0)
+      return r;
+
+    consumer->lanes[i] = lane;
+  }
+
+  return 0;
 }
 
 
-size_t ri_calc_shm_size(const ri_attr_t consumers[], const ri_attr_t producers[])
+static int producer_lanes_init(ri_producer_t *producer, const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
 {
-  unsigned n_consumers = ri_count_channels(consumers);
-  unsigned n_producers = ri_count_channels(producers);
+  producer->n_lanes = ri_lane_count(attr);
+  producer->lanes[0] = &producer->queue;
+  producer->lane = &producer->queue;
 
-  size_t size = 0;
+  for (unsigned i = 1; i < producer->n_lanes; i++) {
+    ri_channel_layout_t lane_layout;
+    ri_producer_queue_t *lane = ri_arena_alloc(arena, sizeof(ri_producer_queue_t));
+    ri_index_t *chain = ri_arena_alloc(arena, ri_producer_queue_chain_size(attr));
+    if (!lane || !chain)
+      return -ENOMEM;
 
-  for (unsigned i = 0; i < n_consumers; i++)
-    size +=  ri_channel_shm_size(&consumers[i]);
+    ri_lane_layout(attr, layout, i, &lane_layout);
 
-  for (unsigned i = 0; i < n_producers; i++)
-    size += ri_channel_shm_size(&producers[i]);
+    int r = ri_producer_queue_init(lane, attr, shm, &lane_layout, chain);
+    if (r < 0)
+      return r;
 
-  return size;
+    producer->lanes[i] = lane;
+  }
+
+  return 0;
 }
 
 
-static void producer_cache_write(const ri_producer_t *producer) {
-  size_t msg_size = ri_producer_queue_msg_size(producer->queue);
-  void *msg = ri_producer_queue_msg(producer->queue);
-  memcpy(msg, producer->cache, msg_size);
+static size_t lanes_alloc_size(const ri_attr_t *attr, size_t queue_size, size_t chain_size)
+{
+  return (ri_lane_count(attr) - 1) * (cacheline_aligned(queue_size) + cacheline_aligned(chain_size));
 }
 
 
-ri_consumer_t* ri_consumer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm, size_t shm_offset)
+size_t ri_consumer_alloc_size(const ri_attr_t *attr)
 {
-  ri_consumer_t *consumer = malloc(sizeof(ri_consumer_t));
+  return cacheline_aligned(sizeof(ri_consumer_t))
+         + cacheline_aligned(ri_dirty_consumer_size(attr))
+         + cacheline_aligned(ri_lease_local_size(attr))
+         + lanes_alloc_size(attr, sizeof(ri_consumer_queue_t), 0)
+         + info_alloc_size(attr);
+}
+
+
+size_t ri_producer_alloc_size(const ri_attr_t *attr)
+{
+  return cacheline_aligned(sizeof(ri_producer_t) + ri_producer_queue_chain_size(attr))
+         + (attr->cache ? cacheline_aligned(attr->msg_size) : 0)
+         + cacheline_aligned(ri_dirty_producer_size(attr))
+         + cacheline_aligned(ri_blob_local_size(attr))
+         + lanes_alloc_size(attr, sizeof(ri_producer_queue_t), ri_producer_queue_chain_size(attr))
+         + info_alloc_size(attr);
+}
+
+
+ri_consumer_t* ri_consumer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
+{
+  if (ri_channel_attr_validate(attr) < 0)
+    goto fail_attr;
+
+  ri_consumer_t *consumer = ri_arena_alloc(arena, sizeof(ri_consumer_t));
   if (!consumer)
     goto fail_alloc;
 
   *consumer = (ri_consumer_t) {
-      .shm_offset = shm_offset,
+      .arena = arena,
+      .layout = *layout,
       .eventfd = attr->eventfd ? eventfd : -1,
-      .info.size = attr->info.size,
+      .msg_align = attr->msg_align,
+      .cache = attr->cache,
+      /* the copy is read right after, so keep it in the cache */
+      .copy_out = ri_copy_select(RI_COPY_TEMPORAL, attr->msg_size),
+      .blob_size = ri_blob_shm_size(attr),
   };
 
-  if ((attr->info.size > 0) && attr->info.data) {
-    consumer->info.data = malloc(attr->info.size);
+  if (attr->blob_size) {
+    consumer->blobs = ri_shm_ptr(shm, layout->blobs);
+    if (!consumer->blobs)
+      goto fail_blobs;
+  }
+
+  if (attr->interest) {
+    consumer->interest = ri_shm_ptr(shm, layout->interest);
+    if (!consumer->interest)
+      goto fail_interest;
+  }
 
-    if (!consumer->info.data)
-      goto fail_info;
+  if (attr->watermark) {
+    void *mem = ri_shm_ptr(shm, layout->watermark);
+    if (!mem)
+      goto fail_watermark;
 
-    memcpy(consumer->info.data, attr->info.data, attr->info.size);
+    ri_watermark_consumer_init(&consumer->watermark, mem);
   }
 
-  consumer->queue = ri_consumer_queue_new(attr, shm, shm_offset);
+  int r = info_copy(&consumer->info, attr, arena);
+  if (r < 0)
+    goto fail_info;
+
+  if (consumer_dirty_init(&consumer->dirty, attr, shm, layout, arena) < 0)
+    goto fail_dirty;
+
+  ri_index_t *lease_slots = ri_arena_alloc(arena, ri_lease_local_size(attr));
+  if (!lease_slots)
+    goto fail_leases;
 
-  if (!consumer->queue)
+  r = ri_consumer_queue_init(&consumer->queue, attr, shm, layout);
+
+  if (r < 0)
     goto fail_queue;
 
-  LOG_DBG("consumer created add_msg=%u msg_size=%zu, eventfd=%d shm_offset=%zu", attr->add_msgs, attr->msg_size, attr->eventfd, shm_offset);
+  ri_lease_consumer_init(&consumer->leases, consumer->queue.queue.leases,
+                         consumer->queue.queue.n_leases, lease_slots);
+
+  r = consumer_lanes_init(consumer, attr, shm, layout, arena);
+  if (r < 0)
+    goto fail_lanes;
+
+  ri_arena_ref(arena);
+
+  LOG_DBG("consumer created add_msg=%u msg_size=%zu, eventfd=%d tail_offset=%zu", attr->add_msgs, attr->msg_size, attr->eventfd, layout->tail);
 
   return consumer;
 
+fail_lanes:
+  for (unsigned i = 0; (i < consumer->n_lanes) && consumer->lanes[i]; i++)
+    ri_consumer_queue_deinit(consumer->lanes[i]);
 fail_queue:
-  if (consumer->info.data)
-    free(consumer->info.data);
+fail_leases:
+fail_dirty:
 fail_info:
-  free(consumer);
+fail_watermark:
+fail_interest:
+fail_blobs:
 fail_alloc:
+fail_attr:
   return NULL;
 }
 
 
-ri_consumer_t* ri_consumer_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset)
+ri_consumer_t* ri_consumer_new(const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
 {
   int eventfd = -1;
 
@@ -121,11 +422,18 @@ ri_consumer_t* ri_consumer_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_
       goto fail_eventfd;
   }
 
-  ri_consumer_t *consumer = ri_consumer_map(attr, eventfd, shm, shm_offset);
+  ri_consumer_t *consumer = ri_consumer_map(attr, eventfd, shm, layout, arena);
   if (!consumer)
     goto fail_consumer;
 
-  ri_consumer_queue_init_shm(consumer->queue);
+  for (unsigned i = 0; i < consumer->n_lanes; i++)
+    ri_consumer_queue_init_shm(consumer->lanes[i]);
+
+  if (consumer->interest)
+    ri_interest_init_shm(consumer->interest);
+
+  if (attr->watermark)
+    ri_watermark_init_shm(ri_shm_ptr(shm, layout->watermark), attr);
 
   return consumer;
 
@@ -137,47 +445,88 @@ fail_eventfd:
 }
 
 
-ri_producer_t* ri_producer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm, size_t shm_offset)
+ri_producer_t* ri_producer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
 {
-  ri_producer_t *producer = malloc(sizeof(ri_producer_t));
+  if (ri_channel_attr_validate(attr) < 0)
+    goto fail_attr;
+
+  ri_producer_t *producer = ri_arena_alloc(arena, sizeof(ri_producer_t) + ri_producer_queue_chain_size(attr));
   if (!producer)
     goto fail_alloc;
 
   *producer = (ri_producer_t) {
-    .shm_offset = shm_offset,
+    .arena = arena,
+    .layout = *layout,
     .eventfd = attr->eventfd ? eventfd : -1,
-    .info.size = attr->info.size,
+    .msg_align = attr->msg_align,
+    .cache_copy = ri_copy_select(RI_COPY_AUTO, attr->msg_size),
   };
 
-  if ((attr->info.size > 0) && attr->info.data) {
-    producer->info.data = malloc(attr->info.size);
+  /* reserved up front, so enabling the cache never allocates */
+  if (attr->cache) {
+    producer->cache_buf = ri_arena_alloc(arena, attr->msg_size);
+    if (!producer->cache_buf)
+      goto fail_cache;
+  }
 
-    if (!producer->info.data)
-      goto fail_info;
+  int r = info_copy(&producer->info, attr, arena);
+  if (r < 0)
+    goto fail_info;
 
-    memcpy(producer->info.data, attr->info.data, attr->info.size);
+  if (producer_dirty_init(&producer->dirty, attr, shm, layout, arena) < 0)
+    goto fail_dirty;
+
+  if (producer_blobs_init(&producer->blobs, attr, shm, layout, arena) < 0)
+    goto fail_blobs;
+
+  if (attr->interest) {
+    producer->interest.word = ri_shm_ptr(shm, layout->interest);
+    if (!producer->interest.word)
+      goto fail_interest;
+  }
+
+  if (attr->watermark) {
+    void *mem = ri_shm_ptr(shm, layout->watermark);
+    if (!mem)
+      goto fail_watermark;
+
+    ri_watermark_producer_init(&producer->watermark, mem);
   }
 
-  producer->queue = ri_producer_queue_new(attr, shm, shm_offset);
+  r = ri_producer_queue_init(&producer->queue, attr, shm, layout, producer->chain);
 
-  if (!producer->queue)
+  if (r < 0)
     goto fail_queue;
 
-  LOG_DBG("producer created add_msg=%u msg_size=%zu, eventfd=%d shm_offset=%zu", attr->add_msgs, attr->msg_size, attr->eventfd, shm_offset);
+  r = producer_lanes_init(producer, attr, shm, layout, arena);
+  if (r < 0)
+    goto fail_lanes;
+
+  ri_arena_ref(arena);
+
+  LOG_DBG("producer created add_msg=%u msg_size=%zu, eventfd=%d tail_offset=%zu", attr->add_msgs, attr->msg_size, attr->eventfd, layout->tail);
 
   return producer;
 
+fail_lanes:
+  for (unsigned i = 0; (i < producer->n_lanes) && producer->lanes[i]; i++)
+    ri_producer_queue_deinit(producer->lanes[i]);
 fail_queue:
-  if (producer->info.data)
-    free(producer->info.data);
+fail_watermark:
+fail_interest:
+fail_blobs:
+fail_dirty:
 fail_info:
-  free(producer);
+fail_cache:
 fail_alloc:
+fail_attr:
   return NULL;
 }
 
 
-ri_producer_t* ri_producer_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset)
+ri_producer_t* ri_producer_new(const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena)
 {
   int eventfd = -1;
 
@@ -187,11 +536,18 @@ ri_producer_t* ri_producer_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_
       goto fail_eventfd;
   }
 
-  ri_producer_t *producer = ri_producer_map(attr, eventfd, shm, shm_offset);
+  ri_producer_t *producer = ri_producer_map(attr, eventfd, shm, layout, arena);
   if (!producer)
     goto fail_producer;
 
-  ri_producer_queue_init_shm(producer->queue);
+  for (unsigned i = 0; i < producer->n_lanes; i++)
+    ri_producer_queue_init_shm(producer->lanes[i]);
+
+  if (producer->interest.word)
+    ri_interest_init_shm(producer->interest.word);
+
+  if (attr->watermark)
+    ri_watermark_init_shm(ri_shm_ptr(shm, layout->watermark), attr);
 
   return producer;
 
@@ -205,49 +561,54 @@ fail_eventfd:
 
 void ri_consumer_delete(ri_consumer_t *consumer)
 {
-  ri_consumer_queue_delete(consumer->queue);
+  for (unsigned i = 0; i < consumer->n_lanes; i++)
+    ri_consumer_queue_deinit(consumer->lanes[i]);
 
   if (consumer->eventfd >= 0)
     close(consumer->eventfd);
 
-  if (consumer->info.data)
-    free(consumer->info.data);
-
-  free(consumer);
+  ri_arena_unref(consumer->arena);
 }
 
 
 void ri_producer_delete(ri_producer_t *producer)
 {
-  ri_producer_queue_delete(producer->queue);
+  for (unsigned i = 0; i < producer->n_lanes; i++)
+    ri_producer_queue_deinit(producer->lanes[i]);
 
   if (producer->eventfd >= 0)
     close(producer->eventfd);
 
-  if (producer->info.data)
-    free(producer->info.data);
-
-  free(producer);
+  ri_arena_unref(producer->arena);
 }
 
 
 const void* ri_consumer_msg(const ri_consumer_t *consumer)
 {
-  return ri_consumer_queue_msg(consumer->queue);
+  return ri_consumer_queue_msg(consumer->lane);
 }
 
 
 void* ri_producer_msg(const ri_producer_t *producer)
 {
-  return producer->cache ? producer->cache : ri_producer_queue_msg(producer->queue);
+  return producer->cache ? producer->cache : ri_producer_queue_msg(producer->lane);
 }
 
 
 ri_attr_t ri_consumer_attr(const ri_consumer_t *consumer)
 {
   return (ri_attr_t) {
-      .add_msgs =  ri_consumer_queue_len(consumer->queue) - 3,
-      .msg_size = ri_consumer_queue_msg_size(consumer->queue),
+      .add_msgs =  ri_consumer_queue_len(&consumer->queue) - 3 - consumer->leases.n_leases,
+      .msg_size = ri_consumer_queue_msg_size(&consumer->queue),
+      .msg_align = consumer->msg_align,
+      .dirty_block = consumer->dirty.block_size,
+      .max_leases = consumer->leases.n_leases,
+      .relay = !!consumer->queue.queue.buffers,
+      .blob_size = consumer->blob_size,
+      .lanes = consumer->n_lanes > 1 ? consumer->n_lanes : 0,
+      .interest = !!consumer->interest,
+      .watermark = !!consumer->watermark.seqs,
+      .cache = consumer->cache,
       .eventfd = consumer->eventfd >= 0,
       .info.size = consumer->info.size,
       .info.data = consumer->info.data,
@@ -258,8 +619,17 @@ ri_attr_t ri_consumer_attr(const ri_consumer_t *consumer)
 ri_attr_t ri_producer_attr(const ri_producer_t *producer)
 {
   return (ri_attr_t) {
-    .add_msgs =  ri_producer_queue_len(producer->queue) - 3,
-    .msg_size = ri_producer_queue_msg_size(producer->queue),
+    .add_msgs =  ri_producer_queue_len(&producer->queue) - 3 - producer->queue.leases.n_leases,
+    .msg_size = ri_producer_queue_msg_size(&producer->queue),
+    .msg_align = producer->msg_align,
+    .dirty_block = producer->dirty.block_size,
+    .max_leases = producer->queue.leases.n_leases,
+    .relay = !!producer->queue.queue.buffers,
+    .blob_size = producer->blobs.size,
+    .lanes = producer->n_lanes > 1 ? producer->n_lanes : 0,
+    .interest = !!producer->interest.word,
+    .watermark = ri_watermark_enabled(&producer->watermark),
+    .cache = !!producer->cache_buf,
     .eventfd = producer->eventfd >= 0,
     .info.size = producer->info.size,
     .info.data = producer->info.data,
@@ -268,37 +638,162 @@ ri_attr_t ri_producer_attr(const ri_producer_t *producer)
 
 unsigned ri_consumer_len(const ri_consumer_t *consumer)
 {
-  return ri_consumer_queue_len(consumer->queue);
+  return ri_consumer_queue_len(&consumer->queue);
 }
 
 
 unsigned ri_producer_len(const ri_producer_t *producer)
 {
-  return ri_producer_queue_len(producer->queue);
+  return ri_producer_queue_len(&producer->queue);
 }
 
 
 size_t ri_consumer_msg_size(const ri_consumer_t *consumer)
 {
-  return ri_consumer_queue_msg_size(consumer->queue);
+  return ri_consumer_queue_msg_size(&consumer->queue);
 }
 
 
 size_t ri_producer_msg_size(const ri_producer_t *producer)
 {
-  return ri_producer_queue_msg_size(producer->queue);
+  return ri_producer_queue_msg_size(&producer->queue);
+}
+
+
+const ri_channel_layout_t* ri_consumer_layout(const ri_consumer_t *consumer)
+{
+  return &consumer->layout;
+}
+
+
+const ri_channel_layout_t* ri_producer_layout(const ri_producer_t *producer)
+{
+  return &producer->layout;
+}
+
+
+bool ri_consumer_ready(const ri_consumer_t *consumer)
+{
+  for (unsigned i = 0; i < consumer->n_lanes; i++) {
+    if (ri_consumer_queue_ready(consumer->lanes[i]))
+      return true;
+  }
+
+  return false;
+}
+
+
+ri_index_t ri_consumer_current(const ri_consumer_t *consumer)
+{
+  return ri_consumer_queue_current(consumer->lane);
+}
+
+
+unsigned ri_consumer_n_lanes(const ri_consumer_t *consumer)
+{
+  return consumer->n_lanes;
+}
+
+
+unsigned ri_consumer_lane(const ri_consumer_t *consumer)
+{
+  unsigned i;
+
+  for (i = 0; consumer->lanes[i] != consumer->lane; i++)
+    ;
+
+  return i;
+}
+
+
+int ri_consumer_set_interest(ri_consumer_t *consumer, uint64_t mask, uint64_t interval)
+{
+  if (!consumer->interest)
+    return -ENOTSUP;
+
+  ri_interest_set(consumer->interest, mask, interval);
+
+  return 0;
+}
+
+
+bool ri_producer_should_push(ri_producer_t *producer, unsigned type)
+{
+  if (!producer->interest.word)
+    return true;
+
+  return ri_interest_grant(&producer->interest, type);
+}
+
+
+int ri_producer_progress(const ri_producer_t *producer, uint64_t *pushed, uint64_t *consumed)
+{
+  if (!ri_watermark_enabled(&producer->watermark))
+    return -ENOTSUP;
+
+  if (pushed)
+    *pushed = producer->watermark.pushed;
+
+  if (consumed)
+    *consumed = ri_watermark_consumed(&producer->watermark);
+
+  return 0;
 }
 
 
-size_t ri_consumer_shm_offset(const ri_consumer_t *consumer)
+/* the producer's current slot is never queued, neither is the one held by the consumer */
+static unsigned queue_capacity(const ri_queue_t *queue, bool held)
 {
-  return consumer->shm_offset;
+  return queue->n_msgs - queue->n_leases - 1 - held;
+}
+
+
+int ri_producer_occupancy(const ri_producer_t *producer)
+{
+  const ri_watermark_producer_t *watermark = &producer->watermark;
+
+  if (!ri_watermark_enabled(watermark))
+    return -ENOTSUP;
+
+  uint64_t consumed = ri_watermark_consumed(watermark);
+
+  /* once the consumer popped a message it usually keeps one */
+  return ri_watermark_queued(watermark->pushed, consumed,
+                             queue_capacity(&producer->queue.queue, consumed != 0));
+}
+
+
+int ri_consumer_backlog(const ri_consumer_t *consumer)
+{
+  const ri_watermark_consumer_t *watermark = &consumer->watermark;
+  const ri_queue_t *queue = &consumer->queue.queue;
+
+  if (!watermark->seqs)
+    return -ENOTSUP;
+
+  ri_index_t head = ri_queue_head_load(queue);
+
+  if (head == RI_INDEX_INVALID)
+    return 0;
+
+  if (!ri_queue_index_valid(queue, head))
+    return -EIO;
+
+  bool held = ri_consumer_queue_msg(&consumer->queue) != NULL;
+
+  return ri_watermark_queued(ri_watermark_seq(watermark, head), ri_watermark_last(watermark),
+                             queue_capacity(queue, held));
 }
 
 
-size_t ri_prdoucer_shm_offset(const ri_producer_t *producer)
+int ri_producer_select_lane(ri_producer_t *producer, unsigned lane)
 {
-  return producer->shm_offset;
+  if (lane >= producer->n_lanes)
+    return -EINVAL;
+
+  producer->lane = producer->lanes[lane];
+
+  return 0;
 }
 
 
@@ -350,21 +845,69 @@ ri_info_t ri_producer_info(const ri_producer_t *producer)
 
 void ri_consumer_free_info(ri_consumer_t *consumer)
 {
-  if (consumer->info.data) {
-    free(consumer->info.data);
-    consumer->info.data = NULL;
-    consumer->info.size = 0;
-  }
+  consumer->info = (ri_info_t) { 0 };
 }
 
 
 void ri_producer_free_info(ri_producer_t *producer)
 {
-  if (producer->info.data) {
-    free(producer->info.data);
-    producer->info.data = NULL;
-    producer->info.size = 0;
+  producer->info = (ri_info_t) { 0 };
+}
+
+
+/* the highest lane wins, the messages of the lower lanes stay queued */
+static ri_pop_result_t lanes_pop(ri_consumer_t *consumer)
+{
+  ri_pop_result_t result = RI_POP_RESULT_NO_MSG;
+
+  for (unsigned i = consumer->n_lanes; i-- > 0;) {
+    ri_pop_result_t r = ri_consumer_queue_pop(consumer->lanes[i]);
+
+    if (r > RI_POP_RESULT_NO_UPDATE) {
+      consumer->lane = consumer->lanes[i];
+      return r;
+    }
+
+    if (r == RI_POP_RESULT_ERROR)
+      return r;
+
+    if (r == RI_POP_RESULT_NO_UPDATE)
+      result = r;
   }
+
+  return result;
+}
+
+
+/* flushes the highest lane with a new message, every message popped
+ * takes one count from the shared eventfd */
+static ri_pop_result_t lanes_flush(ri_consumer_t *consumer)
+{
+  for (unsigned i = consumer->n_lanes; i-- > 0;) {
+    ri_consumer_queue_t *lane = consumer->lanes[i];
+
+    if (!ri_consumer_queue_ready(lane))
+      continue;
+
+    consumer->lane = lane;
+
+    if (consumer->eventfd < 0)
+      return ri_consumer_queue_flush(lane);
+
+    ri_pop_result_t r;
+    ri_pop_result_t result = RI_POP_RESULT_NO_UPDATE;
+
+    while ((r = ri_consumer_queue_pop(lane)) > RI_POP_RESULT_NO_UPDATE) {
+      uint64_t v;
+      read(consumer->eventfd, &v, sizeof(v));
+      result = r;
+    }
+
+    return r == RI_POP_RESULT_ERROR ? r : result;
+  }
+
+  bool popped = ri_consumer_queue_current(consumer->lane) != RI_INDEX_INVALID;
+  return popped ? RI_POP_RESULT_NO_UPDATE : RI_POP_RESULT_NO_MSG;
 }
 
 
@@ -375,36 +918,197 @@ ri_pop_result_t ri_consumer_pop(ri_consumer_t *consumer)
     int r = read(consumer->eventfd, &v, sizeof(v));
 
     if (r < 0) {
-      return ri_consumer_queue_msg(consumer->queue)? RI_POP_RESULT_NO_UPDATE : RI_POP_RESULT_NO_MSG;
+      bool popped = ri_consumer_queue_current(consumer->lane) != RI_INDEX_INVALID;
+      return popped ? RI_POP_RESULT_NO_UPDATE : RI_POP_RESULT_NO_MSG;
     }
   }
 
-  return ri_consumer_queue_pop(consumer->queue);
+  ri_pop_result_t r;
+
+  if (consumer->n_lanes > 1)
+    r = lanes_pop(consumer);
+  else
+    r = ri_consumer_queue_pop(&consumer->queue);
+
+  if (r <= RI_POP_RESULT_NO_UPDATE)
+    return r;
+
+  /* the lane of the popped message, lanes exclude dirty tracking and watermarks */
+  if (consumer->dirty.n_blocks)
+    ri_dirty_consume(&consumer->dirty, ri_consumer_queue_current(consumer->lane));
+
+  if (consumer->watermark.seqs)
+    ri_watermark_consume(&consumer->watermark, ri_consumer_queue_current(consumer->lane));
+
+  if (consumer->prefetch)
+    ri_consumer_queue_prefetch(consumer->lane, consumer->prefetch);
+
+  return r;
 }
 
 
 ri_pop_result_t ri_consumer_flush(ri_consumer_t *consumer)
 {
   ri_pop_result_t r;
+
+  if (consumer->n_lanes > 1)
+    return lanes_flush(consumer);
+
   if (consumer->eventfd >= 0) {
+    uint64_t seq = consumer->dirty.seq;
+
     do {
       r = ri_consumer_pop(consumer);
     } while (r == RI_POP_RESULT_SUCCESS);
+
+    /* the bitmap of the last pop doesn't cover the messages popped before */
+    if ((consumer->dirty.seq != seq) && (consumer->dirty.seq != seq + 1))
+      consumer->dirty.bitmap = consumer->dirty.all;
   } else {
-    r = ri_consumer_queue_flush(consumer->queue);
+    r = ri_consumer_queue_flush(&consumer->queue);
+
+    if ((r > RI_POP_RESULT_NO_UPDATE) && consumer->dirty.n_blocks)
+      ri_dirty_consume(&consumer->dirty, ri_consumer_queue_current(&consumer->queue));
+
+    if ((r > RI_POP_RESULT_NO_UPDATE) && consumer->watermark.seqs)
+      ri_watermark_consume(&consumer->watermark, ri_consumer_queue_current(&consumer->queue));
   }
 
   return r;
 }
 
 
-ri_force_push_result_t ri_producer_force_push(ri_producer_t *producer)
+ri_pop_result_t ri_consumer_pop_into(ri_consumer_t *consumer, void *dst, size_t size)
 {
-  if (producer->cache) {
-    producer_cache_write(producer);
+  size_t msg_size = ri_consumer_queue_msg_size(&consumer->queue);
+
+  if (size < msg_size)
+    return RI_POP_RESULT_ERROR;
+
+  ri_pop_result_t r = ri_consumer_pop(consumer);
+
+  if (r <= RI_POP_RESULT_NO_UPDATE)
+    return r;
+
+  consumer->copy_out(dst, ri_consumer_queue_msg(consumer->lane), msg_size);
+
+  if (consumer->dirty.n_blocks)
+    ri_dirty_detach(&consumer->dirty);
+
+  ri_consumer_queue_release(consumer->lane);
+
+  return r;
+}
+
+
+int ri_consumer_lease(ri_consumer_t *consumer)
+{
+  if (consumer->leases.n_leases == 0)
+    return -ENOTSUP;
+
+  /* nothing popped or the slot was released by ri_consumer_pop_into */
+  if (!ri_consumer_queue_msg(&consumer->queue))
+    return -ENOENT;
+
+  return ri_lease_acquire(&consumer->leases, ri_consumer_queue_current(&consumer->queue));
+}
+
+
+const void* ri_consumer_lease_msg(const ri_consumer_t *consumer, unsigned id)
+{
+  return ri_queue_get_msg(&consumer->queue.queue, ri_lease_slot(&consumer->leases, id));
+}
+
+
+int ri_consumer_release(ri_consumer_t *consumer, unsigned id)
+{
+  return ri_lease_release(&consumer->leases, id);
+}
+
+
+int ri_consumer_relay(ri_consumer_t *consumer, ri_producer_t *producer)
+{
+  ri_queue_t *src = &consumer->queue.queue;
+  ri_queue_t *dst = &producer->queue.queue;
+
+  if (!src->buffers || !dst->buffers)
+    return -ENOTSUP;
+
+  /* buffer offsets are only meaningful within one shared memory */
+  if (consumer->queue.shm != producer->queue.shm)
+    return -EXDEV;
+
+  if ((src->msg_size != dst->msg_size) || (src->msg_size_aligned != dst->msg_size_aligned))
+    return -EINVAL;
+
+  /* the cache would be written back over the relayed message */
+  if (producer->cache)
+    return -EBUSY;
+
+  if (!ri_consumer_queue_msg(&consumer->queue))
+    return -ENOENT;
+
+  ri_index_t current = ri_consumer_queue_current(&consumer->queue);
+
+  for (unsigned i = 0; i < consumer->leases.n_leases; i++) {
+    if (ri_lease_slot(&consumer->leases, i) == current)
+      return -EBUSY;
   }
 
-  ri_force_push_result_t r = ri_producer_queue_force_push(producer->queue);
+  int r = ri_queue_swap_buffers(src, current, dst, producer->queue.current);
+  if (r < 0)
+    return r;
+
+  ri_producer_queue_refresh(&producer->queue);
+
+  /* the slot holds the producer's old buffer now, hand it back right away */
+  ri_consumer_queue_release(&consumer->queue);
+
+  return 0;
+}
+
+
+const void* ri_consumer_blob(const ri_consumer_t *consumer, ri_blob_t blob)
+{
+  return ri_blob_get(consumer->blobs, consumer->blob_size, blob);
+}
+
+
+void* ri_producer_blob_alloc(ri_producer_t *producer, size_t size, ri_blob_t *blob)
+{
+  if (producer->blobs.size == 0)
+    return NULL;
+
+  return ri_blob_alloc(&producer->blobs, producer->queue.current, size, blob);
+}
+
+
+const uint64_t* ri_consumer_dirty(const ri_consumer_t *consumer, unsigned *n_blocks)
+{
+  if (n_blocks)
+    *n_blocks = consumer->dirty.n_blocks;
+
+  return consumer->dirty.n_blocks ? consumer->dirty.bitmap : NULL;
+}
+
+
+ri_force_push_result_t ri_producer_force_push(ri_producer_t *producer)
+{
+  producer_write_back(producer);
+
+  if (ri_watermark_enabled(&producer->watermark))
+    ri_watermark_stamp(&producer->watermark, producer->queue.current);
+
+  ri_force_push_result_t r = ri_producer_queue_force_push(producer->lane);
+
+  if (ri_watermark_enabled(&producer->watermark) && (r > 0))
+    producer->watermark.pushed++;
+
+  if (producer->blobs.size && (r > 0))
+    ri_blob_recycle(&producer->blobs, producer->queue.current);
+
+  if (producer->prefetch)
+    ri_prefetch_write(ri_producer_queue_msg(producer->lane), producer->prefetch);
 
   if ((producer->eventfd >= 0) && (r == RI_FORCE_PUSH_RESULT_SUCCESS)) {
     uint64_t v = 1;
@@ -417,14 +1121,26 @@ ri_force_push_result_t ri_producer_force_push(ri_producer_t *producer)
 
 ri_try_push_result_t ri_producer_try_push(ri_producer_t *producer)
 {
-  if (producer->cache) {
-    if (ri_producer_queue_full(producer->queue))
+  if (producer->cache || ri_dirty_enabled(&producer->dirty)) {
+    if (ri_producer_queue_full(&producer->queue))
       return RI_TRY_PUSH_RESULT_FAIL;
 
-    producer_cache_write(producer);
+    producer_write_back(producer);
   }
 
-  ri_try_push_result_t r = ri_producer_queue_try_push(producer->queue);
+  if (ri_watermark_enabled(&producer->watermark))
+    ri_watermark_stamp(&producer->watermark, producer->queue.current);
+
+  ri_try_push_result_t r = ri_producer_queue_try_push(producer->lane);
+
+  if (ri_watermark_enabled(&producer->watermark) && (r == RI_TRY_PUSH_RESULT_SUCCESS))
+    producer->watermark.pushed++;
+
+  if (producer->blobs.size && (r == RI_TRY_PUSH_RESULT_SUCCESS))
+    ri_blob_recycle(&producer->blobs, producer->queue.current);
+
+  if (producer->prefetch && (r == RI_TRY_PUSH_RESULT_SUCCESS))
+    ri_prefetch_write(ri_producer_queue_msg(producer->lane), producer->prefetch);
 
   if ((producer->eventfd >= 0) && (r == RI_TRY_PUSH_RESULT_SUCCESS)) {
     uint64_t v = 1;
@@ -440,16 +1156,22 @@ int ri_producer_cache_enable(ri_producer_t *producer)
   if (producer->cache)
     return 0;
 
-  size_t msg_size = ri_producer_queue_msg_size(producer->queue);
+  /* a single cache can't follow the current messages of several lanes */
+  if (producer->n_lanes > 1)
+    return -ENOTSUP;
 
-  producer->cache = malloc(msg_size);
+  if (!producer->cache_buf)
+    return -ENOBUFS;
 
-  if (!producer->cache)
-    return -ENOMEM;
+  size_t msg_size = ri_producer_queue_msg_size(&producer->queue);
+  void *msg = ri_producer_queue_msg(&producer->queue);
+
+  memcpy(producer->cache_buf, msg, msg_size);
 
-  void *msg = ri_producer_queue_msg(producer->queue);
+  producer->cache = producer->cache_buf;
 
-  memcpy(producer->cache, msg, msg_size);
+  if (ri_dirty_enabled(&producer->dirty))
+    ri_dirty_reset(&producer->dirty);
 
   return 0;
 }
@@ -460,11 +1182,57 @@ void ri_producer_cache_disable(ri_producer_t *producer)
   if (!producer->cache)
     return;
 
-  size_t msg_size = ri_producer_queue_msg_size(producer->queue);
-  void *msg = ri_producer_queue_msg(producer->queue);
+  size_t msg_size = ri_producer_queue_msg_size(&producer->queue);
+  void *msg = ri_producer_queue_msg(&producer->queue);
 
-  memcpy(msg, producer->cache, msg_size);
+  producer->cache_copy(msg, producer->cache, msg_size);
 
-  free(producer->cache);
   producer->cache = NULL;
 }
+
+
+int ri_producer_set_copy_mode(ri_producer_t *producer, ri_copy_mode_t mode)
+{
+  size_t msg_size = ri_producer_queue_msg_size(&producer->queue);
+  ri_copy_fn copy = ri_copy_select(mode, msg_size);
+
+  if (!copy)
+    return -EINVAL;
+
+  producer->cache_copy = copy;
+
+  return 0;
+}
+
+
+void ri_producer_set_prefetch(ri_producer_t *producer, size_t distance)
+{
+  size_t msg_size = ri_producer_queue_msg_size(&producer->queue);
+
+  producer->prefetch = distance < msg_size ? distance : msg_size;
+}
+
+
+void ri_consumer_set_prefetch(ri_consumer_t *consumer, size_t distance)
+{
+  size_t msg_size = ri_consumer_queue_msg_size(&consumer->queue);
+
+  consumer->prefetch = distance < msg_size ? distance : msg_size;
+}
+
+
+int ri_producer_mark_dirty(ri_producer_t *producer, size_t offset, size_t size)
+{
+  if (!ri_dirty_enabled(&producer->dirty))
+    return -ENOTSUP;
+
+  size_t msg_size = ri_producer_queue_msg_size(&producer->queue);
+
+  if ((offset > msg_size) || (size > msg_size - offset))
+    return -EINVAL;
+
+  if (size > 0)
+    ri_dirty_mark(&producer->dirty, offset, size);
+
+  return 0;
+}
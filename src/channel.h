@@ -2,13 +2,23 @@
 
 #include "rtipc/rtipc.h"
 
+#include "arena.h"
+#include "index.h"
+#include "layout.h"
+#include "mem_utils.h"
 #include "shm.h"
 
 #define RI_CHANNEL_MIN_MSGS 3
 
 size_t ri_calc_queue_size(unsigned n_msgs);
 
-size_t ri_calc_channel_shm_size(unsigned n_msgs, size_t msg_size);
+size_t ri_calc_msg_stride(size_t msg_size, unsigned msg_align);
+
+size_t ri_calc_data_size(unsigned n_msgs, size_t msg_stride);
+
+size_t ri_calc_channel_shm_size(unsigned n_msgs, size_t msg_stride);
+
+int ri_channel_attr_validate(const ri_attr_t *attr);
 
 
 static inline unsigned ri_count_channels(const ri_attr_t attrs[])
@@ -25,42 +35,81 @@ static inline unsigned ri_count_channels(const ri_attr_t attrs[])
 }
 
 
-static inline unsigned ri_channel_queue_len(const ri_attr_t *attr)
+/* slots circulating between producer and consumer */
+static inline unsigned ri_channel_ring_len(const ri_attr_t *attr)
 {
   return RI_CHANNEL_MIN_MSGS + attr->add_msgs;
 }
 
 
+/* all slots, including the spares for leases */
+static inline unsigned ri_channel_queue_len(const ri_attr_t *attr)
+{
+  return ri_channel_ring_len(attr) + attr->max_leases;
+}
+
+
 static inline size_t ri_channel_queue_size(const ri_attr_t *attr)
 {
   return ri_calc_queue_size(ri_channel_queue_len(attr));
 }
 
 
+static inline size_t ri_channel_msg_stride(const ri_attr_t *attr)
+{
+  return ri_calc_msg_stride(attr->msg_size, attr->msg_align);
+}
+
+
+static inline size_t ri_channel_data_size(const ri_attr_t *attr)
+{
+  return ri_calc_data_size(ri_channel_queue_len(attr), ri_channel_msg_stride(attr));
+}
+
+
 static inline size_t ri_channel_shm_size(const ri_attr_t *attr)
 {
-  return ri_calc_channel_shm_size(ri_channel_queue_len(attr), attr->msg_size);
+  return ri_calc_channel_shm_size(ri_channel_queue_len(attr), ri_channel_msg_stride(attr));
+}
+
+
+/* per-slot buffer offsets of relay channels */
+static inline size_t ri_channel_buffers_size(const ri_attr_t *attr)
+{
+  return attr->relay ? cacheline_aligned(ri_channel_queue_len(attr) * sizeof(uint64_t)) : 0;
 }
 
 
-size_t ri_calc_shm_size(const ri_attr_t consumers[], const ri_attr_t producers[]);
+/* arena space needed for a channel handle */
+size_t ri_consumer_alloc_size(const ri_attr_t *attr);
 
+size_t ri_producer_alloc_size(const ri_attr_t *attr);
 
-ri_consumer_t* ri_consumer_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset);
+ri_consumer_t* ri_consumer_new(const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena);
 
-ri_producer_t* ri_producer_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset);
+ri_producer_t* ri_producer_new(const ri_attr_t *attr, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena);
 
-ri_consumer_t* ri_consumer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm, size_t shm_offset);
+ri_consumer_t* ri_consumer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena);
 
-ri_producer_t* ri_producer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm, size_t shm_offset);
+ri_producer_t* ri_producer_map(const ri_attr_t *attr, int eventfd, ri_shm_t *shm,
+                               const ri_channel_layout_t *layout, ri_arena_t *arena);
 
 ri_attr_t ri_consumer_attr(const ri_consumer_t *consumer);
 
 ri_attr_t ri_producer_attr(const ri_producer_t *producer);
 
-size_t ri_consumer_shm_offset(const ri_consumer_t *consumer);
+const ri_channel_layout_t* ri_consumer_layout(const ri_consumer_t *consumer);
+
+const ri_channel_layout_t* ri_producer_layout(const ri_producer_t *producer);
+
+bool ri_consumer_ready(const ri_consumer_t *consumer);
+
+ri_index_t ri_consumer_current(const ri_consumer_t *consumer);
 
-size_t ri_prdoucer_shm_offset(const ri_producer_t *producer);
+unsigned ri_consumer_n_lanes(const ri_consumer_t *consumer);
 
 unsigned ri_consumer_len(const ri_consumer_t *consumer);
 
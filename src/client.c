@@ -9,40 +9,9 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#include "alloc.h"
 #include "unix.h"
 
-static int connect_path(const char *path)
-{
-  int r;
-
-  int sockfd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
-  if (sockfd < 0) {
-    r = -errno;
-    LOG_ERR("socket failed errno=%u", errno);
-    goto fail_socket;
-  }
-
-  struct sockaddr_un addr;
-
-  addr.sun_family = AF_UNIX;
-  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
-
-  r = connect(sockfd, (struct sockaddr*)&addr, sizeof(addr));
-  if (r < 0) {
-    r = -errno;
-    LOG_ERR("connect failed errno=%u", errno);
-    goto fail_connect;
-  }
-
-  return sockfd;
-
-fail_connect:
-  close(sockfd);
-fail_socket:
-  return r;
-}
-
-
 static int exchange(int socket, ri_uxmsg_t *req)
 {
   int r = ri_uxmsg_send(req, socket);
@@ -69,12 +38,12 @@ static int exchange(int socket, ri_uxmsg_t *req)
 
   memcpy(&result, response, sizeof(result));
 
-  free(response);
+  ri_free(response);
 
   return result;
 
 fail_response:
-  free(response);
+  ri_free(response);
 fail_receive:
 fail_send:
   return r;
@@ -146,7 +115,7 @@ fail_vec:
 
 ri_vector_t* ri_client_connect(const char *path, const ri_config_t *config)
 {
-  int socket = connect_path(path);
+  int socket = ri_uxsocket_connect(path);
 
   if (socket < 0) {
     return NULL;
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+
+/* monotonic time in nanoseconds */
+static inline uint64_t ri_clock_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
@@ -1,73 +1,34 @@
 #include "consumer.h"
 
-#include <stdlib.h>
+#include <errno.h>
 
+#include "prefetch.h"
 #include "queue.h"
 
-struct ri_consumer_queue {
-  /**
-   * Pointer to the shared memory this queue is mapped to.
-   * Only used to decrement the shared memory reference counter on deletion.
-   */
-  ri_shm_t *shm;
-
-  /**
-   * The queue structure stored in shared memory.
-   */
-  ri_queue_t queue;
-
-  /**
-   * Index of the message currently being used by the consumer.
-   */
-  ri_index_t current;
-};
-
-
-unsigned ri_consumer_queue_len(const ri_consumer_queue_t *consumer)
-{
-  return consumer->queue.n_msgs;
-}
-
-
-size_t ri_consumer_queue_msg_size(const ri_consumer_queue_t *consumer)
+int ri_consumer_queue_init(ri_consumer_queue_t *consumer, const ri_attr_t *attr,
+                           ri_shm_t *shm, const ri_channel_layout_t *layout)
 {
-  return consumer->queue.msg_size;
-}
-
-
-ri_consumer_queue_t* ri_consumer_queue_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset)
-{
-  ri_consumer_queue_t *consumer = malloc(sizeof(ri_consumer_queue_t));
-  if (!consumer)
-    goto fail_alloc;
-
   *consumer = (ri_consumer_queue_t) {
       .shm = shm,
-      .current = 0,
+      .current = RI_INDEX_INVALID,
   };
 
-  void *ptr = ri_shm_ptr(shm, shm_offset);
+  void *ptr = ri_shm_ptr(shm, 0);
 
   if (!ptr)
-    goto fail_shm;
+    return -EINVAL;
 
-  ri_queue_init(&consumer->queue, attr, ptr);
+  ri_queue_init(&consumer->queue, attr, ptr, ri_shm_size(shm), layout);
 
   ri_shm_ref(consumer->shm);
 
-  return consumer;
-
-fail_shm:
-  free(consumer);
-fail_alloc:
-  return NULL;
+  return 0;
 }
 
 
-void ri_consumer_queue_delete(ri_consumer_queue_t *consumer)
+void ri_consumer_queue_deinit(ri_consumer_queue_t *consumer)
 {
   ri_shm_unref(consumer->shm);
-  free(consumer);
 }
 
 
@@ -77,7 +38,7 @@ void ri_consumer_queue_init_shm(const ri_consumer_queue_t *consumer)
 }
 
 
-ri_pop_result_t ri_consumer_queue_flush(ri_consumer_queue_t *consumer)
+static ri_pop_result_t flush(ri_consumer_queue_t *consumer)
 {
   ri_queue_t *queue = &consumer->queue;
 
@@ -113,7 +74,7 @@ ri_pop_result_t ri_consumer_queue_flush(ri_consumer_queue_t *consumer)
   return RI_POP_RESULT_DISCARDED;
 }
 
-ri_pop_result_t ri_consumer_queue_pop(ri_consumer_queue_t *consumer)
+static ri_pop_result_t pop(ri_consumer_queue_t *consumer)
 {
   ri_queue_t *queue = &consumer->queue;
   ri_index_t tail = ri_queue_tail_fetch_or(queue, RI_CONSUMED_FLAG);
@@ -147,19 +108,88 @@ ri_pop_result_t ri_consumer_queue_pop(ri_consumer_queue_t *consumer)
     /* producer just moved tail, use it */
     ri_index_t current = ri_queue_tail_fetch_or(queue, RI_CONSUMED_FLAG);
 
-    if (!ri_queue_index_valid(queue, current))
+    if (!ri_queue_index_valid(queue, current & RI_INDEX_MASK))
       return RI_POP_RESULT_ERROR;
 
-    consumer->current = current;
+    consumer->current = current & RI_INDEX_MASK;
 
-    return RI_POP_RESULT_DISCARDED;
+    /* the producer reused a released tail, nothing was discarded */
+    return (current & RI_FIRST_FLAG) ? RI_POP_RESULT_SUCCESS : RI_POP_RESULT_DISCARDED;
   }
 }
 
-const void* ri_consumer_queue_msg(const ri_consumer_queue_t *consumer)
+ri_pop_result_t ri_consumer_queue_pop(ri_consumer_queue_t *consumer)
+{
+  ri_pop_result_t r = pop(consumer);
+
+  if (r > RI_POP_RESULT_NO_UPDATE) {
+    consumer->msg = ri_queue_get_msg(&consumer->queue, consumer->current);
+
+    /* invalid buffer offset of a relay channel */
+    if (!consumer->msg)
+      return RI_POP_RESULT_ERROR;
+  }
+
+  return r;
+}
+
+
+ri_pop_result_t ri_consumer_queue_flush(ri_consumer_queue_t *consumer)
 {
+  ri_pop_result_t r = flush(consumer);
+
+  if (r > RI_POP_RESULT_NO_UPDATE) {
+    consumer->msg = ri_queue_get_msg(&consumer->queue, consumer->current);
+
+    if (!consumer->msg)
+      return RI_POP_RESULT_ERROR;
+  }
+
+  return r;
+}
+
+
+void ri_consumer_queue_release(ri_consumer_queue_t *consumer)
+{
+  const ri_queue_t *queue = &consumer->queue;
+  ri_index_t tail = ri_queue_tail_load(queue);
+
+  consumer->msg = NULL;
+
+  /* tail not consumed: the producer already jumped over the message
+   * and takes it back with the next pop */
+  if (!(tail & RI_CONSUMED_FLAG) || (tail & RI_RELEASED_FLAG))
+    return;
+
+  /* fails only if the producer just overran the consumer, same as above */
+  ri_queue_tail_compare_exchange(queue, tail, tail | RI_RELEASED_FLAG);
+}
+
+
+void ri_consumer_queue_prefetch(const ri_consumer_queue_t *consumer, size_t size)
+{
+  const ri_queue_t *queue = &consumer->queue;
+
   if (consumer->current == RI_INDEX_INVALID)
-    return NULL;
+    return;
+
+  ri_index_t next = ri_queue_chain_load(queue, consumer->current);
+
+  /* only published messages, prefetching a slot the producer is still
+   * writing would take its cachelines away */
+  if (!ri_queue_index_valid(queue, next))
+    return;
+
+  ri_prefetch_read(&queue->chain[next], sizeof(queue->chain[next]));
+  ri_prefetch_read(ri_queue_get_msg(queue, next), size);
+}
+
+
+/* the producer never writes to the message held by the consumer,
+ * so any other head means that a newer message is available */
+bool ri_consumer_queue_ready(const ri_consumer_queue_t *consumer)
+{
+  ri_index_t head = ri_queue_head_load(&consumer->queue);
 
-  return ri_queue_get_msg(&consumer->queue, consumer->current);
+  return (head != RI_INDEX_INVALID) && (head != consumer->current);
 }
@@ -1,22 +1,72 @@
 #pragma once
 
 #include "rtipc/rtipc.h"
+#include "index.h"
+#include "layout.h"
+#include "queue.h"
 #include "shm.h"
 
-typedef struct ri_consumer_queue ri_consumer_queue_t;
+typedef struct ri_consumer_queue {
+  /**
+   * The queue structure stored in shared memory.
+   */
+  ri_queue_t queue;
 
-ri_consumer_queue_t* ri_consumer_queue_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset);
+  /**
+   * Pointer to the message with index 'current',
+   * NULL if no message was consumed yet.
+   */
+  const void *msg;
+
+  /**
+   * Index of the message currently being used by the consumer.
+   */
+  ri_index_t current;
+
+  /**
+   * Pointer to the shared memory this queue is mapped to.
+   * Only used to decrement the shared memory reference counter on deletion.
+   */
+  ri_shm_t *shm;
+} ri_consumer_queue_t;
+
+int ri_consumer_queue_init(ri_consumer_queue_t *consumer, const ri_attr_t *attr,
+                           ri_shm_t *shm, const ri_channel_layout_t *layout);
 
 void ri_consumer_queue_init_shm(const ri_consumer_queue_t *consumer);
 
-void ri_consumer_queue_delete(ri_consumer_queue_t *consumer);
+void ri_consumer_queue_deinit(ri_consumer_queue_t *consumer);
 
-unsigned ri_consumer_queue_len(const ri_consumer_queue_t *consumer);
+static inline unsigned ri_consumer_queue_len(const ri_consumer_queue_t *consumer)
+{
+  return consumer->queue.n_msgs;
+}
 
-size_t ri_consumer_queue_msg_size(const ri_consumer_queue_t *consumer);
+static inline size_t ri_consumer_queue_msg_size(const ri_consumer_queue_t *consumer)
+{
+  return consumer->queue.msg_size;
+}
 
-const void* ri_consumer_queue_msg(const ri_consumer_queue_t *consumer);
+static inline const void* ri_consumer_queue_msg(const ri_consumer_queue_t *consumer)
+{
+  return consumer->msg;
+}
 
 ri_pop_result_t ri_consumer_queue_pop(ri_consumer_queue_t *consumer);
 
 ri_pop_result_t ri_consumer_queue_flush(ri_consumer_queue_t *consumer);
+
+static inline ri_index_t ri_consumer_queue_current(const ri_consumer_queue_t *consumer)
+{
+  return consumer->current;
+}
+
+bool ri_consumer_queue_ready(const ri_consumer_queue_t *consumer);
+
+/* hands the current message back to the producer, which may reuse its slot
+ * without discarding a message; the message must not be accessed anymore */
+void ri_consumer_queue_release(ri_consumer_queue_t *consumer);
+
+/* prefetches the chain entry and the first size bytes of the message
+ * following the current one, if it is already published */
+void ri_consumer_queue_prefetch(const ri_consumer_queue_t *consumer, size_t size);
@@ -0,0 +1,228 @@
+#include "copy.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rtipc/log.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RI_COPY_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RI_COPY_NEON
+#endif
+
+
+typedef struct copy_impl {
+  const char *name;
+  ri_copy_fn temporal;
+  ri_copy_fn streaming;
+} copy_impl_t;
+
+
+static void copy_plain(void *dst, const void *src, size_t size)
+{
+  memcpy(dst, src, size);
+}
+
+
+/* bytes until dst is aligned to align */
+static size_t copy_head(void *dst, size_t align, size_t size)
+{
+  size_t head = (align - ((uintptr_t)dst & (align - 1))) & (align - 1);
+
+  return head < size ? head : size;
+}
+
+
+#if defined(RI_COPY_X86)
+
+#define TEMPORAL_LOOP(type, load, store, dst, src, size)    \
+  do {                                                      \
+    size_t n = size / sizeof(type);                         \
+    type *d = dst;                                          \
+    const type *s = src;                                    \
+    for (size_t i = 0; i < n; i++)                          \
+      store(&d[i], load(&s[i]));                            \
+    memcpy(&d[n], &s[n], size - n * sizeof(type));          \
+  } while (0)
+
+
+#define STREAMING_LOOP(type, load, store, dst, src, size)   \
+  do {                                                      \
+    size_t head = copy_head(dst, sizeof(type), size);       \
+    memcpy(dst, src, head);                                 \
+    size_t n = (size - head) / sizeof(type);                \
+    type *d = (type*)((uint8_t*)dst + head);                \
+    const type *s = (const type*)((const uint8_t*)src + head); \
+    for (size_t i = 0; i < n; i++)                          \
+      store(&d[i], load(&s[i]));                            \
+    memcpy(&d[n], &s[n], size - head - n * sizeof(type));   \
+    _mm_sfence();                                           \
+  } while (0)
+
+
+__attribute__((target("sse2")))
+static void copy_sse2_temporal(void *dst, const void *src, size_t size)
+{
+  TEMPORAL_LOOP(__m128i, _mm_loadu_si128, _mm_storeu_si128, dst, src, size);
+}
+
+
+__attribute__((target("sse2")))
+static void copy_sse2_streaming(void *dst, const void *src, size_t size)
+{
+  STREAMING_LOOP(__m128i, _mm_loadu_si128, _mm_stream_si128, dst, src, size);
+}
+
+
+__attribute__((target("avx2")))
+static void copy_avx2_temporal(void *dst, const void *src, size_t size)
+{
+  TEMPORAL_LOOP(__m256i, _mm256_loadu_si256, _mm256_storeu_si256, dst, src, size);
+}
+
+
+__attribute__((target("avx2")))
+static void copy_avx2_streaming(void *dst, const void *src, size_t size)
+{
+  STREAMING_LOOP(__m256i, _mm256_loadu_si256, _mm256_stream_si256, dst, src, size);
+}
+
+
+__attribute__((target("avx512f")))
+static void copy_avx512_temporal(void *dst, const void *src, size_t size)
+{
+  TEMPORAL_LOOP(__m512i, _mm512_loadu_si512, _mm512_storeu_si512, dst, src, size);
+}
+
+
+__attribute__((target("avx512f")))
+static void copy_avx512_streaming(void *dst, const void *src, size_t size)
+{
+  STREAMING_LOOP(__m512i, _mm512_loadu_si512, _mm512_stream_si512, dst, src, size);
+}
+
+
+static const copy_impl_t copy_impls[] = {
+  { "avx512", copy_avx512_temporal, copy_avx512_streaming },
+  { "avx2", copy_avx2_temporal, copy_avx2_streaming },
+  { "sse2", copy_sse2_temporal, copy_sse2_streaming },
+};
+
+
+static const copy_impl_t* copy_detect(void)
+{
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f"))
+    return &copy_impls[0];
+
+  if (__builtin_cpu_supports("avx2"))
+    return &copy_impls[1];
+
+  if (__builtin_cpu_supports("sse2"))
+    return &copy_impls[2];
+
+  return NULL;
+}
+
+#elif defined(RI_COPY_NEON)
+
+static void copy_neon_temporal(void *dst, const void *src, size_t size)
+{
+  size_t n = size / 16;
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+
+  for (size_t i = 0; i < n; i++, d += 16, s += 16)
+    vst1q_u8(d, vld1q_u8(s));
+
+  memcpy(d, s, size - n * 16);
+}
+
+
+static void copy_neon_streaming(void *dst, const void *src, size_t size)
+{
+  size_t head = copy_head(dst, 16, size);
+
+  memcpy(dst, src, head);
+
+  size_t n = (size - head) / 32;
+  uint8_t *d = (uint8_t*)dst + head;
+  const uint8_t *s = (const uint8_t*)src + head;
+
+  for (size_t i = 0; i < n; i++, d += 32, s += 32) {
+    uint8x16_t a = vld1q_u8(s);
+    uint8x16_t b = vld1q_u8(s + 16);
+
+    __asm__ volatile("stnp %q0, %q1, [%2]" : : "w"(a), "w"(b), "r"(d) : "memory");
+  }
+
+  memcpy(d, s, size - head - n * 32);
+
+  /* order the non-temporal stores before the publishing release store */
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+
+static const copy_impl_t copy_impls[] = {
+  { "neon", copy_neon_temporal, copy_neon_streaming },
+};
+
+
+static const copy_impl_t* copy_detect(void)
+{
+  return &copy_impls[0];
+}
+
+#else
+
+static const copy_impl_t* copy_detect(void)
+{
+  return NULL;
+}
+
+#endif
+
+
+static const copy_impl_t* copy_impl(void)
+{
+  static const copy_impl_t s_plain = { "plain", copy_plain, copy_plain };
+  static _Atomic(const copy_impl_t*) s_impl = NULL;
+
+  const copy_impl_t *impl = atomic_load_explicit(&s_impl, memory_order_relaxed);
+
+  if (impl)
+    return impl;
+
+  impl = copy_detect();
+
+  if (!impl)
+    impl = &s_plain;
+
+  atomic_store_explicit(&s_impl, impl, memory_order_relaxed);
+
+  LOG_INF("copy implementation=%s", impl->name);
+
+  return impl;
+}
+
+
+ri_copy_fn ri_copy_select(ri_copy_mode_t mode, size_t size)
+{
+  switch (mode) {
+    case RI_COPY_AUTO:
+      return size >= RI_COPY_STREAM_THRESHOLD ? copy_impl()->streaming : copy_plain;
+    case RI_COPY_PLAIN:
+      return copy_plain;
+    case RI_COPY_TEMPORAL:
+      return copy_impl()->temporal;
+    case RI_COPY_STREAMING:
+      return copy_impl()->streaming;
+    default:
+      return NULL;
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "rtipc/rtipc.h"
+
+/* messages of at least this size are written back with streaming stores
+ * in RI_COPY_AUTO mode */
+#ifndef RI_COPY_STREAM_THRESHOLD
+#define RI_COPY_STREAM_THRESHOLD (64 * 1024)
+#endif
+
+typedef void (*ri_copy_fn)(void *dst, const void *src, size_t size);
+
+/**
+ * Selects the copy function for messages of @p size bytes.
+ * The SIMD variant is chosen at runtime based on the CPU features.
+ *
+ * The streaming variants are followed by a store fence, so the data is
+ * visible before a subsequent release store publishes the message.
+ *
+ * @return NULL if @p mode is invalid
+ */
+ri_copy_fn ri_copy_select(ri_copy_mode_t mode, size_t size);
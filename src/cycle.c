@@ -0,0 +1,347 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/timerfd.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+#include "alloc.h"
+#include "clock.h"
+
+struct ri_cycle {
+  ri_consumer_t **consumers;
+  ri_producer_t **producers;
+  /* flush results of the current cycle, publish marks of the producers */
+  bool *updated;
+  bool *publish;
+  unsigned n_consumers;
+  unsigned n_producers;
+  int timerfd;
+  uint64_t period;
+  bool started;
+  /* release time of the first period and number of the current period */
+  uint64_t start;
+  uint64_t number;
+  ri_cycle_stats_t stats;
+  /* allocated by ri_cycle_new, not placed in caller-provided storage */
+  bool owned;
+};
+
+
+static void stats_reset(ri_cycle_stats_t *stats)
+{
+  *stats = (ri_cycle_stats_t) {
+    .latency_min = UINT64_MAX,
+  };
+}
+
+
+static size_t cycle_size(unsigned n_consumers, unsigned n_producers)
+{
+  unsigned n_channels = n_consumers + n_producers;
+
+  /* the channel pointers and their flags follow the cycle */
+  return sizeof(ri_cycle_t) + n_channels * (sizeof(void*) + sizeof(bool));
+}
+
+
+static ri_cycle_t* cycle_new(uint64_t period_ns, ri_consumer_t *consumers[], unsigned n_consumers,
+                             ri_producer_t *producers[], unsigned n_producers,
+                             void *storage, size_t storage_size)
+{
+  if ((period_ns == 0) || (n_consumers && !consumers) || (n_producers && !producers))
+    goto fail_args;
+
+  unsigned n_channels = n_consumers + n_producers;
+  size_t size = cycle_size(n_consumers, n_producers);
+
+  ri_cycle_t *cycle = storage ? ri_storage_place(storage, storage_size, size) : ri_alloc(size);
+  if (!cycle) {
+    if (storage)
+      LOG_ERR("cycle storage too small %zu < %zu", storage_size, ri_storage_size(size));
+    goto fail_alloc;
+  }
+
+  *cycle = (ri_cycle_t) {
+    .n_consumers = n_consumers,
+    .n_producers = n_producers,
+    .period = period_ns,
+    .owned = !storage,
+  };
+
+  stats_reset(&cycle->stats);
+
+  void **channels = (void**)&cycle[1];
+
+  cycle->consumers = (ri_consumer_t**)&channels[0];
+  cycle->producers = (ri_producer_t**)&channels[n_consumers];
+  cycle->updated = (bool*)&channels[n_channels];
+  cycle->publish = &cycle->updated[n_consumers];
+
+  for (unsigned i = 0; i < n_consumers; i++) {
+    if (!consumers[i])
+      goto fail_channel;
+
+    cycle->consumers[i] = consumers[i];
+    cycle->updated[i] = false;
+  }
+
+  for (unsigned i = 0; i < n_producers; i++) {
+    if (!producers[i])
+      goto fail_channel;
+
+    cycle->producers[i] = producers[i];
+    cycle->publish[i] = false;
+  }
+
+  cycle->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (cycle->timerfd < 0) {
+    LOG_ERR("timerfd_create failed errno=%d", errno);
+    goto fail_channel;
+  }
+
+  return cycle;
+
+fail_channel:
+  if (!storage)
+    ri_free(cycle);
+fail_alloc:
+fail_args:
+  return NULL;
+}
+
+
+ri_cycle_t* ri_cycle_new(uint64_t period_ns, ri_consumer_t *consumers[], unsigned n_consumers,
+                         ri_producer_t *producers[], unsigned n_producers)
+{
+  return cycle_new(period_ns, consumers, n_consumers, producers, n_producers, NULL, 0);
+}
+
+
+size_t ri_cycle_storage_size(unsigned n_consumers, unsigned n_producers)
+{
+  return ri_storage_size(cycle_size(n_consumers, n_producers));
+}
+
+
+ri_cycle_t* ri_cycle_init(uint64_t period_ns, ri_consumer_t *consumers[], unsigned n_consumers,
+                          ri_producer_t *producers[], unsigned n_producers, void *storage, size_t size)
+{
+  if (!storage)
+    return NULL;
+
+  return cycle_new(period_ns, consumers, n_consumers, producers, n_producers, storage, size);
+}
+
+
+void ri_cycle_delete(ri_cycle_t *cycle)
+{
+  close(cycle->timerfd);
+
+  if (cycle->owned)
+    ri_free(cycle);
+}
+
+
+int ri_cycle_fd(const ri_cycle_t *cycle)
+{
+  return cycle->timerfd;
+}
+
+
+static struct timespec to_timespec(uint64_t ns)
+{
+  return (struct timespec) {
+    .tv_sec = ns / 1000000000u,
+    .tv_nsec = ns % 1000000000u,
+  };
+}
+
+
+int ri_cycle_start(ri_cycle_t *cycle)
+{
+  /* the clock of ri_clock_ns, so release times can be compared with it */
+  uint64_t start = ri_clock_ns() + cycle->period;
+
+  struct itimerspec spec = {
+    .it_value = to_timespec(start),
+    .it_interval = to_timespec(cycle->period),
+  };
+
+  if (timerfd_settime(cycle->timerfd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+    int r = -errno;
+    LOG_ERR("timerfd_settime failed errno=%d", -r);
+    return r;
+  }
+
+  cycle->start = start;
+  cycle->number = 0;
+  cycle->started = true;
+
+  return 0;
+}
+
+
+/* waits for the next period, returns the number of periods that passed */
+static int64_t cycle_wait(ri_cycle_t *cycle)
+{
+  uint64_t expirations;
+
+  ssize_t r = read(cycle->timerfd, &expirations, sizeof(expirations));
+  if (r < 0)
+    return -errno;
+
+  if (r != sizeof(expirations))
+    return -EIO;
+
+  return expirations;
+}
+
+
+static int cycle_flush(ri_cycle_t *cycle)
+{
+  for (unsigned i = 0; i < cycle->n_consumers; i++) {
+    const void *msg = ri_consumer_msg(cycle->consumers[i]);
+
+    ri_pop_result_t result = ri_consumer_flush(cycle->consumers[i]);
+
+    if (result == RI_POP_RESULT_ERROR)
+      return -EIO;
+
+    /* a flush keeping the current message still reports it, but a new
+     * message never lands in the slot the consumer holds */
+    cycle->updated[i] = (result > RI_POP_RESULT_NO_UPDATE) && (ri_consumer_msg(cycle->consumers[i]) != msg);
+  }
+
+  return 0;
+}
+
+
+static int cycle_publish(ri_cycle_t *cycle)
+{
+  int r = 0;
+
+  for (unsigned i = 0; i < cycle->n_producers; i++) {
+    if (!cycle->publish[i])
+      continue;
+
+    cycle->publish[i] = false;
+
+    if (ri_producer_force_push(cycle->producers[i]) == RI_FORCE_PUSH_RESULT_ERROR)
+      r = -EIO;
+  }
+
+  return r;
+}
+
+
+int ri_cycle_step(ri_cycle_t *cycle, ri_cycle_fn fn, void *arg)
+{
+  if (!cycle->started) {
+    int r = ri_cycle_start(cycle);
+    if (r < 0)
+      return r;
+  }
+
+  int64_t periods = cycle_wait(cycle);
+  if (periods < 0)
+    return periods;
+
+  uint64_t wakeup = ri_clock_ns();
+
+  /* the first expiration releases period 0 */
+  cycle->number += periods;
+
+  uint64_t number = cycle->number - 1;
+  uint64_t release = cycle->start + number * cycle->period;
+  uint64_t latency = wakeup > release ? wakeup - release : 0;
+
+  int r = cycle_flush(cycle);
+  if (r < 0)
+    return r;
+
+  if (fn)
+    r = fn(arg, number);
+
+  int r_publish = cycle_publish(cycle);
+
+  uint64_t end = ri_clock_ns();
+  uint64_t exec = end - wakeup;
+
+  ri_cycle_stats_t *stats = &cycle->stats;
+
+  stats->cycles++;
+  stats->missed += periods - 1;
+
+  if (end > release + cycle->period)
+    stats->overruns++;
+
+  stats->latency_sum += latency;
+
+  if (latency < stats->latency_min)
+    stats->latency_min = latency;
+
+  if (latency > stats->latency_max)
+    stats->latency_max = latency;
+
+  stats->exec_sum += exec;
+
+  if (exec > stats->exec_max)
+    stats->exec_max = exec;
+
+  return r_publish < 0 ? r_publish : r;
+}
+
+
+int ri_cycle_run(ri_cycle_t *cycle, ri_cycle_fn fn, void *arg, uint64_t n_cycles)
+{
+  for (uint64_t i = 0; (n_cycles == 0) || (i < n_cycles); i++) {
+    int r = ri_cycle_step(cycle, fn, arg);
+
+    if (r < 0)
+      return r;
+
+    if (r > 0)
+      break;
+  }
+
+  return 0;
+}
+
+
+bool ri_cycle_updated(const ri_cycle_t *cycle, unsigned index)
+{
+  if (index >= cycle->n_consumers)
+    return false;
+
+  return cycle->updated[index];
+}
+
+
+int ri_cycle_publish(ri_cycle_t *cycle, unsigned index)
+{
+  if (index >= cycle->n_producers)
+    return -EINVAL;
+
+  cycle->publish[index] = true;
+
+  return 0;
+}
+
+
+void ri_cycle_stats(const ri_cycle_t *cycle, ri_cycle_stats_t *stats)
+{
+  *stats = cycle->stats;
+
+  if (stats->cycles == 0)
+    stats->latency_min = 0;
+}
+
+
+void ri_cycle_stats_reset(ri_cycle_t *cycle)
+{
+  stats_reset(&cycle->stats);
+}
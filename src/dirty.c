@@ -0,0 +1,219 @@
+#include "dirty.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "rtipc/log.h"
+#include "channel.h"
+#include "mem_utils.h"
+
+
+static size_t record_size(const ri_attr_t *attr)
+{
+  /* records of different slots are accessed by different processes */
+  return cacheline_aligned(sizeof(ri_dirty_record_t) + ri_dirty_n_words(attr) * sizeof(uint64_t));
+}
+
+
+static ri_dirty_record_t* record_get(const void *records, size_t size, ri_index_t slot)
+{
+  return (ri_dirty_record_t*)cmem_offset(records, slot * size);
+}
+
+
+int ri_dirty_attr_validate(const ri_attr_t *attr)
+{
+  unsigned block = attr->dirty_block;
+
+  if ((block & (block - 1)) != 0) {
+    LOG_ERR("dirty_block=%u is not a power of two", block);
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+
+size_t ri_dirty_shm_size(const ri_attr_t *attr)
+{
+  if (attr->dirty_block == 0)
+    return 0;
+
+  return ri_channel_queue_len(attr) * record_size(attr);
+}
+
+
+size_t ri_dirty_producer_size(const ri_attr_t *attr)
+{
+  return (ri_dirty_n_blocks(attr) + ri_channel_queue_len(attr) + ri_dirty_n_words(attr)) * sizeof(uint64_t);
+}
+
+
+size_t ri_dirty_consumer_size(const ri_attr_t *attr)
+{
+  return 2 * ri_dirty_n_words(attr) * sizeof(uint64_t);
+}
+
+
+static void bitmap_fill(uint64_t *bitmap, unsigned n_bits)
+{
+  unsigned n_words = (n_bits + 63) / 64;
+
+  memset(bitmap, 0xff, n_words * sizeof(uint64_t));
+
+  if (n_bits % 64)
+    bitmap[n_words - 1] = (UINT64_C(1) << (n_bits % 64)) - 1;
+}
+
+
+void ri_dirty_producer_init(ri_dirty_producer_t *dirty, const ri_attr_t *attr,
+                            void *records, void *local)
+{
+  unsigned n_blocks = ri_dirty_n_blocks(attr);
+
+  *dirty = (ri_dirty_producer_t) {
+    .records = records,
+    .record_size = record_size(attr),
+    .block_size = attr->dirty_block,
+    .n_blocks = n_blocks,
+    .n_words = ri_dirty_n_words(attr),
+    .n_msgs = ri_channel_queue_len(attr),
+    .seq = 1,
+  };
+
+  if (n_blocks == 0)
+    return;
+
+  dirty->block_seq = local;
+  dirty->slot_seq = &dirty->block_seq[n_blocks];
+  dirty->pending = &dirty->slot_seq[dirty->n_msgs];
+
+  ri_dirty_reset(dirty);
+}
+
+
+void ri_dirty_consumer_init(ri_dirty_consumer_t *dirty, const ri_attr_t *attr,
+                            const void *records, void *local)
+{
+  unsigned n_blocks = ri_dirty_n_blocks(attr);
+
+  *dirty = (ri_dirty_consumer_t) {
+    .records = records,
+    .record_size = record_size(attr),
+    .block_size = attr->dirty_block,
+    .n_blocks = n_blocks,
+    .all = local,
+  };
+
+  if (n_blocks == 0)
+    return;
+
+  dirty->detached = &dirty->all[ri_dirty_n_words(attr)];
+
+  bitmap_fill(dirty->all, n_blocks);
+}
+
+
+void ri_dirty_mark(ri_dirty_producer_t *dirty, size_t offset, size_t size)
+{
+  size_t first = offset / dirty->block_size;
+  size_t last = (offset + size - 1) / dirty->block_size;
+
+  for (size_t b = first; b <= last; b++) {
+    dirty->block_seq[b] = dirty->seq;
+    dirty->pending[b / 64] |= UINT64_C(1) << (b % 64);
+  }
+}
+
+
+void ri_dirty_reset(ri_dirty_producer_t *dirty)
+{
+  for (unsigned b = 0; b < dirty->n_blocks; b++)
+    dirty->block_seq[b] = dirty->seq;
+
+  memset(dirty->slot_seq, 0, dirty->n_msgs * sizeof(uint64_t));
+
+  bitmap_fill(dirty->pending, dirty->n_blocks);
+}
+
+
+static void publish(ri_dirty_producer_t *dirty, ri_index_t slot, const uint64_t *bitmap)
+{
+  ri_dirty_record_t *record = record_get(dirty->records, dirty->record_size, slot);
+
+  record->seq = dirty->seq;
+  memcpy(record->bitmap, bitmap, dirty->n_words * sizeof(uint64_t));
+
+  dirty->seq++;
+}
+
+
+void ri_dirty_write_back(ri_dirty_producer_t *dirty, ri_index_t slot,
+                         void *dst, const void *src, size_t msg_size, ri_copy_fn copy)
+{
+  uint64_t slot_seq = dirty->slot_seq[slot];
+  size_t block_size = dirty->block_size;
+  unsigned b = 0;
+
+  /* copy runs of blocks changed after the slot was last written */
+  while (b < dirty->n_blocks) {
+    if (dirty->block_seq[b] <= slot_seq) {
+      b++;
+      continue;
+    }
+
+    unsigned first = b;
+
+    while ((b < dirty->n_blocks) && (dirty->block_seq[b] > slot_seq))
+      b++;
+
+    size_t offset = first * block_size;
+    size_t end = b * block_size;
+
+    if (end > msg_size)
+      end = msg_size;
+
+    copy(mem_offset(dst, offset), cmem_offset(src, offset), end - offset);
+  }
+
+  dirty->slot_seq[slot] = dirty->seq;
+
+  publish(dirty, slot, dirty->pending);
+
+  memset(dirty->pending, 0, dirty->n_words * sizeof(uint64_t));
+}
+
+
+void ri_dirty_write_all(ri_dirty_producer_t *dirty, ri_index_t slot)
+{
+  /* the slot content is unknown to the cache from now on */
+  dirty->slot_seq[slot] = 0;
+
+  bitmap_fill(dirty->pending, dirty->n_blocks);
+
+  publish(dirty, slot, dirty->pending);
+}
+
+
+void ri_dirty_consume(ri_dirty_consumer_t *dirty, ri_index_t slot)
+{
+  const ri_dirty_record_t *record = record_get(dirty->records, dirty->record_size, slot);
+  uint64_t seq = record->seq;
+
+  if ((dirty->seq != 0) && (seq == dirty->seq + 1))
+    dirty->bitmap = record->bitmap;
+  else
+    dirty->bitmap = dirty->all;
+
+  dirty->seq = seq;
+}
+
+
+void ri_dirty_detach(ri_dirty_consumer_t *dirty)
+{
+  if (!dirty->bitmap || (dirty->bitmap == dirty->all) || (dirty->bitmap == dirty->detached))
+    return;
+
+  memcpy(dirty->detached, dirty->bitmap, ((dirty->n_blocks + 63) / 64) * sizeof(uint64_t));
+  dirty->bitmap = dirty->detached;
+}
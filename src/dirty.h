@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtipc/rtipc.h"
+#include "copy.h"
+#include "index.h"
+
+/**
+ * Dirty block tracking for channels with ri_attr_t.dirty_block set.
+ *
+ * Every message slot has a record in shared memory holding the sequence
+ * number of the push that published it and a bitmap of the blocks that
+ * changed compared to the previous push. A consumer that popped every
+ * message sees consecutive sequence numbers and can trust the bitmap,
+ * otherwise all blocks are reported as changed.
+ *
+ * The producer remembers in which push each block was last changed and
+ * which push last wrote each slot, so writing back the cache only copies
+ * the blocks the slot is missing.
+ */
+
+typedef struct ri_dirty_record {
+  uint64_t seq;
+  uint64_t bitmap[];
+} ri_dirty_record_t;
+
+
+typedef struct ri_dirty_producer {
+  void *records;
+  size_t record_size;
+  size_t block_size;
+  unsigned n_blocks;
+  unsigned n_words;
+  unsigned n_msgs;
+  /* sequence number of the next push, starts at 1 */
+  uint64_t seq;
+  /* push in which each block was last marked */
+  uint64_t *block_seq;
+  /* push which last wrote each slot from the cache */
+  uint64_t *slot_seq;
+  /* blocks marked since the last push */
+  uint64_t *pending;
+} ri_dirty_producer_t;
+
+
+typedef struct ri_dirty_consumer {
+  const void *records;
+  size_t record_size;
+  size_t block_size;
+  unsigned n_blocks;
+  /* sequence number of the last popped message, 0 if none */
+  uint64_t seq;
+  /* all blocks set, reported when messages were skipped */
+  uint64_t *all;
+  /* bitmap of a released slot, the record may be reused by the producer */
+  uint64_t *detached;
+  const uint64_t *bitmap;
+} ri_dirty_consumer_t;
+
+
+static inline unsigned ri_dirty_n_blocks(const ri_attr_t *attr)
+{
+  if (attr->dirty_block == 0)
+    return 0;
+
+  return (attr->msg_size + attr->dirty_block - 1) / attr->dirty_block;
+}
+
+static inline unsigned ri_dirty_n_words(const ri_attr_t *attr)
+{
+  return (ri_dirty_n_blocks(attr) + 63) / 64;
+}
+
+int ri_dirty_attr_validate(const ri_attr_t *attr);
+
+/* size of the records of all slots in shared memory, 0 without tracking */
+size_t ri_dirty_shm_size(const ri_attr_t *attr);
+
+/* local memory needed by the producer and consumer side */
+size_t ri_dirty_producer_size(const ri_attr_t *attr);
+
+size_t ri_dirty_consumer_size(const ri_attr_t *attr);
+
+void ri_dirty_producer_init(ri_dirty_producer_t *dirty, const ri_attr_t *attr,
+                            void *records, void *local);
+
+void ri_dirty_consumer_init(ri_dirty_consumer_t *dirty, const ri_attr_t *attr,
+                            const void *records, void *local);
+
+static inline bool ri_dirty_enabled(const ri_dirty_producer_t *dirty)
+{
+  return dirty->n_blocks > 0;
+}
+
+void ri_dirty_mark(ri_dirty_producer_t *dirty, size_t offset, size_t size);
+
+/* invalidates all slots, used when the cache gets enabled */
+void ri_dirty_reset(ri_dirty_producer_t *dirty);
+
+/* copies the blocks slot is missing from src to dst and publishes the record */
+void ri_dirty_write_back(ri_dirty_producer_t *dirty, ri_index_t slot,
+                         void *dst, const void *src, size_t msg_size, ri_copy_fn copy);
+
+/* publishes a record with all blocks set, the slot was written directly */
+void ri_dirty_write_all(ri_dirty_producer_t *dirty, ri_index_t slot);
+
+/* updates the bitmap after the consumer popped slot */
+void ri_dirty_consume(ri_dirty_consumer_t *dirty, ri_index_t slot);
+
+/* copies the bitmap out of shared memory before the slot is released */
+void ri_dirty_detach(ri_dirty_consumer_t *dirty);
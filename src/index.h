@@ -16,9 +16,12 @@ typedef atomic_uint ri_atomic_index_t;
 
 #define RI_FIRST_FLAG ((ri_index_t)(RI_CONSUMED_FLAG >> 1))
 
+/* set by the consumer on a consumed tail it doesn't use anymore */
+#define RI_RELEASED_FLAG ((ri_index_t)(RI_FIRST_FLAG >> 1))
+
 #define RI_ORIGIN_MASK RI_CONSUMED_FLAG
 
-#define RI_INDEX_MASK (~(RI_ORIGIN_MASK | RI_FIRST_FLAG))
+#define RI_INDEX_MASK (~(RI_ORIGIN_MASK | RI_FIRST_FLAG | RI_RELEASED_FLAG))
 
 #else
 
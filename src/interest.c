@@ -0,0 +1,41 @@
+#include "interest.h"
+
+#include "clock.h"
+
+
+void ri_interest_init_shm(ri_interest_t *word)
+{
+  atomic_store_explicit(&word->mask, UINT64_MAX, memory_order_relaxed);
+  atomic_store_explicit(&word->interval, 0, memory_order_relaxed);
+}
+
+
+void ri_interest_set(ri_interest_t *word, uint64_t mask, uint64_t interval)
+{
+  atomic_store_explicit(&word->mask, mask, memory_order_relaxed);
+  atomic_store_explicit(&word->interval, interval, memory_order_relaxed);
+}
+
+
+bool ri_interest_grant(ri_interest_producer_t *interest, unsigned type)
+{
+  uint64_t mask = atomic_load_explicit(&interest->word->mask, memory_order_relaxed);
+
+  if ((type >= 64) || !(mask & (UINT64_C(1) << type)))
+    return false;
+
+  uint64_t interval = atomic_load_explicit(&interest->word->interval, memory_order_relaxed);
+
+  /* no clock read for consumers without rate cap */
+  if (interval == 0)
+    return true;
+
+  uint64_t now = ri_clock_ns();
+
+  if (now - interest->last < interval)
+    return false;
+
+  interest->last = now;
+
+  return true;
+}
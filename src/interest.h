@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtipc/rtipc.h"
+#include "mem_utils.h"
+
+/**
+ * Interest word of a channel with ri_attr_t.interest set.
+ *
+ * Written by the consumer only, read by the producer before it prepares
+ * a message. Both values are independent, a producer may see a new mask
+ * together with the old interval for a moment, which is harmless.
+ */
+typedef struct ri_interest {
+  /* bit t set: messages of type t are wanted */
+  _Atomic uint64_t mask;
+  /* minimum distance between two messages in nanoseconds, 0 = no cap */
+  _Atomic uint64_t interval;
+} ri_interest_t;
+
+
+typedef struct ri_interest_producer {
+  ri_interest_t *word;
+  /* time of the last granted push */
+  uint64_t last;
+} ri_interest_producer_t;
+
+
+/* size of the interest word in shared memory, 0 if disabled */
+static inline size_t ri_interest_shm_size(const ri_attr_t *attr)
+{
+  /* written by the consumer, keep it off the producer's cachelines */
+  return attr->interest ? cacheline_aligned(sizeof(ri_interest_t)) : 0;
+}
+
+
+/* everything is wanted until the consumer publishes its interest */
+void ri_interest_init_shm(ri_interest_t *word);
+
+void ri_interest_set(ri_interest_t *word, uint64_t mask, uint64_t interval);
+
+bool ri_interest_grant(ri_interest_producer_t *interest, unsigned type);
@@ -0,0 +1,46 @@
+#include "lane.h"
+
+#include <errno.h>
+
+#include "rtipc/log.h"
+#include "channel.h"
+#include "index.h"
+
+
+int ri_lane_attr_validate(const ri_attr_t *attr)
+{
+  if (attr->lanes > RI_MAX_LANES) {
+    LOG_ERR("lanes=%u exceeds %u", attr->lanes, RI_MAX_LANES);
+    return -EINVAL;
+  }
+
+  if (ri_lane_count(attr) == 1)
+    return 0;
+
+  if (attr->dirty_block || attr->max_leases || attr->relay || attr->blob_size || attr->watermark) {
+    LOG_ERR("priority lanes don't support dirty tracking, leases, relay, blobs and watermarks");
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+
+size_t ri_lane_shm_size(const ri_attr_t *attr)
+{
+  return (ri_lane_count(attr) - 1) * ri_channel_shm_size(attr);
+}
+
+
+void ri_lane_layout(const ri_attr_t *attr, const ri_channel_layout_t *layout, unsigned lane,
+                    ri_channel_layout_t *lane_layout)
+{
+  size_t offset = layout->lanes + (lane - 1) * ri_channel_shm_size(attr);
+
+  *lane_layout = *layout;
+
+  lane_layout->tail = offset;
+  lane_layout->head = offset + sizeof(ri_atomic_index_t);
+  lane_layout->chain = offset + 2 * sizeof(ri_atomic_index_t);
+  lane_layout->msgs = offset + ri_channel_queue_size(attr);
+}
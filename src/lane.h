@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "rtipc/rtipc.h"
+#include "layout.h"
+
+/**
+ * Priority lanes of a channel with ri_attr_t.lanes > 1.
+ *
+ * Lane 0 is the channel's regular queue. Every further lane is a complete
+ * queue (tail, head, chain and slots) with the attributes of the channel,
+ * the queues are stored back to back in the lane region of the channel.
+ * A force push only overruns slots of its own lane, so a lower lane never
+ * discards messages of a higher one. The per-slot regions (dirty records,
+ * leases, buffer offsets, blobs and message numbers) exist once per channel, the features
+ * using them are therefore not supported together with lanes.
+ */
+
+int ri_lane_attr_validate(const ri_attr_t *attr);
+
+
+/* a plain channel has a single lane */
+static inline unsigned ri_lane_count(const ri_attr_t *attr)
+{
+  return attr->lanes > 1 ? attr->lanes : 1;
+}
+
+
+/* size of the queues of the lanes above 0 */
+size_t ri_lane_shm_size(const ri_attr_t *attr);
+
+/* layout of a lane above 0, the channel's layout describes lane 0 */
+void ri_lane_layout(const ri_attr_t *attr, const ri_channel_layout_t *layout, unsigned lane,
+                    ri_channel_layout_t *lane_layout);
@@ -0,0 +1,212 @@
+#include "layout.h"
+
+#include <errno.h>
+
+#include "channel.h"
+#include "blob.h"
+#include "dirty.h"
+#include "index.h"
+#include "interest.h"
+#include "lane.h"
+#include "lease.h"
+#include "mem_utils.h"
+#include "watermark.h"
+
+
+/* optional regions of a channel: dirty records, lease words, buffer offsets, blob heap, lanes,
+ * interest word and watermark */
+static size_t extra_size(const ri_attr_t *attr)
+{
+  return ri_dirty_shm_size(attr) + ri_lease_shm_size(attr) + ri_channel_buffers_size(attr) +
+         ri_blob_shm_size(attr) + ri_lane_shm_size(attr) + ri_interest_shm_size(attr) +
+         ri_watermark_shm_size(attr);
+}
+
+
+static void extra_offsets(const ri_attr_t *attr, size_t offset, ri_channel_layout_t *layout)
+{
+  layout->dirty = offset;
+  layout->leases = layout->dirty + ri_dirty_shm_size(attr);
+  layout->buffers = layout->leases + ri_lease_shm_size(attr);
+  layout->blobs = layout->buffers + ri_channel_buffers_size(attr);
+  layout->lanes = layout->blobs + ri_blob_shm_size(attr);
+  layout->interest = layout->lanes + ri_lane_shm_size(attr);
+  layout->watermark = layout->interest + ri_interest_shm_size(attr);
+}
+
+
+static size_t layout_interleaved(const ri_attr_t attrs[], unsigned n, size_t offset, ri_channel_layout_t layouts[])
+{
+  for (unsigned i = 0; i < n; i++) {
+    const ri_attr_t *attr = &attrs[i];
+
+    if (layouts) {
+      layouts[i] = (ri_channel_layout_t) {
+        .tail = offset,
+        .head = offset + sizeof(ri_atomic_index_t),
+        .chain = offset + 2 * sizeof(ri_atomic_index_t),
+        .msgs = offset + ri_channel_queue_size(attr),
+      };
+
+      extra_offsets(attr, offset + ri_channel_shm_size(attr), &layouts[i]);
+    }
+
+    offset += ri_channel_shm_size(attr) + extra_size(attr);
+  }
+
+  return offset;
+}
+
+
+/* unpadded on purpose, one load covers the heads of several channels for
+ * ri_vector_poll_ready at the cost of false sharing between producers,
+ * see RI_LAYOUT_SPLIT */
+static size_t layout_heads(unsigned n, size_t offset, ri_channel_layout_t layouts[])
+{
+  if (layouts) {
+    for (unsigned i = 0; i < n; i++)
+      layouts[i].head = offset + i * sizeof(ri_atomic_index_t);
+  }
+
+  return offset + cacheline_aligned(n * sizeof(ri_atomic_index_t));
+}
+
+
+static size_t layout_control(const ri_attr_t attrs[], unsigned n, size_t offset, ri_channel_layout_t layouts[])
+{
+  for (unsigned i = 0; i < n; i++) {
+    /* tail + chain */
+    unsigned n_indices = ri_channel_queue_len(&attrs[i]) + 1;
+
+    if (layouts) {
+      layouts[i].tail = offset;
+      layouts[i].chain = offset + sizeof(ri_atomic_index_t);
+    }
+
+    offset += cacheline_aligned(n_indices * sizeof(ri_atomic_index_t));
+  }
+
+  return offset;
+}
+
+
+static size_t layout_extra(const ri_attr_t attrs[], unsigned n, size_t offset, ri_channel_layout_t layouts[])
+{
+  for (unsigned i = 0; i < n; i++) {
+    if (layouts)
+      extra_offsets(&attrs[i], offset, &layouts[i]);
+
+    offset += extra_size(&attrs[i]);
+  }
+
+  return offset;
+}
+
+
+static size_t layout_payload(const ri_attr_t attrs[], unsigned n, size_t offset, ri_channel_layout_t layouts[])
+{
+  for (unsigned i = 0; i < n; i++) {
+    const ri_attr_t *attr = &attrs[i];
+
+    if (layouts)
+      layouts[i].msgs = offset;
+
+    offset += ri_channel_data_size(attr);
+  }
+
+  return offset;
+}
+
+
+/* All head indices of one direction are packed into a single array,
+ * so a consumer can check many channels for new messages with a few cache misses.
+ * The two directions are written by different processes and therefore
+ * start on separate cachelines. The payload follows the control region,
+ * the optional regions (dirty records, lease words, buffer offsets, blob heap, lanes,
+ * interest word, watermark) come last. */
+static size_t layout_split(const ri_attr_t first[], unsigned n_first,
+                           const ri_attr_t second[], unsigned n_second,
+                           ri_channel_layout_t first_layouts[],
+                           ri_channel_layout_t second_layouts[])
+{
+  size_t offset = 0;
+
+  offset = layout_heads(n_first, offset, first_layouts);
+  offset = layout_heads(n_second, offset, second_layouts);
+
+  offset = layout_control(first, n_first, offset, first_layouts);
+  offset = layout_control(second, n_second, offset, second_layouts);
+
+  offset = layout_payload(first, n_first, offset, first_layouts);
+  offset = layout_payload(second, n_second, offset, second_layouts);
+
+  offset = layout_extra(first, n_first, offset, first_layouts);
+  offset = layout_extra(second, n_second, offset, second_layouts);
+
+  return offset;
+}
+
+
+int ri_layout_validate(ri_layout_t layout)
+{
+  switch (layout) {
+    case RI_LAYOUT_INTERLEAVED:
+    case RI_LAYOUT_SPLIT:
+      return 0;
+    default:
+      return -EINVAL;
+  }
+}
+
+
+size_t ri_layout_calc(ri_layout_t layout,
+                      const ri_attr_t first[],
+                      const ri_attr_t second[],
+                      ri_channel_layout_t first_layouts[],
+                      ri_channel_layout_t second_layouts[])
+{
+  unsigned n_first = ri_count_channels(first);
+  unsigned n_second = ri_count_channels(second);
+
+  switch (layout) {
+    case RI_LAYOUT_INTERLEAVED: {
+      size_t offset = layout_interleaved(first, n_first, 0, first_layouts);
+      return layout_interleaved(second, n_second, offset, second_layouts);
+    }
+    case RI_LAYOUT_SPLIT:
+      return layout_split(first, n_first, second, n_second, first_layouts, second_layouts);
+    default:
+      return 0;
+  }
+}
+
+
+void ri_layout_describe(const ri_attr_t *attr, const ri_channel_layout_t *layout,
+                        ri_channel_layout_info_t *info)
+{
+  unsigned n_msgs = ri_channel_queue_len(attr);
+  size_t payload_size = ri_channel_data_size(attr);
+  size_t blob_size = ri_blob_shm_size(attr);
+  size_t lanes_size = ri_lane_shm_size(attr);
+  unsigned n_lanes = ri_lane_count(attr);
+
+  *info = (ri_channel_layout_info_t) {
+    .tail_offset = layout->tail,
+    .head_offset = layout->head,
+    .chain_offset = layout->chain,
+    /* tail + head + chain of every lane + optional regions except the blob heap and lanes */
+    .control_size = n_lanes * (n_msgs + 2) * sizeof(ri_atomic_index_t) + extra_size(attr) -
+                    blob_size - lanes_size,
+    .msgs_offset = layout->msgs,
+    .msg_size = attr->msg_size,
+    .msg_stride = ri_channel_msg_stride(attr),
+    .n_msgs = n_msgs,
+    .payload_size = payload_size,
+    .padding = payload_size - n_msgs * attr->msg_size,
+    .blob_offset = layout->blobs,
+    .blob_size = blob_size,
+    .n_lanes = n_lanes,
+    .lanes_offset = layout->lanes,
+    .lanes_size = lanes_size,
+  };
+}
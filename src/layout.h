@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "rtipc/rtipc.h"
+
+
+/**
+ * Offsets of the shared memory regions of a single channel,
+ * relative to the start of the shared memory.
+ */
+typedef struct ri_channel_layout {
+  size_t tail;
+  size_t head;
+  size_t chain;
+  size_t msgs;
+  size_t dirty;
+  size_t leases;
+  size_t buffers;
+  size_t blobs;
+  size_t lanes;
+  size_t interest;
+  size_t watermark;
+} ri_channel_layout_t;
+
+
+/**
+ * Checks that @p layout is a known layout.
+ *
+ * @return 0 if it is, -EINVAL otherwise
+ */
+int ri_layout_validate(ri_layout_t layout);
+
+
+/**
+ * Calculates the shared memory layout of all channels of a vector.
+ *
+ * @p first are the channels produced by the client (client producers /
+ * server consumers), @p second the channels produced by the server.
+ * Both sides must call this with the same arguments to get the same offsets.
+ * @p first_layouts and @p second_layouts may be NULL.
+ *
+ * @return the total size of the shared memory
+ */
+size_t ri_layout_calc(ri_layout_t layout,
+                      const ri_attr_t first[],
+                      const ri_attr_t second[],
+                      ri_channel_layout_t first_layouts[],
+                      ri_channel_layout_t second_layouts[]);
+
+
+/**
+ * Fills the static part of the public channel description,
+ * everything except the residency.
+ */
+void ri_layout_describe(const ri_attr_t *attr, const ri_channel_layout_t *layout,
+                        ri_channel_layout_info_t *info);
@@ -0,0 +1,129 @@
+#include "lease.h"
+
+#include <errno.h>
+#include <stdbool.h>
+
+#include "mem_utils.h"
+
+
+size_t ri_lease_shm_size(const ri_attr_t *attr)
+{
+  /* written by the consumer only */
+  return cacheline_aligned(attr->max_leases * sizeof(ri_atomic_index_t));
+}
+
+
+size_t ri_lease_local_size(const ri_attr_t *attr)
+{
+  return attr->max_leases * sizeof(ri_index_t);
+}
+
+
+void ri_lease_init_shm(ri_atomic_index_t *words, unsigned n_leases)
+{
+  for (unsigned i = 0; i < n_leases; i++)
+    atomic_store(&words[i], RI_INDEX_INVALID);
+}
+
+
+void ri_lease_producer_init(ri_lease_producer_t *lease, ri_atomic_index_t *words,
+                            unsigned n_leases, unsigned ring_len, ri_index_t *local)
+{
+  *lease = (ri_lease_producer_t) {
+    .words = words,
+    .n_leases = n_leases,
+    .spares = local,
+    .n_spares = n_leases,
+  };
+
+  for (unsigned i = 0; i < lease->n_spares; i++)
+    lease->spares[i] = ring_len + i;
+}
+
+
+void ri_lease_consumer_init(ri_lease_consumer_t *lease, ri_atomic_index_t *words,
+                            unsigned n_leases, ri_index_t *local)
+{
+  *lease = (ri_lease_consumer_t) {
+    .words = words,
+    .n_leases = n_leases,
+    .slots = local,
+  };
+
+  for (unsigned i = 0; i < lease->n_leases; i++)
+    lease->slots[i] = RI_INDEX_INVALID;
+}
+
+
+ri_index_t ri_lease_swap(ri_lease_producer_t *lease, ri_index_t slot)
+{
+  bool leased = false;
+
+  for (unsigned i = 0; i < lease->n_leases; i++) {
+    ri_index_t word = atomic_load(&lease->words[i]);
+
+    if (word == RI_INDEX_INVALID)
+      continue;
+
+    if (word & RI_LEASE_RETURNED) {
+      lease->spares[lease->n_spares++] = word & RI_INDEX_MASK;
+      atomic_store(&lease->words[i], RI_INDEX_INVALID);
+    } else if (word == slot) {
+      /* fails if the consumer just released the lease, slot is free then */
+      leased = atomic_compare_exchange_strong(&lease->words[i], &word, slot | RI_LEASE_SWAPPED);
+    }
+  }
+
+  if (!leased)
+    return RI_INDEX_INVALID;
+
+  return lease->spares[--lease->n_spares];
+}
+
+
+int ri_lease_acquire(ri_lease_consumer_t *lease, ri_index_t slot)
+{
+  int id = -EBUSY;
+
+  for (unsigned i = 0; i < lease->n_leases; i++) {
+    if (lease->slots[i] == slot)
+      return -EALREADY;
+
+    /* a returned word is free again once the producer collected the slot */
+    if ((id < 0) && (lease->slots[i] == RI_INDEX_INVALID)
+        && (atomic_load(&lease->words[i]) == RI_INDEX_INVALID))
+      id = i;
+  }
+
+  if (id < 0)
+    return id;
+
+  lease->slots[id] = slot;
+
+  /* ordered before the consumer moves tail past slot, so the producer
+   * sees the lease before it can reuse the slot */
+  atomic_store(&lease->words[id], slot);
+
+  return id;
+}
+
+
+int ri_lease_release(ri_lease_consumer_t *lease, unsigned id)
+{
+  if ((id >= lease->n_leases) || (lease->slots[id] == RI_INDEX_INVALID))
+    return -EINVAL;
+
+  ri_index_t slot = lease->slots[id];
+  ri_index_t expected = slot;
+
+  lease->slots[id] = RI_INDEX_INVALID;
+
+  /* slot is still part of the ring */
+  if (atomic_compare_exchange_strong(&lease->words[id], &expected, RI_INDEX_INVALID))
+    return 0;
+
+  /* the producer swapped slot out, hand it back as a spare */
+  atomic_store(&lease->words[id], slot | RI_LEASE_RETURNED);
+
+  return 0;
+}
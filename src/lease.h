@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "rtipc/rtipc.h"
+#include "index.h"
+
+/**
+ * Consumer leases for channels with ri_attr_t.max_leases set.
+ *
+ * A leased slot stays readable by the consumer after it popped newer
+ * messages. The channel has max_leases spare slots outside the producer's
+ * ring. Every lease is a word in shared memory written by the consumer:
+ *
+ *   RI_INDEX_INVALID        free
+ *   slot                    leased, slot is still part of the ring
+ *   slot | SWAPPED          the producer replaced slot with a spare
+ *   slot | RETURNED         released after the swap, the producer takes
+ *                           slot as a new spare and frees the word
+ *
+ * Before the producer starts writing a slot, it swaps it out if leased.
+ * A swapped lease always has its spare, so the spares never run out.
+ */
+
+#define RI_LEASE_SWAPPED RI_CONSUMED_FLAG
+#define RI_LEASE_RETURNED RI_FIRST_FLAG
+
+typedef struct ri_lease_producer {
+  ri_atomic_index_t *words;
+  unsigned n_leases;
+  /* stack of slots outside the ring */
+  ri_index_t *spares;
+  unsigned n_spares;
+} ri_lease_producer_t;
+
+
+typedef struct ri_lease_consumer {
+  ri_atomic_index_t *words;
+  unsigned n_leases;
+  /* leased slot per lease, RI_INDEX_INVALID if unused */
+  ri_index_t *slots;
+} ri_lease_consumer_t;
+
+
+/* size of the lease words in shared memory, 0 without leases */
+size_t ri_lease_shm_size(const ri_attr_t *attr);
+
+/* local memory needed by either side */
+size_t ri_lease_local_size(const ri_attr_t *attr);
+
+void ri_lease_init_shm(ri_atomic_index_t *words, unsigned n_leases);
+
+/* the spares are the slots following the first ring_len slots */
+void ri_lease_producer_init(ri_lease_producer_t *lease, ri_atomic_index_t *words,
+                            unsigned n_leases, unsigned ring_len, ri_index_t *local);
+
+void ri_lease_consumer_init(ri_lease_consumer_t *lease, ri_atomic_index_t *words,
+                            unsigned n_leases, ri_index_t *local);
+
+/* collects returned slots and swaps slot out of the ring if it is leased.
+ * Returns the spare replacing slot or RI_INDEX_INVALID */
+ri_index_t ri_lease_swap(ri_lease_producer_t *lease, ri_index_t slot);
+
+/* returns the lease id, -EALREADY if slot is leased already,
+ * -EBUSY if no lease is available */
+int ri_lease_acquire(ri_lease_consumer_t *lease, ri_index_t slot);
+
+int ri_lease_release(ri_lease_consumer_t *lease, unsigned id);
+
+static inline ri_index_t ri_lease_slot(const ri_lease_consumer_t *lease, unsigned id)
+{
+  return id < lease->n_leases ? lease->slots[id] : RI_INDEX_INVALID;
+}
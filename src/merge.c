@@ -0,0 +1,237 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+#include "alloc.h"
+
+
+/* head message of a consumer, its slot is held until it was returned */
+typedef struct ri_merge_entry {
+  uint64_t ts;
+  const void *msg;
+  unsigned index;
+} ri_merge_entry_t;
+
+struct ri_merge {
+  size_t ts_offset;
+  uint64_t lateness;
+  unsigned n_consumers;
+  /* number of entries in the heap */
+  unsigned n_heap;
+  /* consumer of the message returned last, popped with the next call */
+  unsigned returned;
+  /* allocated by ri_merge_new, not placed in caller-provided storage */
+  bool owned;
+  ri_consumer_t **consumers;
+  /* consumer has an entry in the heap */
+  bool *queued;
+  /* binary min heap ordered by (ts, index) */
+  ri_merge_entry_t heap[];
+};
+
+
+static bool entry_less(const ri_merge_entry_t *a, const ri_merge_entry_t *b)
+{
+  if (a->ts != b->ts)
+    return a->ts < b->ts;
+
+  /* equal timestamps keep the order of the consumers */
+  return a->index < b->index;
+}
+
+
+static void heap_push(ri_merge_t *merge, ri_merge_entry_t entry)
+{
+  ri_merge_entry_t *heap = merge->heap;
+  unsigned i = merge->n_heap++;
+
+  while (i > 0) {
+    unsigned parent = (i - 1) / 2;
+
+    if (!entry_less(&entry, &heap[parent]))
+      break;
+
+    heap[i] = heap[parent];
+    i = parent;
+  }
+
+  heap[i] = entry;
+}
+
+
+static void heap_pop(ri_merge_t *merge)
+{
+  ri_merge_entry_t *heap = merge->heap;
+  ri_merge_entry_t last = heap[--merge->n_heap];
+  unsigned n = merge->n_heap;
+  unsigned i = 0;
+
+  for (;;) {
+    unsigned child = 2 * i + 1;
+
+    if (child >= n)
+      break;
+
+    if ((child + 1 < n) && entry_less(&heap[child + 1], &heap[child]))
+      child++;
+
+    if (!entry_less(&heap[child], &last))
+      break;
+
+    heap[i] = heap[child];
+    i = child;
+  }
+
+  heap[i] = last;
+}
+
+
+/* pops the consumers without a heap entry */
+static int merge_fill(ri_merge_t *merge)
+{
+  for (unsigned i = 0; i < merge->n_consumers; i++) {
+    if (merge->queued[i])
+      continue;
+
+    ri_pop_result_t r = ri_consumer_pop(merge->consumers[i]);
+
+    if (r == RI_POP_RESULT_ERROR)
+      return -EIO;
+
+    if (r <= RI_POP_RESULT_NO_UPDATE)
+      continue;
+
+    ri_merge_entry_t entry = {
+      .msg = ri_consumer_msg(merge->consumers[i]),
+      .index = i,
+    };
+
+    /* the message is written by another process, don't assume any alignment */
+    memcpy(&entry.ts, (const uint8_t*)entry.msg + merge->ts_offset, sizeof(entry.ts));
+
+    heap_push(merge, entry);
+    merge->queued[i] = true;
+  }
+
+  return 0;
+}
+
+
+static size_t merge_size(unsigned n)
+{
+  return sizeof(ri_merge_t) + n * (sizeof(ri_merge_entry_t) + sizeof(ri_consumer_t*) + sizeof(bool));
+}
+
+
+static ri_merge_t* merge_new(ri_consumer_t *consumers[], unsigned n, size_t ts_offset, uint64_t lateness,
+                             void *storage, size_t storage_size)
+{
+  if (n == 0)
+    goto fail_args;
+
+  for (unsigned i = 0; i < n; i++) {
+    size_t msg_size = ri_consumer_msg_size(consumers[i]);
+
+    if ((ts_offset > msg_size) || (msg_size - ts_offset < sizeof(uint64_t))) {
+      LOG_ERR("timestamp offset %zu exceeds message size %zu of consumer %u", ts_offset, msg_size, i);
+      goto fail_args;
+    }
+  }
+
+  size_t size = merge_size(n);
+
+  ri_merge_t *merge = storage ? ri_storage_place(storage, storage_size, size) : ri_alloc(size);
+  if (!merge) {
+    if (storage)
+      LOG_ERR("merge storage too small %zu < %zu", storage_size, ri_storage_size(size));
+    goto fail_alloc;
+  }
+
+  *merge = (ri_merge_t) {
+    .ts_offset = ts_offset,
+    .lateness = lateness,
+    .n_consumers = n,
+    .returned = n,
+    .owned = !storage,
+    .consumers = (ri_consumer_t**)&merge->heap[n],
+  };
+
+  merge->queued = (bool*)&merge->consumers[n];
+
+  for (unsigned i = 0; i < n; i++) {
+    merge->consumers[i] = consumers[i];
+    merge->queued[i] = false;
+  }
+
+  return merge;
+
+fail_alloc:
+fail_args:
+  return NULL;
+}
+
+
+ri_merge_t* ri_merge_new(ri_consumer_t *consumers[], unsigned n, size_t ts_offset, uint64_t lateness)
+{
+  return merge_new(consumers, n, ts_offset, lateness, NULL, 0);
+}
+
+
+size_t ri_merge_storage_size(unsigned n)
+{
+  return ri_storage_size(merge_size(n));
+}
+
+
+ri_merge_t* ri_merge_init(ri_consumer_t *consumers[], unsigned n, size_t ts_offset, uint64_t lateness,
+                          void *storage, size_t size)
+{
+  if (!storage)
+    return NULL;
+
+  return merge_new(consumers, n, ts_offset, lateness, storage, size);
+}
+
+
+void ri_merge_delete(ri_merge_t *merge)
+{
+  if (merge->owned)
+    ri_free(merge);
+}
+
+
+int ri_merge_next(ri_merge_t *merge, uint64_t now, const void **msg)
+{
+  /* the slot of the last message is given back by popping its consumer */
+  if (merge->returned < merge->n_consumers) {
+    merge->queued[merge->returned] = false;
+    merge->returned = merge->n_consumers;
+  }
+
+  int r = merge_fill(merge);
+  if (r < 0)
+    return r;
+
+  if (merge->n_heap == 0)
+    return -EAGAIN;
+
+  const ri_merge_entry_t *top = &merge->heap[0];
+
+  /* a silent consumer may still deliver an older message, wait for it
+   * until the lateness bound has passed */
+  if ((merge->n_heap < merge->n_consumers) &&
+      ((now < top->ts) || (now - top->ts < merge->lateness)))
+    return -EAGAIN;
+
+  unsigned index = top->index;
+
+  *msg = top->msg;
+  merge->returned = index;
+
+  heap_pop(merge);
+
+  return index;
+}
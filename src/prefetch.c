@@ -0,0 +1,33 @@
+#include "prefetch.h"
+
+#include <stdint.h>
+
+#include "mem_utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+/* prefetchw, CPUs without PRFCHW execute it as a nop */
+#define PREFETCH_WRITE_TARGET __attribute__((target("prfchw")))
+#else
+#define PREFETCH_WRITE_TARGET
+#endif
+
+
+void ri_prefetch_read(const void *ptr, size_t size)
+{
+  size_t stride = cacheline_size();
+  const uint8_t *p = ptr;
+
+  for (size_t i = 0; i < size; i += stride)
+    __builtin_prefetch(&p[i], 0, 3);
+}
+
+
+PREFETCH_WRITE_TARGET
+void ri_prefetch_write(void *ptr, size_t size)
+{
+  size_t stride = cacheline_size();
+  uint8_t *p = ptr;
+
+  for (size_t i = 0; i < size; i += stride)
+    __builtin_prefetch(&p[i], 1, 3);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stddef.h>
+
+/* the prefetches cover size bytes starting at ptr, one per cacheline */
+
+void ri_prefetch_read(const void *ptr, size_t size);
+
+/* prefetch with intent to write, the cachelines are fetched in exclusive state
+ * so the following stores don't need another coherence round trip */
+void ri_prefetch_write(void *ptr, size_t size);
@@ -1,53 +1,14 @@
 #include "producer.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
-#include <stdlib.h>
 
 
 #include "channel.h"
 #include "queue.h"
 
 
-struct ri_producer_queue {
-  /**
-   * Pointer to the shared memory this queue is mapped to.
-   * Only used to decrement the shared memory reference counter on deletion.
-   */
-  ri_shm_t *shm;
-
-  /**
-   * The queue structure stored in shared memory.
-   */
-  ri_queue_t queue;
-
-  /**
-   * Index of the last message in the chain available to the consumer.
-   * chain[head] is always INDEX_END.
-  */
-  ri_index_t head;
-
-  /**
-   * Index of the message currently being used by the producer.
-   * Will become the new head once finalized.
-   */
-  ri_index_t current;
-
-  /**
-   * Index of a message accessed by the consumer after the producer
-   * has advanced the tail. Will become 'current' when released by consumer.
-   */
-  ri_index_t overrun;
-
-  /**
-   * Local copy of the message chain.
-   * Required because the consumer only reads the queue;
-   * reading from a local copy is safer and faster.
-   */
-  ri_index_t chain[];
-};
-
-
 static void chain_store(ri_producer_queue_t *producer, ri_index_t idx, ri_index_t val)
 {
   producer->chain[idx] = val;
@@ -55,34 +16,26 @@ static void chain_store(ri_producer_queue_t *producer, ri_index_t idx, ri_index_
 }
 
 
-unsigned ri_producer_queue_len(const ri_producer_queue_t *producer)
-{
-  return producer->queue.n_msgs;
-}
-
-ri_producer_queue_t* ri_producer_queue_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset)
+int ri_producer_queue_init(ri_producer_queue_t *producer, const ri_attr_t *attr,
+                           ri_shm_t *shm, const ri_channel_layout_t *layout, ri_index_t *chain)
 {
-  unsigned queue_len = ri_channel_queue_len(attr);
-  size_t size = sizeof(ri_producer_queue_t) + queue_len * sizeof(ri_index_t);
-
-  ri_producer_queue_t *producer =  malloc(size);
-
-  if (!producer)
-    goto fail_alloc;
+  /* the spares behind the ring are only linked in to replace leased slots */
+  unsigned queue_len = ri_channel_ring_len(attr);
 
   *producer = (ri_producer_queue_t) {
       .shm = shm,
+      .chain = chain,
       .current = 0,
       .overrun = RI_INDEX_INVALID,
       .head = RI_INDEX_INVALID,
   };
 
-  void *ptr = ri_shm_ptr(shm, shm_offset);
+  void *ptr = ri_shm_ptr(shm, 0);
 
   if (!ptr)
-    goto fail_shm;
+    return -EINVAL;
 
-  ri_queue_init(&producer->queue, attr, ptr);
+  ri_queue_init(&producer->queue, attr, ptr, ri_shm_size(shm), layout);
 
   for (unsigned i = 0; i < queue_len - 1; i++) {
     chain_store(producer, i, i + 1);
@@ -90,34 +43,29 @@ ri_producer_queue_t* ri_producer_queue_new(const ri_attr_t *attr, ri_shm_t *shm,
 
   chain_store(producer, queue_len - 1, 0);
 
-  ri_shm_ref(producer->shm);
+  ri_lease_producer_init(&producer->leases, producer->queue.leases, producer->queue.n_leases,
+                         queue_len, &chain[ri_channel_queue_len(attr)]);
 
-  return producer;
-
-fail_shm:
-  free(producer);
-fail_alloc:
-  return NULL;
-}
+  producer->msg = ri_queue_get_msg(&producer->queue, producer->current);
 
+  ri_shm_ref(producer->shm);
 
-void ri_producer_queue_init_shm(const ri_producer_queue_t *producer)
-{
-  ri_queue_init_shm(&producer->queue);
+  return 0;
 }
 
 
-void ri_producer_queue_delete(ri_producer_queue_t* producer)
+void ri_producer_queue_init_shm(ri_producer_queue_t *producer)
 {
-  ri_shm_unref(producer->shm);
+  ri_queue_init_shm(&producer->queue);
 
-  free(producer);
+  /* the buffer offsets of relay channels are valid from now on */
+  producer->msg = ri_queue_get_msg(&producer->queue, producer->current);
 }
 
 
-size_t ri_producer_queue_msg_size(const ri_producer_queue_t *producer)
+void ri_producer_queue_deinit(ri_producer_queue_t* producer)
 {
-  return producer->queue.msg_size;
+  ri_shm_unref(producer->shm);
 }
 
 static void enqueue_first_msg(ri_producer_queue_t *producer)
@@ -158,6 +106,11 @@ static bool move_tail(ri_producer_queue_t *producer, ri_index_t tail)
 {
   ri_index_t next = producer->chain[tail & RI_INDEX_MASK];
 
+  /* the consumer is done with a released tail, the first flag tells it
+   * that no message was lost */
+  if (tail & RI_RELEASED_FLAG)
+    next |= RI_FIRST_FLAG;
+
   return ri_queue_tail_compare_exchange(&producer->queue, tail, next);
 }
 
@@ -207,7 +160,8 @@ bool ri_producer_queue_full(const ri_producer_queue_t *producer) {
     ri_index_t next = producer->chain[producer->current];
     bool full = next == (tail & RI_INDEX_MASK);
 
-    return !full;
+    /* a released tail gets reused by the next push */
+    return full && !(tail & RI_RELEASED_FLAG);
   }
 }
 
@@ -215,7 +169,7 @@ bool ri_producer_queue_full(const ri_producer_queue_t *producer) {
 /* inserts the next message into the queue and
  * if the queue is full, discard the last message that is not
  * used by consumer. Returns pointer to new message */
-ri_force_push_result_t ri_producer_queue_force_push(ri_producer_queue_t *producer)
+static ri_force_push_result_t force_push(ri_producer_queue_t *producer)
 {
   ri_index_t next = producer->chain[producer->current];
 
@@ -269,6 +223,11 @@ ri_force_push_result_t ri_producer_queue_force_push(ri_producer_queue_t *produce
     if (!full) {
       /* message queue not full, simply use next */
       producer->current = next;
+    } else if (tail & RI_RELEASED_FLAG) {
+      /* consumer released tail, reuse it without discarding a message.
+       * If moving tail fails, the consumer just moved on and tail is free anyway */
+      move_tail(producer, tail);
+      producer->current = next;
     } else if (!consumed) {
       /* message queue is full, but no message is consumed yet, so try to move tail */
       if (move_tail(producer, tail)) {
@@ -292,7 +251,7 @@ ri_force_push_result_t ri_producer_queue_force_push(ri_producer_queue_t *produce
 }
 
 /* trys to insert the next message into the queue */
-ri_try_push_result_t ri_producer_queue_try_push(ri_producer_queue_t *producer)
+static ri_try_push_result_t try_push(ri_producer_queue_t *producer)
 {
   ri_index_t next = producer->chain[producer->current];
 
@@ -328,9 +287,12 @@ ri_try_push_result_t ri_producer_queue_try_push(ri_producer_queue_t *producer)
     bool full = next == (tail & RI_INDEX_MASK);
 
     /* no previous overrun, use next or after next message */
-    if (!full) {
+    if (!full || (tail & RI_RELEASED_FLAG)) {
       enqueue_msg(producer);
 
+      if (full)
+        move_tail(producer, tail);
+
       producer->current = next;
 
       return RI_TRY_PUSH_RESULT_SUCCESS;
@@ -341,7 +303,49 @@ ri_try_push_result_t ri_producer_queue_try_push(ri_producer_queue_t *producer)
 }
 
 
-void* ri_producer_queue_msg(const ri_producer_queue_t *producer)
+/* the producer is about to write current, replace it by a spare if the consumer leased it */
+static void swap_leased(ri_producer_queue_t *producer)
 {
-  return ri_queue_get_msg(&producer->queue, producer->current);
+  ri_index_t spare = ri_lease_swap(&producer->leases, producer->current);
+
+  if (spare == RI_INDEX_INVALID)
+    return;
+
+  /* nothing links to current yet, the next enqueue appends it to head */
+  producer->chain[spare] = producer->chain[producer->current];
+  producer->current = spare;
+}
+
+
+ri_force_push_result_t ri_producer_queue_force_push(ri_producer_queue_t *producer)
+{
+  ri_force_push_result_t r = force_push(producer);
+
+  if (producer->leases.n_leases && (r != RI_FORCE_PUSH_RESULT_ERROR))
+    swap_leased(producer);
+
+  producer->msg = ri_queue_get_msg(&producer->queue, producer->current);
+
+  if (!producer->msg)
+    return RI_FORCE_PUSH_RESULT_ERROR;
+
+  return r;
+}
+
+
+ri_try_push_result_t ri_producer_queue_try_push(ri_producer_queue_t *producer)
+{
+  ri_try_push_result_t r = try_push(producer);
+
+  if (producer->leases.n_leases && (r == RI_TRY_PUSH_RESULT_SUCCESS))
+    swap_leased(producer);
+
+  if (r == RI_TRY_PUSH_RESULT_SUCCESS) {
+    producer->msg = ri_queue_get_msg(&producer->queue, producer->current);
+
+    if (!producer->msg)
+      return RI_TRY_PUSH_RESULT_ERROR;
+  }
+
+  return r;
 }
@@ -3,25 +3,101 @@
 #include <stddef.h>
 
 #include "rtipc/rtipc.h"
+#include "channel.h"
+#include "index.h"
+#include "layout.h"
+#include "lease.h"
+#include "queue.h"
 #include "shm.h"
 
 
-typedef struct ri_producer_queue ri_producer_queue_t;
+typedef struct ri_producer_queue {
+  /**
+   * The queue structure stored in shared memory.
+   */
+  ri_queue_t queue;
 
-ri_producer_queue_t * ri_producer_queue_new(const ri_attr_t *attr, ri_shm_t *shm, size_t shm_offset);
+  /**
+   * Local copy of the message chain.
+   * Required because the consumer only reads the queue;
+   * reading from a local copy is safer and faster.
+   * Stored directly behind the channel handle.
+   */
+  ri_index_t *chain;
 
-void ri_producer_queue_init_shm(const ri_producer_queue_t *producer);
+  /**
+   * Pointer to the message with index 'current', updated on every push
+   * so that accessing the message doesn't require any calculation.
+   */
+  void *msg;
 
-void ri_producer_queue_delete(ri_producer_queue_t* producer);
+  /**
+   * Index of the last message in the chain available to the consumer.
+   * chain[head] is always INDEX_END.
+  */
+  ri_index_t head;
 
-unsigned ri_producer_queue_len(const ri_producer_queue_t *producer);
+  /**
+   * Index of the message currently being used by the producer.
+   * Will become the new head once finalized.
+   */
+  ri_index_t current;
 
-size_t ri_producer_queue_msg_size(const ri_producer_queue_t *producer);
+  /**
+   * Index of a message accessed by the consumer after the producer
+   * has advanced the tail. Will become 'current' when released by consumer.
+   */
+  ri_index_t overrun;
 
-void* ri_producer_queue_msg(const ri_producer_queue_t *producer);
+  /**
+   * Spare slots replacing slots leased by the consumer.
+   */
+  ri_lease_producer_t leases;
+
+  /**
+   * Pointer to the shared memory this queue is mapped to.
+   * Only used to decrement the shared memory reference counter on deletion.
+   */
+  ri_shm_t *shm;
+} ri_producer_queue_t;
+
+
+/* local chain followed by the spare slots */
+static inline size_t ri_producer_queue_chain_size(const ri_attr_t *attr)
+{
+  return ri_channel_queue_len(attr) * sizeof(ri_index_t) + ri_lease_local_size(attr);
+}
+
+int ri_producer_queue_init(ri_producer_queue_t *producer, const ri_attr_t *attr,
+                           ri_shm_t *shm, const ri_channel_layout_t *layout, ri_index_t *chain);
+
+void ri_producer_queue_init_shm(ri_producer_queue_t *producer);
+
+void ri_producer_queue_deinit(ri_producer_queue_t* producer);
+
+static inline unsigned ri_producer_queue_len(const ri_producer_queue_t *producer)
+{
+  return producer->queue.n_msgs;
+}
+
+static inline size_t ri_producer_queue_msg_size(const ri_producer_queue_t *producer)
+{
+  return producer->queue.msg_size;
+}
+
+static inline void* ri_producer_queue_msg(const ri_producer_queue_t *producer)
+{
+  return producer->msg;
+}
 
 ri_force_push_result_t ri_producer_queue_force_push(ri_producer_queue_t *producer);
 
 ri_try_push_result_t ri_producer_queue_try_push(ri_producer_queue_t *producer);
 
 bool ri_producer_queue_full(const ri_producer_queue_t *producer);
+
+/* re-reads the buffer of current after a relay swapped it */
+static inline void ri_producer_queue_refresh(ri_producer_queue_t *producer)
+{
+  producer->msg = ri_queue_get_msg(&producer->queue, producer->current);
+}
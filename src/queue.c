@@ -1,9 +1,12 @@
 #include "queue.h"
 
+#include <errno.h>
+
 #include "rtipc/log.h"
 
 #include "mem_utils.h"
 #include "channel.h"
+#include "lease.h"
 
 size_t ri_calc_queue_size(unsigned n_msgs)
 {
@@ -13,18 +16,26 @@ size_t ri_calc_queue_size(unsigned n_msgs)
 }
 
 
-void ri_queue_init(ri_queue_t *queue, const ri_attr_t *attr, void* shm)
+void ri_queue_init(ri_queue_t *queue, const ri_attr_t *attr, void* shm, size_t shm_size,
+                   const ri_channel_layout_t *layout)
 {
-  ri_atomic_index_t *indices = (ri_atomic_index_t *) shm;
+  size_t stride = ri_channel_msg_stride(attr);
+  size_t align = attr->msg_align ? attr->msg_align : cacheline_size();
 
   *queue = (ri_queue_t) {
       .n_msgs = ri_channel_queue_len(attr),
       .msg_size = attr->msg_size,
-      .msg_size_aligned = cacheline_aligned(attr->msg_size),
-      .tail = &indices[0],
-      .head = &indices[1],
-      .chain = &indices[2],
-      .msgs =  mem_offset(shm, ri_calc_queue_size(attr->add_msgs)),
+      .msg_size_aligned = stride,
+      .tail = mem_offset(shm, layout->tail),
+      .head = mem_offset(shm, layout->head),
+      .chain = mem_offset(shm, layout->chain),
+      .msgs =  mem_offset(shm, layout->msgs),
+      .leases = mem_offset(shm, layout->leases),
+      .n_leases = attr->max_leases,
+      .base = shm,
+      .buffers = attr->relay ? mem_offset(shm, layout->buffers) : NULL,
+      .max_offset = shm_size - stride,
+      .offset_mask = align - 1,
   };
 }
 
@@ -33,15 +44,45 @@ void ri_queue_init_shm(const ri_queue_t *queue)
 {
   atomic_store(queue->tail, RI_INDEX_INVALID);
   atomic_store(queue->head, RI_INDEX_INVALID);
+
+  ri_lease_init_shm(queue->leases, queue->n_leases);
+
+  if (queue->buffers) {
+    size_t offset = (uintptr_t)queue->msgs - (uintptr_t)queue->base;
+
+    for (unsigned i = 0; i < queue->n_msgs; i++)
+      atomic_store(&queue->buffers[i], offset + i * queue->msg_size_aligned);
+  }
 }
 
 
-void* ri_queue_get_msg(const ri_queue_t *queue, ri_index_t idx)
+void* ri_queue_buffer(const ri_queue_t *queue, ri_index_t idx)
 {
-  if (idx >= queue->n_msgs)
+  uint64_t offset = atomic_load_explicit(&queue->buffers[idx], memory_order_relaxed);
+
+  if ((offset > queue->max_offset) || (offset & queue->offset_mask)) {
+    LOG_ERR("invalid buffer offset 0x%llx of slot %u", (unsigned long long)offset, idx);
     return NULL;
+  }
+
+  return mem_offset(queue->base, offset);
+}
+
+
+int ri_queue_swap_buffers(const ri_queue_t *a, ri_index_t a_idx,
+                          const ri_queue_t *b, ri_index_t b_idx)
+{
+  if (!ri_queue_buffer(a, a_idx) || !ri_queue_buffer(b, b_idx))
+    return -EINVAL;
+
+  uint64_t a_offset = atomic_load_explicit(&a->buffers[a_idx], memory_order_relaxed);
+  uint64_t b_offset = atomic_load_explicit(&b->buffers[b_idx], memory_order_relaxed);
+
+  /* published to the other side with the next tail or head update */
+  atomic_store_explicit(&a->buffers[a_idx], b_offset, memory_order_relaxed);
+  atomic_store_explicit(&b->buffers[b_idx], a_offset, memory_order_relaxed);
 
-  return mem_offset(queue->msgs, idx * queue->msg_size_aligned);
+  return 0;
 }
 
 
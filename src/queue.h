@@ -1,29 +1,17 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "rtipc/rtipc.h"
 
 #include "index.h"
+#include "layout.h"
+#include "mem_utils.h"
 
 
 typedef struct ri_queue
 {
-  /**
-   * Number of messages in the queue. Must be at least 3.
-   */
-  unsigned n_msgs;
-
-  /**
-   * Size of each message in bytes.
-   */
-  size_t msg_size;
-
-  /**
-   * Size of each message aligned to the cache line size for optimal memory access.
-   */
-  size_t msg_size_aligned;
-
   /**
    * Pointer to the contiguous block of message storage.
    */
@@ -48,12 +36,55 @@ typedef struct ri_queue
    * Only the producer modifies this array.
    */
   ri_atomic_index_t *chain;
-} ri_queue_t;
 
+  /**
+   * Start of the shared memory.
+   */
+  void *base;
+
+  /**
+   * Buffer offset of every slot relative to base, NULL unless the channel
+   * was created with ri_attr_t.relay. Written by the side owning the slot.
+   */
+  _Atomic uint64_t *buffers;
+
+  /**
+   * Largest valid buffer offset and the required alignment (mask),
+   * the offsets are written by another process and must be validated.
+   */
+  size_t max_offset;
+  size_t offset_mask;
+
+  /**
+   * Lease words, see lease.h. Written by the consumer.
+   */
+  ri_atomic_index_t *leases;
+
+  /**
+   * Number of lease words, ri_attr_t.max_leases.
+   */
+  unsigned n_leases;
+
+  /**
+   * Distance between two messages, the message size aligned to the cache line
+   * size or to the channel's msg_align.
+   */
+  size_t msg_size_aligned;
+
+  /**
+   * Size of each message in bytes.
+   */
+  size_t msg_size;
+
+  /**
+   * Number of messages in the queue. Must be at least 3.
+   */
+  unsigned n_msgs;
+} ri_queue_t;
 
-void* ri_queue_get_msg(const ri_queue_t *queue, ri_index_t idx);
 
-void ri_queue_init(ri_queue_t *queue, const ri_attr_t *attr, void* shm);
+void ri_queue_init(ri_queue_t *queue, const ri_attr_t *attr, void* shm, size_t shm_size,
+                   const ri_channel_layout_t *layout);
 
 void ri_queue_init_shm(const ri_queue_t *queue);
 
@@ -115,3 +146,22 @@ static inline bool ri_queue_index_valid(const ri_queue_t *queue, ri_index_t idx)
 {
   return idx < queue->n_msgs;
 }
+
+
+/* buffer of a slot of a relay channel, NULL if the offset is invalid */
+void* ri_queue_buffer(const ri_queue_t *queue, ri_index_t idx);
+
+/* exchanges the buffers of two slots, the caller must own both */
+int ri_queue_swap_buffers(const ri_queue_t *a, ri_index_t a_idx,
+                          const ri_queue_t *b, ri_index_t b_idx);
+
+static inline void* ri_queue_get_msg(const ri_queue_t *queue, ri_index_t idx)
+{
+  if (idx >= queue->n_msgs)
+    return NULL;
+
+  if (queue->buffers)
+    return ri_queue_buffer(queue, idx);
+
+  return mem_offset(queue->msgs, idx * queue->msg_size_aligned);
+}
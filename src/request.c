@@ -7,13 +7,25 @@
 
 #include "rtipc/rtipc.h"
 #include "rtipc/log.h"
+#include "alloc.h"
 #include "channel.h"
 #include "header.h"
 #include "mem_utils.h"
+#include "stream.h"
+#include "table.h"
 
 typedef struct entry {
   uint32_t add_msgs;
   uint32_t msg_size;
+  uint32_t msg_align;
+  uint32_t dirty_block;
+  uint32_t max_leases;
+  uint32_t relay;
+  uint32_t blob_size;
+  uint32_t lanes;
+  uint32_t interest;
+  uint32_t watermark;
+  uint32_t cache;
   int32_t eventfd;
   uint32_t info_size;
 } entry_t;
@@ -83,6 +95,19 @@ static int request_read(request_reader_t *reader, void *dst, size_t size)
 }
 
 
+/* skips n records of size bytes, checked against the remaining request
+ * before multiplying, so a forged count neither wraps nor over-allocates */
+static int request_skip(request_reader_t *reader, uint32_t n, size_t size)
+{
+  if (n > (reader->size - reader->offset) / size)
+    return -1;
+
+  reader->offset += n * size;
+
+  return 0;
+}
+
+
 static const void* request_get_info(request_reader_t *reader, size_t size)
 {
   if (reader->offset_info + size > reader->size)
@@ -101,6 +126,15 @@ static int request_write_channel(request_writer_t *writer, const ri_attr_t *attr
   entry_t entry = {
       .add_msgs = attr->add_msgs,
       .msg_size = attr->msg_size,
+      .msg_align = attr->msg_align,
+      .dirty_block = attr->dirty_block,
+      .max_leases = attr->max_leases,
+      .relay = attr->relay,
+      .blob_size = attr->blob_size,
+      .lanes = attr->lanes,
+      .interest = attr->interest,
+      .watermark = attr->watermark,
+      .cache = attr->cache,
       .info_size = attr->info.size,
       .eventfd = attr->eventfd,
   };
@@ -141,6 +175,15 @@ static int request_read_channel(request_reader_t *reader, ri_attr_t *attr)
   *attr = (ri_attr_t) {
       .add_msgs = entry.add_msgs,
       .msg_size = entry.msg_size,
+      .msg_align = entry.msg_align,
+      .dirty_block = entry.dirty_block,
+      .max_leases = entry.max_leases,
+      .relay = entry.relay,
+      .blob_size = entry.blob_size,
+      .lanes = entry.lanes,
+      .interest = entry.interest,
+      .watermark = entry.watermark,
+      .cache = entry.cache,
       .info = info,
       .eventfd = entry.eventfd,
   };
@@ -159,8 +202,14 @@ size_t ri_request_calc_size(const ri_config_t *config)
 
   size_t size = sizeof(ri_request_header_t);
 
-  /* vector info size + 2 * number of channels */
-  size += 3 * sizeof(uint32_t);
+  /* vector info size + layout + 2 * number of channels, streams and tables + barrier participants */
+  size += 9 * sizeof(uint32_t);
+
+  /* stream table */
+  size += (ri_count_streams(config->stream_readers) + ri_count_streams(config->stream_writers)) * sizeof(uint64_t);
+
+  /* table table, entry size, number of entries and flags */
+  size += (ri_count_tables(config->table_readers) + ri_count_tables(config->table_writers)) * 3 * sizeof(uint32_t);
 
   /* channel table */
   size += (n_consumers + n_producers) * sizeof(entry_t);
@@ -215,6 +264,14 @@ ri_config_t ri_request_parse(const void *req, size_t size, ri_attr_t **attrs)
     goto fail_parse;
   }
 
+  uint32_t layout;
+  r = request_read(&reader, &layout, sizeof(layout));
+
+  if (r < 0) {
+    LOG_ERR("request too small (%zu) for layout", size);
+    goto fail_parse;
+  }
+
 
   uint32_t n_consumers;
   r = request_read(&reader, &n_consumers, sizeof(n_consumers));
@@ -232,7 +289,67 @@ ri_config_t ri_request_parse(const void *req, size_t size, ri_attr_t **attrs)
     goto fail_parse;
   }
 
-  reader.offset_info = reader.offset + (n_producers + n_consumers) * sizeof(entry_t);
+  uint32_t n_readers;
+  r = request_read(&reader, &n_readers, sizeof(n_readers));
+
+  if (r < 0) {
+    LOG_ERR("request too small (%zu) for num_stream_readers", size);
+    goto fail_parse;
+  }
+
+  uint32_t n_writers;
+  r = request_read(&reader, &n_writers, sizeof(n_writers));
+
+  if (r < 0) {
+    LOG_ERR("request too small (%zu) for num_stream_writers", size);
+    goto fail_parse;
+  }
+
+  uint32_t n_table_readers;
+  r = request_read(&reader, &n_table_readers, sizeof(n_table_readers));
+
+  if (r < 0) {
+    LOG_ERR("request too small (%zu) for num_table_readers", size);
+    goto fail_parse;
+  }
+
+  uint32_t n_table_writers;
+  r = request_read(&reader, &n_table_writers, sizeof(n_table_writers));
+
+  if (r < 0) {
+    LOG_ERR("request too small (%zu) for num_table_writers", size);
+    goto fail_parse;
+  }
+
+  uint32_t barrier_participants;
+  r = request_read(&reader, &barrier_participants, sizeof(barrier_participants));
+
+  if (r < 0) {
+    LOG_ERR("request too small (%zu) for barrier_participants", size);
+    goto fail_parse;
+  }
+
+  size_t stream_table = reader.offset;
+
+  if ((request_skip(&reader, n_readers, sizeof(uint64_t)) < 0) ||
+      (request_skip(&reader, n_writers, sizeof(uint64_t)) < 0)) {
+    LOG_ERR("request too small (%zu) for %u/%u streams", size, n_readers, n_writers);
+    goto fail_parse;
+  }
+
+  if ((request_skip(&reader, n_table_readers, 3 * sizeof(uint32_t)) < 0) ||
+      (request_skip(&reader, n_table_writers, 3 * sizeof(uint32_t)) < 0)) {
+    LOG_ERR("request too small (%zu) for %u/%u tables", size, n_table_readers, n_table_writers);
+    goto fail_parse;
+  }
+
+  if ((request_skip(&reader, n_consumers, sizeof(entry_t)) < 0) ||
+      (request_skip(&reader, n_producers, sizeof(entry_t)) < 0)) {
+    LOG_ERR("request too small (%zu) for %u/%u channels", size, n_consumers, n_producers);
+    goto fail_parse;
+  }
+
+  reader.offset_info = reader.offset;
 
   ri_info_t vec_info = {
     .size = vec_info_size,
@@ -247,7 +364,14 @@ ri_config_t ri_request_parse(const void *req, size_t size, ri_attr_t **attrs)
     }
   }
 
-  ri_attr_t *channels = calloc(n_consumers + n_producers + 2, sizeof(ri_attr_t));
+  /* the stream and table attributes follow the channel attributes in the same allocation,
+   * all counts are bounded by the request size */
+  size_t n_channels = (size_t)n_consumers + n_producers + 2;
+  size_t n_streams = (size_t)n_readers + n_writers + 2;
+  size_t n_tables = (size_t)n_table_readers + n_table_writers + 2;
+
+  ri_attr_t *channels = ri_calloc(1, n_channels * sizeof(ri_attr_t) + n_streams * sizeof(ri_stream_attr_t) +
+                                     n_tables * sizeof(ri_table_attr_t));
   if (!channels) {
     goto fail_alloc;
   }
@@ -255,6 +379,50 @@ ri_config_t ri_request_parse(const void *req, size_t size, ri_attr_t **attrs)
   ri_attr_t *consumers = &channels[0];
   ri_attr_t *producers = &channels[n_consumers + 1];
 
+  ri_stream_attr_t *streams = (ri_stream_attr_t*)&channels[n_channels];
+  ri_stream_attr_t *readers = &streams[0];
+  ri_stream_attr_t *writers = &streams[n_readers + 1];
+
+  reader.offset = stream_table;
+
+  for (unsigned i = 0; i < n_readers + n_writers; i++) {
+    uint64_t stream_size;
+
+    r = request_read(&reader, &stream_size, sizeof(stream_size));
+    if ((r < 0) || (stream_size == 0)) {
+      LOG_ERR("invalid stream table");
+      goto fail_channel;
+    }
+
+    if (i < n_readers)
+      readers[i].size = stream_size;
+    else
+      writers[i - n_readers].size = stream_size;
+  }
+
+  ri_table_attr_t *tables = (ri_table_attr_t*)&streams[n_streams];
+  ri_table_attr_t *table_readers = &tables[0];
+  ri_table_attr_t *table_writers = &tables[n_table_readers + 1];
+
+  for (unsigned i = 0; i < n_table_readers + n_table_writers; i++) {
+    uint32_t table_attr[3];
+
+    r = request_read(&reader, table_attr, sizeof(table_attr));
+    if ((r < 0) || (table_attr[0] == 0) || (table_attr[1] == 0)) {
+      LOG_ERR("invalid table table");
+      goto fail_channel;
+    }
+
+    ri_table_attr_t *attr = i < n_table_readers ? &table_readers[i]
+                                                : &table_writers[i - n_table_readers];
+
+    *attr = (ri_table_attr_t) {
+      .entry_size = table_attr[0],
+      .n_entries = table_attr[1],
+      .conflate = table_attr[2],
+    };
+  }
+
   for (unsigned i = 0; i < n_consumers; i++) {
     r = request_read_channel(&reader, &consumers[i]);
     if (r < 0)
@@ -272,11 +440,17 @@ ri_config_t ri_request_parse(const void *req, size_t size, ri_attr_t **attrs)
   return (ri_config_t) {
          .consumers = consumers,
          .producers = producers,
+         .stream_readers = readers,
+         .stream_writers = writers,
+         .table_readers = table_readers,
+         .table_writers = table_writers,
+         .barrier_participants = barrier_participants,
          .info = vec_info,
+         .layout = layout,
          };
 
 fail_channel:
-  free(channels);
+  ri_free(channels);
 fail_parse:
 fail_alloc:
 fail_args:
@@ -308,6 +482,13 @@ int ri_request_write(const ri_config_t* config, void *req, size_t size)
 
   r = request_write(&writer, &vec_info, sizeof(vec_info));
 
+  if (r < 0)
+    goto fail;
+
+  uint32_t layout = config->layout;
+
+  r = request_write(&writer, &layout, sizeof(layout));
+
   if (r < 0)
     goto fail;
 
@@ -321,6 +502,61 @@ int ri_request_write(const ri_config_t* config, void *req, size_t size)
   if (r < 0)
     goto fail;
 
+  uint32_t n_writers = ri_count_streams(config->stream_writers);
+  uint32_t n_readers = ri_count_streams(config->stream_readers);
+
+  r = request_write(&writer, &n_writers, sizeof(n_writers));
+
+  if (r < 0)
+    goto fail;
+
+  r = request_write(&writer, &n_readers, sizeof(n_readers));
+
+  if (r < 0)
+    goto fail;
+
+  uint32_t n_table_writers = ri_count_tables(config->table_writers);
+  uint32_t n_table_readers = ri_count_tables(config->table_readers);
+
+  r = request_write(&writer, &n_table_writers, sizeof(n_table_writers));
+
+  if (r < 0)
+    goto fail;
+
+  r = request_write(&writer, &n_table_readers, sizeof(n_table_readers));
+
+  if (r < 0)
+    goto fail;
+
+  uint32_t barrier_participants = config->barrier_participants;
+
+  r = request_write(&writer, &barrier_participants, sizeof(barrier_participants));
+
+  if (r < 0)
+    goto fail;
+
+  /* the peer reads the streams we write */
+  for (unsigned i = 0; i < n_writers + n_readers; i++) {
+    uint64_t stream_size = i < n_writers ? config->stream_writers[i].size
+                                         : config->stream_readers[i - n_writers].size;
+
+    r = request_write(&writer, &stream_size, sizeof(stream_size));
+
+    if (r < 0)
+      goto fail;
+  }
+
+  for (unsigned i = 0; i < n_table_writers + n_table_readers; i++) {
+    const ri_table_attr_t *attr = i < n_table_writers ? &config->table_writers[i]
+                                                      : &config->table_readers[i - n_table_writers];
+    uint32_t table_attr[3] = { attr->entry_size, attr->n_entries, attr->conflate };
+
+    r = request_write(&writer, table_attr, sizeof(table_attr));
+
+    if (r < 0)
+      goto fail;
+  }
+
   writer.offset_info = writer.offset + (n_producers + n_consumers) * sizeof(entry_t);
 
   r = request_write_info(&writer, &config->info);
@@ -0,0 +1,320 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+#include "alloc.h"
+#include "clock.h"
+#include "mem_utils.h"
+
+
+/* Every request and response starts with the id of the call, the payload
+ * follows at RI_RPC_HEADER_SIZE. Both sides only use try_push, so no call
+ * is ever discarded, and the server answers in request order. The ids of
+ * the outstanding calls therefore form a window of at most max_pending
+ * consecutive numbers and index the client's table of send times directly. */
+typedef struct ri_rpc_header {
+  uint64_t id;
+} ri_rpc_header_t;
+
+_Static_assert(sizeof(ri_rpc_header_t) == RI_RPC_HEADER_SIZE, "rpc header size");
+
+
+typedef struct ri_rpc_call {
+  uint64_t id;
+  uint64_t sent;
+} ri_rpc_call_t;
+
+struct ri_rpc_client {
+  ri_producer_t *requests;
+  ri_consumer_t *responses;
+  uint64_t next_id;
+  unsigned n_pending;
+  unsigned max_pending;
+  /* allocated by ri_rpc_client_new, not placed in caller-provided storage */
+  bool owned;
+  ri_rpc_call_t calls[];
+};
+
+struct ri_rpc_server {
+  ri_consumer_t *requests;
+  ri_producer_t *responses;
+  /* the response to the current request is written but not pushed yet */
+  bool unsent;
+  /* allocated by ri_rpc_server_new, not placed in caller-provided storage */
+  bool owned;
+};
+
+
+static uint64_t header_id(const void *msg)
+{
+  ri_rpc_header_t header;
+
+  /* the message is written by the peer, read the id only once */
+  memcpy(&header, msg, sizeof(header));
+
+  return header.id;
+}
+
+
+static void header_write(void *msg, uint64_t id)
+{
+  ri_rpc_header_t header = { .id = id };
+
+  memcpy(msg, &header, sizeof(header));
+}
+
+
+static size_t client_size(unsigned max_pending)
+{
+  return sizeof(ri_rpc_client_t) + max_pending * sizeof(ri_rpc_call_t);
+}
+
+
+static ri_rpc_client_t* client_new(ri_producer_t *requests, ri_consumer_t *responses, unsigned max_pending,
+                                   void *storage, size_t storage_size)
+{
+  if ((max_pending == 0) ||
+      (ri_producer_msg_size(requests) < RI_RPC_HEADER_SIZE) ||
+      (ri_consumer_msg_size(responses) < RI_RPC_HEADER_SIZE)) {
+    LOG_ERR("rpc messages need at least %u bytes and max_pending > 0", RI_RPC_HEADER_SIZE);
+    goto fail_args;
+  }
+
+  size_t size = client_size(max_pending);
+
+  ri_rpc_client_t *client = storage ? ri_storage_place(storage, storage_size, size) : ri_alloc(size);
+  if (!client) {
+    if (storage)
+      LOG_ERR("rpc client storage too small %zu < %zu", storage_size, ri_storage_size(size));
+    goto fail_alloc;
+  }
+
+  *client = (ri_rpc_client_t) {
+    .requests = requests,
+    .responses = responses,
+    .max_pending = max_pending,
+    .owned = !storage,
+  };
+
+  return client;
+
+fail_alloc:
+fail_args:
+  return NULL;
+}
+
+
+ri_rpc_client_t* ri_rpc_client_new(ri_producer_t *requests, ri_consumer_t *responses, unsigned max_pending)
+{
+  return client_new(requests, responses, max_pending, NULL, 0);
+}
+
+
+size_t ri_rpc_client_storage_size(unsigned max_pending)
+{
+  return ri_storage_size(client_size(max_pending));
+}
+
+
+ri_rpc_client_t* ri_rpc_client_init(ri_producer_t *requests, ri_consumer_t *responses, unsigned max_pending,
+                                    void *storage, size_t size)
+{
+  if (!storage)
+    return NULL;
+
+  return client_new(requests, responses, max_pending, storage, size);
+}
+
+
+void ri_rpc_client_delete(ri_rpc_client_t *client)
+{
+  if (client->owned)
+    ri_free(client);
+}
+
+
+void* ri_rpc_client_request(const ri_rpc_client_t *client)
+{
+  if (client->n_pending == client->max_pending)
+    return NULL;
+
+  return mem_offset(ri_producer_msg(client->requests), RI_RPC_HEADER_SIZE);
+}
+
+
+int ri_rpc_client_send(ri_rpc_client_t *client, uint64_t *id)
+{
+  if (client->n_pending == client->max_pending)
+    return -EBUSY;
+
+  uint64_t call_id = client->next_id;
+
+  header_write(ri_producer_msg(client->requests), call_id);
+
+  ri_try_push_result_t r = ri_producer_try_push(client->requests);
+
+  if (r == RI_TRY_PUSH_RESULT_FAIL)
+    return -EAGAIN;
+
+  if (r != RI_TRY_PUSH_RESULT_SUCCESS)
+    return -EIO;
+
+  client->calls[call_id % client->max_pending] = (ri_rpc_call_t) {
+    .id = call_id,
+    .sent = ri_clock_ns(),
+  };
+
+  client->next_id++;
+  client->n_pending++;
+
+  if (id)
+    *id = call_id;
+
+  return 0;
+}
+
+
+int ri_rpc_client_poll(ri_rpc_client_t *client, ri_rpc_result_t *result)
+{
+  ri_pop_result_t r = ri_consumer_pop(client->responses);
+
+  if (r == RI_POP_RESULT_ERROR)
+    return -EIO;
+
+  if (r <= RI_POP_RESULT_NO_UPDATE)
+    return 0;
+
+  const void *msg = ri_consumer_msg(client->responses);
+  uint64_t id = header_id(msg);
+  ri_rpc_call_t *call = &client->calls[id % client->max_pending];
+
+  /* the server answers in request order, anything but the oldest pending
+   * call is unknown, answered already or answered out of order */
+  if ((client->n_pending == 0) || (id != client->next_id - client->n_pending) ||
+      (call->id != id)) {
+    LOG_ERR("unexpected rpc response id=%llu", (unsigned long long)id);
+    return -EPROTO;
+  }
+
+  *result = (ri_rpc_result_t) {
+    .id = id,
+    .response = cmem_offset(msg, RI_RPC_HEADER_SIZE),
+    .latency = ri_clock_ns() - call->sent,
+  };
+
+  /* responses arrive in request order, the oldest call is done */
+  client->n_pending--;
+
+  return 1;
+}
+
+
+unsigned ri_rpc_client_pending(const ri_rpc_client_t *client)
+{
+  return client->n_pending;
+}
+
+
+static ri_rpc_server_t* server_new(ri_consumer_t *requests, ri_producer_t *responses,
+                                   void *storage, size_t storage_size)
+{
+  if ((ri_consumer_msg_size(requests) < RI_RPC_HEADER_SIZE) ||
+      (ri_producer_msg_size(responses) < RI_RPC_HEADER_SIZE)) {
+    LOG_ERR("rpc messages need at least %u bytes", RI_RPC_HEADER_SIZE);
+    goto fail_args;
+  }
+
+  size_t size = sizeof(ri_rpc_server_t);
+
+  ri_rpc_server_t *server = storage ? ri_storage_place(storage, storage_size, size) : ri_alloc(size);
+  if (!server) {
+    if (storage)
+      LOG_ERR("rpc server storage too small %zu < %zu", storage_size, ri_storage_size(size));
+    goto fail_alloc;
+  }
+
+  *server = (ri_rpc_server_t) {
+    .requests = requests,
+    .responses = responses,
+    .owned = !storage,
+  };
+
+  return server;
+
+fail_alloc:
+fail_args:
+  return NULL;
+}
+
+
+ri_rpc_server_t* ri_rpc_server_new(ri_consumer_t *requests, ri_producer_t *responses)
+{
+  return server_new(requests, responses, NULL, 0);
+}
+
+
+size_t ri_rpc_server_storage_size(void)
+{
+  return ri_storage_size(sizeof(ri_rpc_server_t));
+}
+
+
+ri_rpc_server_t* ri_rpc_server_init(ri_consumer_t *requests, ri_producer_t *responses,
+                                    void *storage, size_t size)
+{
+  if (!storage)
+    return NULL;
+
+  return server_new(requests, responses, storage, size);
+}
+
+
+void ri_rpc_server_delete(ri_rpc_server_t *server)
+{
+  if (server->owned)
+    ri_free(server);
+}
+
+
+int ri_rpc_server_process(ri_rpc_server_t *server, ri_rpc_handler_fn handler, void *arg,
+                          unsigned max_batch)
+{
+  unsigned n = 0;
+
+  while (n < max_batch) {
+    if (!server->unsent) {
+      ri_pop_result_t r = ri_consumer_pop(server->requests);
+
+      if (r == RI_POP_RESULT_ERROR)
+        return -EIO;
+
+      if (r <= RI_POP_RESULT_NO_UPDATE)
+        break;
+
+      const void *request = ri_consumer_msg(server->requests);
+      void *response = ri_producer_msg(server->responses);
+
+      /* the handler writes the response straight into the slot */
+      header_write(response, header_id(request));
+      handler(arg, cmem_offset(request, RI_RPC_HEADER_SIZE), mem_offset(response, RI_RPC_HEADER_SIZE));
+
+      server->unsent = true;
+    }
+
+    ri_try_push_result_t r = ri_producer_try_push(server->responses);
+
+    /* the client is busy, keep the response and the request for the next call */
+    if (r == RI_TRY_PUSH_RESULT_FAIL)
+      break;
+
+    if (r != RI_TRY_PUSH_RESULT_SUCCESS)
+      return -EIO;
+
+    server->unsent = false;
+    n++;
+  }
+
+  return n;
+}
@@ -11,6 +11,7 @@
 #include "rtipc/rtipc.h"
 #include "rtipc/connect.h"
 #include "rtipc/log.h"
+#include "alloc.h"
 #include "unix.h"
 
 typedef struct ri_server ri_server_t;
@@ -23,7 +24,7 @@ struct ri_server {
 
 ri_server_t* ri_server_new(const char* path, int backlog)
 {
-  ri_server_t *server = malloc(sizeof(ri_server_t));
+  ri_server_t *server = ri_alloc(sizeof(ri_server_t));
 
   if (!server) {
     goto fail_alloc;
@@ -58,7 +59,7 @@ ri_server_t* ri_server_new(const char* path, int backlog)
 fail_bind:
   close(server->sockfd);
 fail_socket:
-  free(server);
+  ri_free(server);
 fail_alloc:
   return NULL;
 }
@@ -149,5 +150,5 @@ void ri_server_delete(ri_server_t* server)
 {
   close(server->sockfd);
   unlink(server->addr.sun_path);
-  free(server);
+  ri_free(server);
 }
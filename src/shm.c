@@ -4,6 +4,7 @@
 
 #include <errno.h>
 #include <stdatomic.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,6 +16,7 @@
 
 #include "rtipc/rtipc.h"
 #include "rtipc/log.h"
+#include "alloc.h"
 #include "mem_utils.h"
 
 struct ri_shm
@@ -24,6 +26,7 @@ struct ri_shm
   size_t size;
   int fd;
   bool owner;
+  bool allocated;
 };
 
 
@@ -31,17 +34,23 @@ static void shm_delete(ri_shm_t *shm)
 {
   munmap(shm->mem, shm->size);
   close(shm->fd);
-  free(shm);
+
+  if (shm->allocated)
+    ri_free(shm);
 }
 
 
-ri_shm_t* ri_shm_map(int fd)
+size_t ri_shm_storage_size(void)
+{
+  return sizeof(ri_shm_t);
+}
+
+
+ri_shm_t* ri_shm_map_init(int fd, void *storage)
 {
   struct stat stat;
 
-  ri_shm_t *shm = malloc(sizeof(ri_shm_t));
-  if (!shm)
-    return NULL;
+  ri_shm_t *shm = storage;
 
   *shm = (ri_shm_t) {
     .ref_cnt = 1,
@@ -74,11 +83,28 @@ ri_shm_t* ri_shm_map(int fd)
 
 fail_map:
 fail_stat:
-  free(shm);
   return NULL;
 }
 
 
+ri_shm_t* ri_shm_map(int fd)
+{
+  void *storage = ri_alloc(sizeof(ri_shm_t));
+  if (!storage)
+    return NULL;
+
+  ri_shm_t *shm = ri_shm_map_init(fd, storage);
+  if (!shm) {
+    ri_free(storage);
+    return NULL;
+  }
+
+  shm->allocated = true;
+
+  return shm;
+}
+
+
 void ri_shm_ref(ri_shm_t *shm)
 {
   atomic_fetch_add(&shm->ref_cnt, 1);
@@ -112,3 +138,152 @@ int ri_shm_get_fd(const ri_shm_t *shm)
 {
   return shm->fd;
 }
+
+
+void* ri_shm_map_mirror(const ri_shm_t *shm, size_t offset, size_t size)
+{
+  if (offset + size > shm->size)
+    goto fail_args;
+
+  /* reserve the address range first, so both views end up adjacent */
+  uint8_t *mem = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    LOG_ERR("mmap reserve size=%zu failed: %s", 2 * size, strerror(errno));
+    goto fail_reserve;
+  }
+
+  for (unsigned i = 0; i < 2; i++) {
+    void *view = mmap(mem + i * size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                      shm->fd, offset);
+    if (view == MAP_FAILED) {
+      LOG_ERR("mmap mirror offset=%zu size=%zu failed: %s", offset, size, strerror(errno));
+      goto fail_map;
+    }
+  }
+
+  if (mlock(mem, 2 * size) < 0) {
+    LOG_ERR("mlock failed: %s", strerror(errno));
+    goto fail_map;
+  }
+
+  return mem;
+
+fail_map:
+  munmap(mem, 2 * size);
+fail_reserve:
+fail_args:
+  return NULL;
+}
+
+
+void ri_shm_unmap_mirror(void *mem, size_t size)
+{
+  munmap(mem, 2 * size);
+}
+
+
+int ri_shm_resident(const ri_shm_t *shm, size_t offset, size_t size, size_t *resident)
+{
+  if ((offset > shm->size) || (size > shm->size - offset))
+    return -EINVAL;
+
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (uintptr_t)shm->mem + offset;
+  uintptr_t end = begin + size;
+  uintptr_t page = begin & ~(page_size - 1);
+  unsigned char vec[256];
+
+  *resident = 0;
+
+  while (page < end) {
+    size_t n_pages = (mem_align(end, page_size) - page) / page_size;
+
+    if (n_pages > sizeof(vec))
+      n_pages = sizeof(vec);
+
+    if (mincore((void*)page, n_pages * page_size, vec) < 0) {
+      LOG_ERR("mincore failed: %s", strerror(errno));
+      return -errno;
+    }
+
+    for (size_t i = 0; i < n_pages; i++, page += page_size) {
+      if (!(vec[i] & 1))
+        continue;
+
+      uintptr_t first = page < begin ? begin : page;
+      uintptr_t last = page + page_size > end ? end : page + page_size;
+
+      *resident += last - first;
+    }
+  }
+
+  return 0;
+}
+
+
+static size_t smaps_kb(const char *line, const char *key)
+{
+  size_t len = strlen(key);
+  unsigned long kb;
+
+  if (strncmp(line, key, len) != 0 || line[len] != ':')
+    return 0;
+
+  if (sscanf(&line[len + 1], "%lu", &kb) != 1)
+    return 0;
+
+  return kb * 1024;
+}
+
+
+int ri_shm_stat(const ri_shm_t *shm, ri_shm_stat_t *stat)
+{
+  *stat = (ri_shm_stat_t) { 0 };
+
+  int r = ri_shm_resident(shm, 0, shm->size, &stat->resident);
+  if (r < 0)
+    return r;
+
+  FILE *fp = fopen("/proc/self/smaps", "re");
+  if (!fp) {
+    LOG_WRN("failed to open /proc/self/smaps: %s", strerror(errno));
+    return 0;
+  }
+
+  char line[256];
+  bool found = false;
+  size_t rss = 0, page_size = 0, pmd = 0;
+
+  while (fgets(line, sizeof(line), fp)) {
+    unsigned long begin, end;
+
+    if (sscanf(line, "%lx-%lx ", &begin, &end) == 2) {
+      if (found)
+        break;
+      found = (begin == (uintptr_t)shm->mem);
+      continue;
+    }
+
+    if (!found)
+      continue;
+
+    rss += smaps_kb(line, "Rss");
+    stat->locked += smaps_kb(line, "Locked");
+    page_size += smaps_kb(line, "KernelPageSize");
+    pmd += smaps_kb(line, "ShmemPmdMapped");
+    pmd += smaps_kb(line, "FilePmdMapped");
+    pmd += smaps_kb(line, "AnonHugePages");
+  }
+
+  fclose(fp);
+
+  if (!found) {
+    LOG_WRN("mapping %p not found in /proc/self/smaps", shm->mem);
+    return 0;
+  }
+
+  /* hugetlbfs mappings report their page size, THP the PMD mapped amount */
+  stat->hugepage = page_size > (size_t)sysconf(_SC_PAGESIZE) ? rss : pmd;
+
+  return 0;
+}
@@ -8,6 +8,18 @@ typedef struct ri_shm ri_shm_t;
 
 ri_shm_t* ri_shm_map(int fd);
 
+/* maps fd using caller-provided storage of ri_shm_storage_size() bytes,
+ * the storage is not freed on release */
+ri_shm_t* ri_shm_map_init(int fd, void *storage);
+
+size_t ri_shm_storage_size(void);
+
+typedef struct ri_shm_stat {
+  size_t resident;
+  size_t locked;
+  size_t hugepage;
+} ri_shm_stat_t;
+
 void ri_shm_ref(ri_shm_t *shm);
 void ri_shm_unref(ri_shm_t *shm);
 
@@ -16,3 +28,15 @@ void* ri_shm_ptr(const ri_shm_t *shm, size_t offset);
 size_t ri_shm_size(const ri_shm_t *shm);
 
 int ri_shm_get_fd(const ri_shm_t *shm);
+
+/* maps [offset, offset + size) twice back to back,
+ * offset and size must be multiples of the page size */
+void* ri_shm_map_mirror(const ri_shm_t *shm, size_t offset, size_t size);
+
+void ri_shm_unmap_mirror(void *mem, size_t size);
+
+/* resident bytes of the range, based on mincore */
+int ri_shm_resident(const ri_shm_t *shm, size_t offset, size_t size, size_t *resident);
+
+/* residency of the whole mapping, locked and hugepage are read from /proc/self/smaps */
+int ri_shm_stat(const ri_shm_t *shm, ri_shm_stat_t *stat);
@@ -0,0 +1,84 @@
+#include "simd.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+static uint64_t index_neq_scalar(const ri_index_t *a, const ri_index_t *b, unsigned n)
+{
+  uint64_t mask = 0;
+
+  for (unsigned i = 0; i < n; i++) {
+    if (a[i] != b[i])
+      mask |= UINT64_C(1) << i;
+  }
+
+  return mask;
+}
+
+
+#if defined(__AVX2__)
+
+#define LANES 8
+
+static uint64_t index_neq_block(const ri_index_t *a, const ri_index_t *b)
+{
+  __m256i va = _mm256_loadu_si256((const __m256i*)a);
+  __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+  __m256i eq = _mm256_cmpeq_epi32(va, vb);
+
+  return ~_mm256_movemask_ps(_mm256_castsi256_ps(eq)) & 0xff;
+}
+
+#elif defined(__SSE2__)
+
+#define LANES 4
+
+static uint64_t index_neq_block(const ri_index_t *a, const ri_index_t *b)
+{
+  __m128i va = _mm_loadu_si128((const __m128i*)a);
+  __m128i vb = _mm_loadu_si128((const __m128i*)b);
+  __m128i eq = _mm_cmpeq_epi32(va, vb);
+
+  return ~_mm_movemask_ps(_mm_castsi128_ps(eq)) & 0xf;
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#define LANES 4
+
+static uint64_t index_neq_block(const ri_index_t *a, const ri_index_t *b)
+{
+  static const uint32_t bits[4] = {1, 2, 4, 8};
+
+  uint32x4_t eq = vceqq_u32(vld1q_u32(a), vld1q_u32(b));
+  uint32x4_t neq = vandq_u32(vmvnq_u32(eq), vld1q_u32(bits));
+
+  return vaddvq_u32(neq);
+}
+
+#endif
+
+
+uint64_t ri_simd_index_neq(const ri_index_t *a, const ri_index_t *b, unsigned n)
+{
+#ifdef LANES
+  uint64_t mask = 0;
+  unsigned i;
+
+  for (i = 0; i + LANES <= n; i += LANES)
+    mask |= index_neq_block(&a[i], &b[i]) << i;
+
+  if (i < n)
+    mask |= index_neq_scalar(&a[i], &b[i], n - i) << i;
+
+  return mask;
+#else
+  return index_neq_scalar(a, b, n);
+#endif
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "index.h"
+
+#define RI_SIMD_MASK_BITS 64
+
+/**
+ * Compares two index arrays element-wise.
+ *
+ * @param n number of elements, at most RI_SIMD_MASK_BITS
+ * @return bitmask with bit i set if a[i] != b[i]
+ */
+uint64_t ri_simd_index_neq(const ri_index_t *a, const ri_index_t *b, unsigned n);
@@ -0,0 +1,220 @@
+#include "stream.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rtipc/log.h"
+#include "mem_utils.h"
+
+
+/* Both positions count bytes since the stream was created. Only the
+ * writer stores head and only the reader stores tail, the ring holds
+ * head - tail bytes. */
+struct ri_stream {
+  _Atomic uint64_t *head;
+  _Atomic uint64_t *tail;
+  uint8_t *ring;
+  size_t size;
+  /* own position: head for the writer, tail for the reader */
+  uint64_t pos;
+  /* bytes available to acquire, from the last check of the peer */
+  size_t avail;
+  bool writer;
+  /* cold */
+  ri_shm_t *shm;
+  ri_arena_t *arena;
+};
+
+
+static size_t page_size(void)
+{
+  return sysconf(_SC_PAGESIZE);
+}
+
+
+size_t ri_stream_ring_size(const ri_stream_attr_t *attr)
+{
+  return mem_align(attr->size, page_size());
+}
+
+
+static size_t stream_shm_size(const ri_stream_attr_t *attr)
+{
+  /* the positions are written by different processes */
+  return page_size() + ri_stream_ring_size(attr);
+}
+
+
+static size_t layout_streams(size_t offset, const ri_stream_attr_t attrs[], size_t offsets[])
+{
+  unsigned n = ri_count_streams(attrs);
+
+  for (unsigned i = 0; i < n; i++) {
+    if (offsets)
+      offsets[i] = offset;
+
+    offset += stream_shm_size(&attrs[i]);
+  }
+
+  return offset;
+}
+
+
+size_t ri_stream_layout_calc(size_t offset, const ri_stream_attr_t first[],
+                             const ri_stream_attr_t second[],
+                             size_t first_offsets[], size_t second_offsets[])
+{
+  /* the rings are mapped separately, so they start on page boundaries */
+  offset = mem_align(offset, page_size());
+  offset = layout_streams(offset, first, first_offsets);
+
+  return layout_streams(offset, second, second_offsets);
+}
+
+
+size_t ri_stream_alloc_size(void)
+{
+  return cacheline_aligned(sizeof(ri_stream_t));
+}
+
+
+ri_stream_t* ri_stream_map(const ri_stream_attr_t *attr, bool writer, ri_shm_t *shm,
+                           size_t offset, ri_arena_t *arena)
+{
+  size_t size = ri_stream_ring_size(attr);
+
+  if (offset + stream_shm_size(attr) > ri_shm_size(shm)) {
+    LOG_ERR("stream at offset=%zu exceeds shared memory", offset);
+    goto fail_args;
+  }
+
+  ri_stream_t *stream = ri_arena_alloc(arena, sizeof(ri_stream_t));
+  if (!stream)
+    goto fail_alloc;
+
+  void *ring = ri_shm_map_mirror(shm, offset + page_size(), size);
+  if (!ring)
+    goto fail_ring;
+
+  void *control = ri_shm_ptr(shm, offset);
+
+  *stream = (ri_stream_t) {
+    .head = control,
+    .tail = mem_offset(control, cacheline_size()),
+    .ring = ring,
+    .size = size,
+    .writer = writer,
+    .shm = shm,
+    .arena = arena,
+  };
+
+  /* a peer mapping the vector later continues where the stream stands */
+  stream->pos = atomic_load_explicit(writer ? stream->head : stream->tail, memory_order_relaxed);
+
+  ri_shm_ref(shm);
+  ri_arena_ref(arena);
+
+  LOG_DBG("stream created size=%zu writer=%d offset=%zu", size, writer, offset);
+
+  return stream;
+
+fail_ring:
+fail_alloc:
+fail_args:
+  return NULL;
+}
+
+
+void ri_stream_delete(ri_stream_t *stream)
+{
+  ri_shm_unmap_mirror(stream->ring, stream->size);
+  ri_shm_unref(stream->shm);
+  ri_arena_unref(stream->arena);
+}
+
+
+size_t ri_stream_size(const ri_stream_t *stream)
+{
+  return stream->size;
+}
+
+
+static size_t update_avail(ri_stream_t *stream)
+{
+  if (stream->writer) {
+    uint64_t tail = atomic_load_explicit(stream->tail, memory_order_acquire);
+    uint64_t used = stream->pos - tail;
+
+    stream->avail = used <= stream->size ? stream->size - used : 0;
+  } else {
+    uint64_t head = atomic_load_explicit(stream->head, memory_order_acquire);
+    uint64_t used = head - stream->pos;
+
+    /* never trust the peer beyond the ring */
+    stream->avail = used <= stream->size ? used : 0;
+  }
+
+  return stream->avail;
+}
+
+
+void* ri_stream_acquire(ri_stream_t *stream, size_t *size)
+{
+  *size = update_avail(stream);
+
+  return &stream->ring[stream->pos % stream->size];
+}
+
+
+int ri_stream_commit(ri_stream_t *stream, size_t size)
+{
+  if (size > stream->avail)
+    return -EINVAL;
+
+  stream->pos += size;
+  stream->avail -= size;
+
+  atomic_store_explicit(stream->writer ? stream->head : stream->tail, stream->pos,
+                        memory_order_release);
+
+  return 0;
+}
+
+
+ssize_t ri_stream_write(ri_stream_t *stream, const void *data, size_t size)
+{
+  if (!stream->writer)
+    return -EPERM;
+
+  size_t avail;
+  void *span = ri_stream_acquire(stream, &avail);
+
+  if (size > avail)
+    size = avail;
+
+  memcpy(span, data, size);
+  ri_stream_commit(stream, size);
+
+  return size;
+}
+
+
+ssize_t ri_stream_read(ri_stream_t *stream, void *data, size_t size)
+{
+  if (stream->writer)
+    return -EPERM;
+
+  size_t avail;
+  const void *span = ri_stream_acquire(stream, &avail);
+
+  if (size > avail)
+    size = avail;
+
+  memcpy(data, span, size);
+  ri_stream_commit(stream, size);
+
+  return size;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rtipc/rtipc.h"
+#include "arena.h"
+#include "shm.h"
+
+/**
+ * Byte-stream channel in the shared memory of a vector.
+ *
+ * Each stream occupies a page holding the write and read positions,
+ * followed by the ring. The ring is a whole number of pages and is mapped
+ * twice back to back, so every span of up to the ring size is contiguous
+ * in virtual memory, regardless of where it wraps.
+ */
+
+static inline unsigned ri_count_streams(const ri_stream_attr_t attrs[])
+{
+  if (!attrs)
+    return 0;
+
+  unsigned i;
+
+  for (i = 0; attrs[i].size != 0; i++)
+    ;
+
+  return i;
+}
+
+
+/**
+ * Places the streams behind @p offset, @p first before @p second,
+ * the offsets arrays may be NULL.
+ *
+ * @return the end of the last stream
+ */
+size_t ri_stream_layout_calc(size_t offset, const ri_stream_attr_t first[],
+                             const ri_stream_attr_t second[],
+                             size_t first_offsets[], size_t second_offsets[]);
+
+/* size of the ring, the requested size rounded up to whole pages */
+size_t ri_stream_ring_size(const ri_stream_attr_t *attr);
+
+size_t ri_stream_alloc_size(void);
+
+ri_stream_t* ri_stream_map(const ri_stream_attr_t *attr, bool writer, ri_shm_t *shm,
+                           size_t offset, ri_arena_t *arena);
@@ -0,0 +1,323 @@
+#include "table.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rtipc/log.h"
+#include "mem_utils.h"
+
+
+typedef _Atomic uint64_t ri_table_seq_t;
+
+/* Conflation queue of a table with ri_table_attr_t.conflate set, a ring of
+ * changed keys. A key is queued only if its pending flag was clear, so the
+ * ring never holds more than n_entries keys and never overflows. */
+typedef struct ri_table_queue {
+  _Atomic uint64_t *head;
+  _Atomic uint64_t *tail;
+  _Atomic uint32_t *keys;
+  _Atomic uint8_t *pending;
+  /* own position: head for the writer, tail for the reader */
+  uint64_t pos;
+} ri_table_queue_t;
+
+struct ri_table {
+  uint8_t *entries;
+  size_t stride;
+  size_t entry_size;
+  unsigned n_entries;
+  bool writer;
+  ri_table_queue_t queue;
+  /* cold */
+  ri_shm_t *shm;
+  ri_arena_t *arena;
+};
+
+
+static size_t entry_stride(const ri_table_attr_t *attr)
+{
+  /* every entry starts on its own cacheline, so readers of one entry don't
+   * see the writer updating its neighbours */
+  return cacheline_aligned(sizeof(ri_table_seq_t) + attr->entry_size);
+}
+
+
+static size_t entries_size(const ri_table_attr_t *attr)
+{
+  return cacheline_aligned(attr->n_entries * entry_stride(attr));
+}
+
+
+static size_t queue_size(const ri_table_attr_t *attr)
+{
+  if (!attr->conflate)
+    return 0;
+
+  /* head and tail on their own cachelines, keys, pending flags */
+  return 2 * cacheline_size()
+         + cacheline_aligned(attr->n_entries * sizeof(uint32_t))
+         + cacheline_aligned(attr->n_entries * sizeof(uint8_t));
+}
+
+
+static size_t table_shm_size(const ri_table_attr_t *attr)
+{
+  return entries_size(attr) + queue_size(attr);
+}
+
+
+static void queue_init(ri_table_queue_t *queue, const ri_table_attr_t *attr, void *mem, bool writer)
+{
+  if (!attr->conflate)
+    return;
+
+  size_t keys_size = cacheline_aligned(attr->n_entries * sizeof(uint32_t));
+
+  *queue = (ri_table_queue_t) {
+    .head = mem,
+    .tail = mem_offset(mem, cacheline_size()),
+    .keys = mem_offset(mem, 2 * cacheline_size()),
+    .pending = mem_offset(mem, 2 * cacheline_size() + keys_size),
+  };
+
+  queue->pos = atomic_load_explicit(writer ? queue->head : queue->tail, memory_order_relaxed);
+}
+
+
+static size_t layout_tables(size_t offset, const ri_table_attr_t attrs[], size_t offsets[])
+{
+  unsigned n = ri_count_tables(attrs);
+
+  for (unsigned i = 0; i < n; i++) {
+    if (offsets)
+      offsets[i] = offset;
+
+    offset += table_shm_size(&attrs[i]);
+  }
+
+  return offset;
+}
+
+
+size_t ri_table_layout_calc(size_t offset, const ri_table_attr_t first[],
+                            const ri_table_attr_t second[],
+                            size_t first_offsets[], size_t second_offsets[])
+{
+  offset = cacheline_aligned(offset);
+  offset = layout_tables(offset, first, first_offsets);
+
+  return layout_tables(offset, second, second_offsets);
+}
+
+
+size_t ri_table_alloc_size(void)
+{
+  return cacheline_aligned(sizeof(ri_table_t));
+}
+
+
+ri_table_t* ri_table_map(const ri_table_attr_t *attr, bool writer, ri_shm_t *shm,
+                         size_t offset, ri_arena_t *arena)
+{
+  /* both are transferred as 32 bit values */
+  if ((attr->n_entries == 0) || (attr->entry_size > UINT32_MAX)) {
+    LOG_ERR("invalid table n_entries=%u entry_size=%zu", attr->n_entries, attr->entry_size);
+    goto fail_args;
+  }
+
+  if (offset + table_shm_size(attr) > ri_shm_size(shm)) {
+    LOG_ERR("table at offset=%zu exceeds shared memory", offset);
+    goto fail_args;
+  }
+
+  ri_table_t *table = ri_arena_alloc(arena, sizeof(ri_table_t));
+  if (!table)
+    goto fail_alloc;
+
+  *table = (ri_table_t) {
+    .entries = ri_shm_ptr(shm, offset),
+    .stride = entry_stride(attr),
+    .entry_size = attr->entry_size,
+    .n_entries = attr->n_entries,
+    .writer = writer,
+    .shm = shm,
+    .arena = arena,
+  };
+
+  queue_init(&table->queue, attr, ri_shm_ptr(shm, offset + entries_size(attr)), writer);
+
+  ri_shm_ref(shm);
+  ri_arena_ref(arena);
+
+  LOG_DBG("table created n_entries=%u entry_size=%zu writer=%d offset=%zu",
+          attr->n_entries, attr->entry_size, writer, offset);
+
+  return table;
+
+fail_alloc:
+fail_args:
+  return NULL;
+}
+
+
+void ri_table_delete(ri_table_t *table)
+{
+  ri_shm_unref(table->shm);
+  ri_arena_unref(table->arena);
+}
+
+
+unsigned ri_table_num_entries(const ri_table_t *table)
+{
+  return table->n_entries;
+}
+
+
+size_t ri_table_entry_size(const ri_table_t *table)
+{
+  return table->entry_size;
+}
+
+
+static ri_table_seq_t* entry_seq(const ri_table_t *table, unsigned key)
+{
+  return (ri_table_seq_t*)&table->entries[key * table->stride];
+}
+
+
+static void* entry_data(const ri_table_t *table, unsigned key)
+{
+  return &table->entries[key * table->stride + sizeof(ri_table_seq_t)];
+}
+
+
+void* ri_table_write_begin(ri_table_t *table, unsigned key)
+{
+  if (!table->writer || (key >= table->n_entries))
+    return NULL;
+
+  ri_table_seq_t *seq = entry_seq(table, key);
+  uint64_t s = atomic_load_explicit(seq, memory_order_relaxed);
+
+  /* odd while the entry is being written */
+  atomic_store_explicit(seq, s | 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  return entry_data(table, key);
+}
+
+
+void ri_table_write_end(ri_table_t *table, unsigned key)
+{
+  if (!table->writer || (key >= table->n_entries))
+    return;
+
+  ri_table_seq_t *seq = entry_seq(table, key);
+  uint64_t s = atomic_load_explicit(seq, memory_order_relaxed);
+
+  atomic_store_explicit(seq, (s | 1) + 1, memory_order_release);
+
+  ri_table_queue_t *queue = &table->queue;
+
+  if (!queue->keys)
+    return;
+
+  /* the reader clears the flag before it reads the entry, so either it
+   * sees this update or the key gets queued again */
+  if (atomic_exchange_explicit(&queue->pending[key], 1, memory_order_acq_rel))
+    return;
+
+  atomic_store_explicit(&queue->keys[queue->pos % table->n_entries], key, memory_order_relaxed);
+  queue->pos++;
+  atomic_store_explicit(queue->head, queue->pos, memory_order_release);
+}
+
+
+int ri_table_write(ri_table_t *table, unsigned key, const void *data)
+{
+  void *entry = ri_table_write_begin(table, key);
+  if (!entry)
+    return -EINVAL;
+
+  memcpy(entry, data, table->entry_size);
+
+  ri_table_write_end(table, key);
+
+  return 0;
+}
+
+
+const void* ri_table_read_begin(const ri_table_t *table, unsigned key, uint64_t *version)
+{
+  if (key >= table->n_entries)
+    return NULL;
+
+  uint64_t s = atomic_load_explicit(entry_seq(table, key), memory_order_acquire);
+
+  if (s & 1)
+    return NULL;
+
+  *version = s;
+
+  return entry_data(table, key);
+}
+
+
+bool ri_table_read_check(const ri_table_t *table, unsigned key, uint64_t version)
+{
+  if (key >= table->n_entries)
+    return false;
+
+  /* orders the reads of the entry before the second load of the counter */
+  atomic_thread_fence(memory_order_acquire);
+
+  return atomic_load_explicit(entry_seq(table, key), memory_order_relaxed) == version;
+}
+
+
+int ri_table_read(const ri_table_t *table, unsigned key, void *dst)
+{
+  if (key >= table->n_entries)
+    return -EINVAL;
+
+  uint64_t version;
+  const void *entry = ri_table_read_begin(table, key, &version);
+  if (!entry)
+    return -EAGAIN;
+
+  memcpy(dst, entry, table->entry_size);
+
+  return ri_table_read_check(table, key, version) ? 0 : -EAGAIN;
+}
+
+
+int ri_table_pop(ri_table_t *table)
+{
+  ri_table_queue_t *queue = &table->queue;
+
+  if (!queue->keys)
+    return -ENOTSUP;
+
+  if (table->writer)
+    return -EPERM;
+
+  uint64_t head = atomic_load_explicit(queue->head, memory_order_acquire);
+
+  if (head == queue->pos)
+    return -ENOENT;
+
+  uint32_t key = atomic_load_explicit(&queue->keys[queue->pos % table->n_entries], memory_order_relaxed);
+
+  queue->pos++;
+  atomic_store_explicit(queue->tail, queue->pos, memory_order_release);
+
+  /* never trust the peer */
+  if (key >= table->n_entries)
+    return -EINVAL;
+
+  atomic_exchange_explicit(&queue->pending[key], 0, memory_order_acq_rel);
+
+  return key;
+}
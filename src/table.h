@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rtipc/rtipc.h"
+#include "arena.h"
+#include "shm.h"
+
+/**
+ * Shared state table in the shared memory of a vector.
+ *
+ * Every entry is preceded by a 64 bit sequence counter and padded to a
+ * multiple of the cacheline size together with it. The single writer
+ * makes it odd before changing the entry and even again afterwards, so a
+ * reader detects torn reads by comparing the counter before and after
+ * accessing the entry in place.
+ *
+ * Conflating tables additionally queue the keys of updated entries,
+ * each key at most once until the reader takes it.
+ */
+
+static inline unsigned ri_count_tables(const ri_table_attr_t attrs[])
+{
+  if (!attrs)
+    return 0;
+
+  unsigned i;
+
+  for (i = 0; attrs[i].entry_size != 0; i++)
+    ;
+
+  return i;
+}
+
+
+/**
+ * Places the tables behind @p offset, @p first before @p second,
+ * the offsets arrays may be NULL.
+ *
+ * @return the end of the last table
+ */
+size_t ri_table_layout_calc(size_t offset, const ri_table_attr_t first[],
+                            const ri_table_attr_t second[],
+                            size_t first_offsets[], size_t second_offsets[]);
+
+size_t ri_table_alloc_size(void);
+
+ri_table_t* ri_table_map(const ri_table_attr_t *attr, bool writer, ri_shm_t *shm,
+                         size_t offset, ri_arena_t *arena);
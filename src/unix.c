@@ -15,9 +15,11 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/mman.h> // memfd_create
 
 #include "rtipc/log.h"
+#include "alloc.h"
 
 
 /* from kernel/include/net/scm.h */
@@ -151,6 +153,38 @@ int ri_set_nonblocking(int fd)
 }
 
 
+int ri_uxsocket_connect(const char *path)
+{
+  int r;
+
+  int sockfd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (sockfd < 0) {
+    r = -errno;
+    LOG_ERR("socket failed errno=%u", errno);
+    goto fail_socket;
+  }
+
+  struct sockaddr_un addr;
+
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+  r = connect(sockfd, (struct sockaddr*)&addr, sizeof(addr));
+  if (r < 0) {
+    r = -errno;
+    LOG_ERR("connect failed errno=%u", errno);
+    goto fail_connect;
+  }
+
+  return sockfd;
+
+fail_connect:
+  close(sockfd);
+fail_socket:
+  return r;
+}
+
+
 int ri_uxsocket_send(int socket, const void *data, size_t size)
 {
   struct iovec iov = {
@@ -185,7 +219,7 @@ void* ri_uxsocket_receive(int socket, size_t *size)
 
   *size = r;
 
-  void* msg = calloc(*size, 1);
+  void* msg = ri_calloc(*size, 1);
 
   if (!msg)
     goto fail_peek;
@@ -207,7 +241,7 @@ void* ri_uxsocket_receive(int socket, size_t *size)
   return msg;
 
 fail_recv:
-  free(msg);
+  ri_free(msg);
 fail_peek:
   return NULL;
 }
@@ -215,7 +249,7 @@ fail_peek:
 
 ri_uxmsg_t* ri_uxmsg_new(size_t size)
 {
-  ri_uxmsg_t *msg = malloc(sizeof(ri_uxmsg_t));
+  ri_uxmsg_t *msg = ri_alloc(sizeof(ri_uxmsg_t));
   if (!msg)
     goto fail_alloc;
 
@@ -224,14 +258,14 @@ ri_uxmsg_t* ri_uxmsg_new(size_t size)
     .dir = RI_UXMSG_TX,
   };
 
-  msg->data = malloc(size);
+  msg->data = ri_alloc(size);
   if (!msg->data)
     goto fail_msg;
 
   return msg;
 
 fail_msg:
-  free(msg);
+  ri_free(msg);
 fail_alloc:
   return NULL;
 }
@@ -239,7 +273,7 @@ fail_alloc:
 
 void ri_uxmsg_delete(ri_uxmsg_t *msg)
 {
-  free(msg->data);
+  ri_free(msg->data);
 
   struct cmsghdr *cmsghdr = (struct cmsghdr*) msg->cmsg;
 
@@ -253,7 +287,7 @@ void ri_uxmsg_delete(ri_uxmsg_t *msg)
     }
   }
 
-  free(msg);
+  ri_free(msg);
 }
 
 
@@ -88,6 +88,14 @@ int ri_uxmsg_send(const ri_uxmsg_t *msg, int socket);
 ri_uxmsg_t* ri_uxmsg_receive(int socket);
 
 
+/**
+ * @brief Connect a SOCK_SEQPACKET socket to a UNIX domain socket path.
+ *
+ * @return On success, returns the connected socket.
+ *         On failure, returns -errno.
+ */
+int ri_uxsocket_connect(const char *path);
+
 int ri_uxsocket_send(int socket, const void *data, size_t size);
 
 void* ri_uxsocket_receive(int socket, size_t *size);
@@ -1,21 +1,76 @@
 #include "vector.h"
 
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
 
 #include "rtipc/rtipc.h"
+#include "rtipc/log.h"
+#include "alloc.h"
+#include "arena.h"
 #include "channel.h"
+#include "layout.h"
+#include "mem_utils.h"
+#include "simd.h"
+#include "stream.h"
+#include "table.h"
+#include "barrier.h"
 #include "unix.h"
 #include "request.h"
 
+/* snapshot attempts of ri_vector_pop_consistent before giving up */
+#define RI_VECTOR_TX_ATTEMPTS 16
+
 struct ri_vector {
   ri_shm_t *shm;
+  ri_arena_t *arena;
+  ri_layout_t layout;
   unsigned n_consumers;
   unsigned n_producers;
   ri_consumer_t **consumers;
   ri_producer_t **producers;
+  unsigned n_readers;
+  unsigned n_writers;
+  ri_stream_t **readers;
+  ri_stream_t **writers;
+  /**
+   * Stream attributes terminated by a sentinel, needed to serialize the
+   * vector after streams were taken.
+   */
+  ri_stream_attr_t *reader_attrs;
+  ri_stream_attr_t *writer_attrs;
+  size_t stream_size;
+  unsigned n_table_readers;
+  unsigned n_table_writers;
+  ri_table_t **table_readers;
+  ri_table_t **table_writers;
+  ri_table_attr_t *table_reader_attrs;
+  ri_table_attr_t *table_writer_attrs;
+  size_t table_size;
+  /**
+   * Transaction epochs, odd while a commit is in progress. tx_epoch is
+   * written by this side, rx_epoch by the peer.
+   */
+  _Atomic uint64_t *tx_epoch;
+  const _Atomic uint64_t *rx_epoch;
+  uint64_t epoch;
+  ri_producer_t **staged;
+  unsigned n_staged;
+  /* producers created by this vector, kept after they are taken */
+  ri_producer_t **created;
+  unsigned barrier_participants;
+  size_t barrier_offset;
+  ri_barrier_t *barriers;
+  /**
+   * Packed head indices of all consumers, only available with RI_LAYOUT_SPLIT.
+   */
+  const ri_index_t *consumer_heads;
+  /**
+   * Static part of the channel descriptions, consumers first.
+   */
+  ri_channel_layout_info_t *channel_infos;
   struct {
     size_t size;
     void *data;
@@ -51,7 +106,7 @@ static ri_config_t ri_vector_config(const ri_vector_t *vec, ri_attr_t **attrs)
   if (!attrs) {
     goto fail_args;
   }
-  ri_attr_t *channels = calloc(vec->n_consumers + vec->n_producers + 2, sizeof(ri_attr_t));
+  ri_attr_t *channels = ri_calloc(vec->n_consumers + vec->n_producers + 2, sizeof(ri_attr_t));
   if (!channels) {
     goto fail_alloc;
   }
@@ -76,8 +131,14 @@ static ri_config_t ri_vector_config(const ri_vector_t *vec, ri_attr_t **attrs)
   return (ri_config_t) {
       .consumers = consumers,
       .producers = producers,
+      .stream_readers = vec->reader_attrs,
+      .stream_writers = vec->writer_attrs,
+      .table_readers = vec->table_reader_attrs,
+      .table_writers = vec->table_writer_attrs,
+      .barrier_participants = vec->barrier_participants,
       .info.size = vec->info.size,
       .info.data = vec->info.data,
+      .layout = vec->layout,
   };
 
 
@@ -96,7 +157,7 @@ static int build_request(const ri_vector_t *vec, void* req, size_t size) {
 
   int r = ri_request_write(&config, req, size);
 
-  free(attrs);
+  ri_free(attrs);
 
   return r;
 }
@@ -140,15 +201,94 @@ static int collect_fds(const ri_vector_t *vec, int fds[], unsigned n_fds) {
 }
 
 
-static ri_vector_t* ri_vector_alloc(unsigned n_consumers, unsigned n_producers, const ri_info_t *info)
+static size_t channel_alloc_size(const ri_attr_t *attr)
 {
-  ri_vector_t *vec = calloc(1, sizeof(ri_vector_t));
+  /* the same size is needed on both ends of the channel */
+  size_t consumer_size = ri_consumer_alloc_size(attr);
+  size_t producer_size = ri_producer_alloc_size(attr);
+
+  return consumer_size > producer_size ? consumer_size : producer_size;
+}
+
+
+static size_t vector_arena_size(const ri_config_t *config)
+{
+  unsigned n_consumers = ri_count_channels(config->consumers);
+  unsigned n_producers = ri_count_channels(config->producers);
+  unsigned n_readers = ri_count_streams(config->stream_readers);
+  unsigned n_writers = ri_count_streams(config->stream_writers);
+  unsigned n_streams = n_readers + n_writers;
+  unsigned n_table_readers = ri_count_tables(config->table_readers);
+  unsigned n_table_writers = ri_count_tables(config->table_writers);
+  unsigned n_tables = n_table_readers + n_table_writers;
+  /* too many participants are rejected after the arena is set up */
+  unsigned n_participants = config->barrier_participants <= RI_MAX_BARRIER_PARTICIPANTS
+                          ? config->barrier_participants : 0;
+
+  size_t size = cacheline_aligned(sizeof(ri_vector_t))
+              + cacheline_aligned(n_consumers * sizeof(ri_consumer_t*))
+              + cacheline_aligned(n_producers * sizeof(ri_producer_t*))
+              + cacheline_aligned((n_consumers + n_producers + 1) * sizeof(ri_channel_layout_t))
+              + cacheline_aligned((n_consumers + n_producers) * sizeof(ri_channel_layout_info_t))
+              + cacheline_aligned(ri_shm_storage_size())
+              + cacheline_aligned(n_streams * sizeof(ri_stream_t*))
+              + cacheline_aligned((n_readers + 1) * sizeof(ri_stream_attr_t))
+              + cacheline_aligned((n_writers + 1) * sizeof(ri_stream_attr_t))
+              + cacheline_aligned((n_streams + 2) * sizeof(size_t))
+              + n_streams * ri_stream_alloc_size()
+              + cacheline_aligned(n_tables * sizeof(ri_table_t*))
+              + cacheline_aligned((n_table_readers + 1) * sizeof(ri_table_attr_t))
+              + cacheline_aligned((n_table_writers + 1) * sizeof(ri_table_attr_t))
+              + cacheline_aligned((n_tables + 2) * sizeof(size_t))
+              + n_tables * ri_table_alloc_size()
+              + ri_barrier_alloc_size(n_participants)
+              + cacheline_aligned(n_producers * sizeof(ri_producer_t*))
+              + cacheline_aligned(n_producers * sizeof(ri_producer_t*));
+
+  if (config->info.data)
+    size += cacheline_aligned(config->info.size);
+
+  for (unsigned i = 0; i < n_consumers; i++)
+    size += channel_alloc_size(&config->consumers[i]);
+
+  for (unsigned i = 0; i < n_producers; i++)
+    size += channel_alloc_size(&config->producers[i]);
+
+  return size;
+}
+
+
+static ri_arena_t* vector_arena_new(const ri_config_t *config, void *storage, size_t storage_size)
+{
+  size_t size = vector_arena_size(config);
+
+  if (!storage)
+    return ri_arena_new(size);
+
+  if (storage_size < ri_arena_storage_size(size)) {
+    LOG_ERR("vector storage too small %zu < %zu", storage_size, ri_arena_storage_size(size));
+    return NULL;
+  }
+
+  return ri_arena_init(storage, storage_size);
+}
+
+
+/* the vector takes over the arena reference */
+static ri_vector_t* ri_vector_alloc(ri_arena_t *arena, unsigned n_consumers, unsigned n_producers, const ri_info_t *info, ri_layout_t layout)
+{
+  ri_vector_t *vec = ri_arena_alloc(arena, sizeof(ri_vector_t));
 
   if (!vec)
     goto fail_alloc;
 
-  if (info->size > 0 && vec->info.data) {
-    vec->info.data = malloc(info->size);
+  *vec = (ri_vector_t) {
+    .arena = arena,
+    .layout = layout,
+  };
+
+  if (info->size > 0 && info->data) {
+    vec->info.data = ri_arena_alloc(arena, info->size);
 
     if (!vec->info.data)
       goto fail_info;
@@ -159,17 +299,27 @@ static ri_vector_t* ri_vector_alloc(unsigned n_consumers, unsigned n_producers,
   }
 
   if (n_consumers > 0) {
-    vec->consumers = calloc(n_consumers, sizeof(ri_consumer_t*));
+    vec->consumers = ri_arena_alloc(arena, n_consumers * sizeof(ri_consumer_t*));
 
     if (!vec->consumers)
       goto fail_consumers;
   }
 
   if (n_producers > 0) {
-    vec->producers = calloc(n_producers, sizeof(ri_producer_t*));
+    vec->producers = ri_arena_alloc(arena, n_producers * sizeof(ri_producer_t*));
 
     if (!vec->producers)
       goto fail_producers;
+
+    vec->staged = ri_arena_alloc(arena, n_producers * sizeof(ri_producer_t*));
+
+    if (!vec->staged)
+      goto fail_producers;
+
+    vec->created = ri_arena_alloc(arena, n_producers * sizeof(ri_producer_t*));
+
+    if (!vec->created)
+      goto fail_producers;
   }
 
   vec->n_consumers = n_consumers;
@@ -178,25 +328,164 @@ static ri_vector_t* ri_vector_alloc(unsigned n_consumers, unsigned n_producers,
   return vec;
 
 fail_producers:
-  if (n_consumers > 0)
-    free(vec->consumers);
 fail_consumers:
-  if (vec->info.data) {
-    free(vec->info.data);
-  }
 fail_info:
-  free(vec);
 fail_alloc:
   return NULL;
 }
 
-static ri_shm_t* shm_new(size_t shm_size)
+static ri_stream_attr_t* stream_attrs_copy(ri_arena_t *arena, const ri_stream_attr_t attrs[], unsigned n)
+{
+  ri_stream_attr_t *copy = ri_arena_alloc(arena, (n + 1) * sizeof(ri_stream_attr_t));
+  if (!copy)
+    return NULL;
+
+  for (unsigned i = 0; i < n; i++)
+    copy[i] = attrs[i];
+
+  copy[n] = (ri_stream_attr_t) { 0 };
+
+  return copy;
+}
+
+
+static int vector_alloc_streams(ri_vector_t *vec, const ri_config_t *config)
+{
+  vec->n_readers = ri_count_streams(config->stream_readers);
+  vec->n_writers = ri_count_streams(config->stream_writers);
+
+  unsigned n_streams = vec->n_readers + vec->n_writers;
+
+  if (n_streams > 0) {
+    vec->readers = ri_arena_alloc(vec->arena, n_streams * sizeof(ri_stream_t*));
+    if (!vec->readers)
+      return -ENOMEM;
+
+    vec->writers = &vec->readers[vec->n_readers];
+  }
+
+  vec->reader_attrs = stream_attrs_copy(vec->arena, config->stream_readers, vec->n_readers);
+  vec->writer_attrs = stream_attrs_copy(vec->arena, config->stream_writers, vec->n_writers);
+
+  if (!vec->reader_attrs || !vec->writer_attrs)
+    return -ENOMEM;
+
+  /* the rings start page aligned, so their total size doesn't depend on the offset */
+  vec->stream_size = ri_stream_layout_calc(0, vec->reader_attrs, vec->writer_attrs, NULL, NULL);
+
+  return 0;
+}
+
+
+static int vector_map_streams(ri_vector_t *vec, const size_t reader_offsets[], const size_t writer_offsets[])
+{
+  for (unsigned i = 0; i < vec->n_readers; i++) {
+    vec->readers[i] = ri_stream_map(&vec->reader_attrs[i], false, vec->shm, reader_offsets[i], vec->arena);
+    if (!vec->readers[i])
+      return -ENOMEM;
+  }
+
+  for (unsigned i = 0; i < vec->n_writers; i++) {
+    vec->writers[i] = ri_stream_map(&vec->writer_attrs[i], true, vec->shm, writer_offsets[i], vec->arena);
+    if (!vec->writers[i])
+      return -ENOMEM;
+  }
+
+  return 0;
+}
+
+
+static ri_table_attr_t* table_attrs_copy(ri_arena_t *arena, const ri_table_attr_t attrs[], unsigned n)
+{
+  ri_table_attr_t *copy = ri_arena_alloc(arena, (n + 1) * sizeof(ri_table_attr_t));
+  if (!copy)
+    return NULL;
+
+  for (unsigned i = 0; i < n; i++)
+    copy[i] = attrs[i];
+
+  copy[n] = (ri_table_attr_t) { 0 };
+
+  return copy;
+}
+
+
+static int vector_alloc_tables(ri_vector_t *vec, const ri_config_t *config)
+{
+  vec->n_table_readers = ri_count_tables(config->table_readers);
+  vec->n_table_writers = ri_count_tables(config->table_writers);
+
+  unsigned n_tables = vec->n_table_readers + vec->n_table_writers;
+
+  if (n_tables > 0) {
+    vec->table_readers = ri_arena_alloc(vec->arena, n_tables * sizeof(ri_table_t*));
+    if (!vec->table_readers)
+      return -ENOMEM;
+
+    vec->table_writers = &vec->table_readers[vec->n_table_readers];
+  }
+
+  vec->table_reader_attrs = table_attrs_copy(vec->arena, config->table_readers, vec->n_table_readers);
+  vec->table_writer_attrs = table_attrs_copy(vec->arena, config->table_writers, vec->n_table_writers);
+
+  if (!vec->table_reader_attrs || !vec->table_writer_attrs)
+    return -ENOMEM;
+
+  vec->table_size = ri_table_layout_calc(0, vec->table_reader_attrs, vec->table_writer_attrs, NULL, NULL);
+
+  return 0;
+}
+
+
+static int vector_map_tables(ri_vector_t *vec, const size_t reader_offsets[], const size_t writer_offsets[])
+{
+  for (unsigned i = 0; i < vec->n_table_readers; i++) {
+    vec->table_readers[i] = ri_table_map(&vec->table_reader_attrs[i], false, vec->shm, reader_offsets[i], vec->arena);
+    if (!vec->table_readers[i])
+      return -ENOMEM;
+  }
+
+  for (unsigned i = 0; i < vec->n_table_writers; i++) {
+    vec->table_writers[i] = ri_table_map(&vec->table_writer_attrs[i], true, vec->shm, writer_offsets[i], vec->arena);
+    if (!vec->table_writers[i])
+      return -ENOMEM;
+  }
+
+  return 0;
+}
+
+
+/* the epochs of both sides follow everything else, each on its own cacheline */
+static size_t layout_epochs(size_t offset, size_t *epoch_offset)
+{
+  *epoch_offset = cacheline_aligned(offset);
+
+  return *epoch_offset + 2 * cacheline_size();
+}
+
+
+static void vector_set_epochs(ri_vector_t *vec, size_t epoch_offset, bool first)
+{
+  _Atomic uint64_t *first_epoch = ri_shm_ptr(vec->shm, epoch_offset);
+  _Atomic uint64_t *second_epoch = ri_shm_ptr(vec->shm, epoch_offset + cacheline_size());
+
+  vec->tx_epoch = first ? first_epoch : second_epoch;
+  vec->rx_epoch = first ? second_epoch : first_epoch;
+  vec->epoch = atomic_load_explicit(vec->tx_epoch, memory_order_relaxed);
+}
+
+
+static ri_shm_t* shm_new(ri_arena_t *arena, size_t shm_size)
 {
+  void *storage = ri_arena_alloc(arena, ri_shm_storage_size());
+  if (!storage)
+    goto fail_storage;
+
   int shmfd = ri_shmfd_create(shm_size);
   if (shmfd < 0)
     goto fail_fd;
 
-  ri_shm_t *shm = ri_shm_map(shmfd);
+  ri_shm_t *shm = ri_shm_map_init(shmfd, storage);
 
   if (!shm)
     goto fail_shm;
@@ -206,67 +495,199 @@ static ri_shm_t* shm_new(size_t shm_size)
 fail_shm:
   close(shmfd);
 fail_fd:
+fail_storage:
   return NULL;
 }
 
 
-ri_vector_t* ri_vector_new(const ri_config_t *config)
+static void vector_set_consumer_heads(ri_vector_t *vec, const ri_channel_layout_t *layouts)
+{
+  if ((vec->layout != RI_LAYOUT_SPLIT) || (vec->n_consumers == 0))
+    return;
+
+  vec->consumer_heads = ri_shm_ptr(vec->shm, layouts[0].head);
+}
+
+
+static int vector_describe_channels(ri_vector_t *vec, const ri_config_t *config,
+                                   const ri_channel_layout_t *consumer_layouts,
+                                   const ri_channel_layout_t *producer_layouts)
+{
+  unsigned n_channels = vec->n_consumers + vec->n_producers;
+
+  vec->channel_infos = ri_arena_alloc(vec->arena, n_channels * sizeof(ri_channel_layout_info_t));
+  if (!vec->channel_infos)
+    return -ENOMEM;
+
+  ri_channel_layout_info_t *producer_infos = &vec->channel_infos[vec->n_consumers];
+
+  for (unsigned i = 0; i < vec->n_consumers; i++)
+    ri_layout_describe(&config->consumers[i], &consumer_layouts[i], &vec->channel_infos[i]);
+
+  for (unsigned i = 0; i < vec->n_producers; i++)
+    ri_layout_describe(&config->producers[i], &producer_layouts[i], &producer_infos[i]);
+
+  return 0;
+}
+
+
+static ri_vector_t* vector_new(const ri_config_t *config, void *storage, size_t storage_size)
 {
   unsigned n_producers = ri_count_channels(config->producers);
   unsigned n_consumers = ri_count_channels(config->consumers);
 
-  ri_vector_t *vec = ri_vector_alloc(n_consumers, n_producers, &config->info);
+  ri_arena_t *arena = vector_arena_new(config, storage, storage_size);
+  if (!arena)
+    goto fail_arena;
+
+  ri_vector_t *vec = ri_vector_alloc(arena, n_consumers, n_producers, &config->info, config->layout);
   if (!vec)
     goto fail_alloc;
 
-  size_t shm_size = ri_calc_shm_size(config->consumers, config->producers);
+  ri_channel_layout_t *layouts = ri_arena_alloc(arena, (n_consumers + n_producers + 1) * sizeof(ri_channel_layout_t));
+  if (!layouts)
+    goto fail_layouts;
 
-  vec->shm = shm_new(shm_size);
-  if (!vec->shm)
+  ri_channel_layout_t *producer_layouts = &layouts[0];
+  ri_channel_layout_t *consumer_layouts = &layouts[n_producers];
+
+  if (ri_layout_validate(vec->layout) < 0) {
+    LOG_ERR("invalid vector layout=%d", vec->layout);
+    goto fail_shm;
+  }
+
+  /* 0 without channels, e.g. for a vector holding only a barrier */
+  size_t shm_size = ri_layout_calc(vec->layout, config->producers, config->consumers,
+                                   producer_layouts, consumer_layouts);
+
+  if (vector_describe_channels(vec, config, consumer_layouts, producer_layouts) < 0)
+    goto fail_shm;
+
+  if (vector_alloc_streams(vec, config) < 0)
+    goto fail_shm;
+
+  size_t *stream_offsets = ri_arena_alloc(arena, (vec->n_readers + vec->n_writers + 2) * sizeof(size_t));
+  if (!stream_offsets)
+    goto fail_shm;
+
+  size_t *reader_offsets = &stream_offsets[0];
+  size_t *writer_offsets = &stream_offsets[vec->n_readers + 1];
+
+  /* our writers come first, like our producers */
+  shm_size = ri_stream_layout_calc(shm_size, config->stream_writers, config->stream_readers,
+                                   writer_offsets, reader_offsets);
+
+  if (vector_alloc_tables(vec, config) < 0)
     goto fail_shm;
 
-  size_t shm_offset = 0;
+  size_t *table_offsets = ri_arena_alloc(arena, (vec->n_table_readers + vec->n_table_writers + 2) * sizeof(size_t));
+  if (!table_offsets)
+    goto fail_shm;
+
+  size_t *table_reader_offsets = &table_offsets[0];
+  size_t *table_writer_offsets = &table_offsets[vec->n_table_readers + 1];
+
+  shm_size = ri_table_layout_calc(shm_size, config->table_writers, config->table_readers,
+                                  table_writer_offsets, table_reader_offsets);
+
+  size_t epoch_offset;
+
+  shm_size = layout_epochs(shm_size, &epoch_offset);
+
+  if (config->barrier_participants > RI_MAX_BARRIER_PARTICIPANTS) {
+    LOG_ERR("too many barrier participants %u", config->barrier_participants);
+    goto fail_shm;
+  }
+
+  vec->barrier_participants = config->barrier_participants;
 
+  if (vec->barrier_participants > 0) {
+    vec->barriers = ri_barrier_alloc(arena, vec->barrier_participants);
+    if (!vec->barriers)
+      goto fail_shm;
+  }
+
+  shm_size = ri_barrier_layout_calc(shm_size, vec->barrier_participants, &vec->barrier_offset);
+
+  vec->shm = shm_new(arena, shm_size);
+  if (!vec->shm)
+    goto fail_shm;
+
+  /* our producers are the first channels */
+  vector_set_epochs(vec, epoch_offset, true);
 
   for (unsigned i = 0; i < vec->n_producers; i++) {
     const ri_attr_t *attr = &config->producers[i];
 
-    vec->producers[i] = ri_producer_new(attr, vec->shm, shm_offset);
+    vec->producers[i] = ri_producer_new(attr, vec->shm, &producer_layouts[i], arena);
     if (!vec->producers[i])
       goto fail_channel;
 
-    shm_offset += ri_channel_shm_size(attr);
+    vec->created[i] = vec->producers[i];
   }
 
   for (unsigned i = 0; i < vec->n_consumers; i++) {
     const ri_attr_t *attr = &config->consumers[i];
 
-    vec->consumers[i] = ri_consumer_new(attr, vec->shm, shm_offset);
+    vec->consumers[i] = ri_consumer_new(attr, vec->shm, &consumer_layouts[i], arena);
     if (!vec->consumers[i])
       goto fail_channel;
-
-    shm_offset += ri_channel_shm_size(attr);
   }
 
+  if (vector_map_streams(vec, reader_offsets, writer_offsets) < 0)
+    goto fail_channel;
+
+  if (vector_map_tables(vec, table_reader_offsets, table_writer_offsets) < 0)
+    goto fail_channel;
+
+  vector_set_consumer_heads(vec, consumer_layouts);
+
   return vec;
 
 fail_channel:
 fail_shm:
+fail_layouts:
   ri_vector_delete(vec);
+  return NULL;
 fail_alloc:
+  ri_arena_unref(arena);
+fail_arena:
   return NULL;
 }
 
 
+ri_vector_t* ri_vector_new(const ri_config_t *config)
+{
+  return vector_new(config, NULL, 0);
+}
+
+
+ri_vector_t* ri_vector_init(const ri_config_t *config, void *storage, size_t size)
+{
+  if (!storage)
+    return NULL;
+
+  return vector_new(config, storage, size);
+}
+
+
+size_t ri_vector_storage_size(const ri_config_t *config)
+{
+  return ri_arena_storage_size(vector_arena_size(config));
+}
+
+
 void ri_vector_delete(ri_vector_t* vec)
 {
+  /* vec itself lives in the arena */
+  ri_arena_t *arena = vec->arena;
+
   if (vec->consumers) {
     for (unsigned i = 0; i < vec->n_consumers; i++) {
       if (vec->consumers[i]) {
         ri_consumer_delete(vec->consumers[i]);
       }
     }
-    free(vec->consumers);
   }
 
   if (vec->producers) {
@@ -275,13 +696,23 @@ void ri_vector_delete(ri_vector_t* vec)
         ri_producer_delete(vec->producers[i]);
       }
     }
-    free(vec->producers);
+  }
+
+  for (unsigned i = 0; i < vec->n_readers + vec->n_writers; i++) {
+    /* writers follow the readers in the same array */
+    if (vec->readers[i])
+      ri_stream_delete(vec->readers[i]);
+  }
+
+  for (unsigned i = 0; i < vec->n_table_readers + vec->n_table_writers; i++) {
+    if (vec->table_readers[i])
+      ri_table_delete(vec->table_readers[i]);
   }
 
   if (vec->shm)
     ri_shm_unref(vec->shm);
 
-  free(vec);
+  ri_arena_unref(arena);
 }
 
 
@@ -295,7 +726,7 @@ size_t ri_vector_serialize_size(const ri_vector_t *vec)
 
   size_t size = ri_request_calc_size(&config);
 
-  free(attrs);
+  ri_free(attrs);
 
   return size;
 }
@@ -320,7 +751,8 @@ int ri_vector_serialize(const ri_vector_t *vec, void* req, size_t size, int fds[
 }
 
 
-static ri_vector_t* ri_vector_map(const ri_config_t *config, int fds[], unsigned *n_fds)
+static ri_vector_t* ri_vector_map(const ri_config_t *config, int fds[], unsigned *n_fds,
+                                  void *storage, size_t storage_size)
 {
   if (!fds || !n_fds || (*n_fds < 1))
     goto fail_args;
@@ -329,23 +761,104 @@ static ri_vector_t* ri_vector_map(const ri_config_t *config, int fds[], unsigned
   unsigned n_consumers = ri_count_channels(config->consumers);
   unsigned n_producers = ri_count_channels(config->producers);
 
-  ri_vector_t *vec = ri_vector_alloc(n_consumers, n_producers, &config->info);
+  ri_arena_t *arena = vector_arena_new(config, storage, storage_size);
+  if (!arena)
+    goto fail_arena;
+
+  ri_vector_t *vec = ri_vector_alloc(arena, n_consumers, n_producers, &config->info, config->layout);
   if (!vec)
     goto fail_alloc;
 
+  ri_channel_layout_t *layouts = ri_arena_alloc(arena, (n_consumers + n_producers + 1) * sizeof(ri_channel_layout_t));
+  if (!layouts)
+    goto fail_layouts;
+
+  ri_channel_layout_t *consumer_layouts = &layouts[0];
+  ri_channel_layout_t *producer_layouts = &layouts[n_consumers];
+
+  /* the client's producers are our consumers */
+  if (ri_layout_validate(vec->layout) < 0) {
+    LOG_ERR("invalid vector layout=%d", vec->layout);
+    goto fail_shm;
+  }
+
+  /* 0 without channels, e.g. for a vector holding only a barrier */
+  size_t shm_size = ri_layout_calc(vec->layout, config->consumers, config->producers,
+                                   consumer_layouts, producer_layouts);
+
+  if (vector_describe_channels(vec, config, consumer_layouts, producer_layouts) < 0)
+    goto fail_shm;
+
+  if (vector_alloc_streams(vec, config) < 0)
+    goto fail_shm;
+
+  size_t *stream_offsets = ri_arena_alloc(arena, (vec->n_readers + vec->n_writers + 2) * sizeof(size_t));
+  if (!stream_offsets)
+    goto fail_shm;
+
+  size_t *reader_offsets = &stream_offsets[0];
+  size_t *writer_offsets = &stream_offsets[vec->n_readers + 1];
+
+  /* the client's writers are our readers */
+  shm_size = ri_stream_layout_calc(shm_size, config->stream_readers, config->stream_writers,
+                                   reader_offsets, writer_offsets);
+
+  if (vector_alloc_tables(vec, config) < 0)
+    goto fail_shm;
+
+  size_t *table_offsets = ri_arena_alloc(arena, (vec->n_table_readers + vec->n_table_writers + 2) * sizeof(size_t));
+  if (!table_offsets)
+    goto fail_shm;
+
+  size_t *table_reader_offsets = &table_offsets[0];
+  size_t *table_writer_offsets = &table_offsets[vec->n_table_readers + 1];
+
+  shm_size = ri_table_layout_calc(shm_size, config->table_readers, config->table_writers,
+                                  table_reader_offsets, table_writer_offsets);
+
+  size_t epoch_offset;
+
+  shm_size = layout_epochs(shm_size, &epoch_offset);
+
+  if (config->barrier_participants > RI_MAX_BARRIER_PARTICIPANTS) {
+    LOG_ERR("too many barrier participants %u", config->barrier_participants);
+    goto fail_shm;
+  }
+
+  vec->barrier_participants = config->barrier_participants;
+
+  if (vec->barrier_participants > 0) {
+    vec->barriers = ri_barrier_alloc(arena, vec->barrier_participants);
+    if (!vec->barriers)
+      goto fail_shm;
+  }
+
+  shm_size = ri_barrier_layout_calc(shm_size, vec->barrier_participants, &vec->barrier_offset);
+
   int r = ri_memfd_verify(fds[0]);
   if (r < 0)
     goto fail_shm;
 
-  vec->shm = ri_shm_map(fds[0]);
+  void *shm_storage = ri_arena_alloc(arena, ri_shm_storage_size());
+  if (!shm_storage)
+    goto fail_shm;
+
+  vec->shm = ri_shm_map_init(fds[0], shm_storage);
   if (!vec->shm)
     goto fail_shm;
 
   /* ownership of shmfd transfered to shm */
   fds[0] = -1;
 
+  if (ri_shm_size(vec->shm) < shm_size) {
+    LOG_ERR("shared memory too small %zu < %zu", ri_shm_size(vec->shm), shm_size);
+    goto fail_channel;
+  }
+
+  /* the client's producers are the first channels */
+  vector_set_epochs(vec, epoch_offset, false);
+
   unsigned idx = 1;
-  size_t shm_offset = 0;
 
   for (unsigned i = 0; i < vec->n_consumers; i++) {
     const ri_attr_t *attr = &config->consumers[i];
@@ -356,14 +869,13 @@ static ri_vector_t* ri_vector_map(const ri_config_t *config, int fds[], unsigned
         goto fail_channel;
     }
 
-    vec->consumers[i] = ri_consumer_map(attr, eventfd, vec->shm, shm_offset);
+    vec->consumers[i] = ri_consumer_map(attr, eventfd, vec->shm, &consumer_layouts[i], arena);
 
     if (!vec->consumers[i])
       goto fail_channel;
 
     /* ownership of eventfd transfered to consumer */
     eventfd = -1;
-    shm_offset += ri_channel_shm_size(attr);
   }
 
   for (unsigned i = 0; i < vec->n_producers; i++) {
@@ -375,29 +887,43 @@ static ri_vector_t* ri_vector_map(const ri_config_t *config, int fds[], unsigned
         goto fail_channel;
     }
 
-    vec->producers[i] = ri_producer_map(attr, eventfd, vec->shm, shm_offset);
+    vec->producers[i] = ri_producer_map(attr, eventfd, vec->shm, &producer_layouts[i], arena);
     if (!vec->producers[i])
       goto fail_channel;
 
+    vec->created[i] = vec->producers[i];
+
     /* ownership of eventfd transfered to producer */
     eventfd = -1;
-    shm_offset += ri_channel_shm_size(attr);
   }
 
+  if (vector_map_streams(vec, reader_offsets, writer_offsets) < 0)
+    goto fail_channel;
+
+  if (vector_map_tables(vec, table_reader_offsets, table_writer_offsets) < 0)
+    goto fail_channel;
+
+  vector_set_consumer_heads(vec, consumer_layouts);
+
   return vec;
 
 fail_channel:
   if (eventfd >= 0)
     close(eventfd);
 fail_shm:
+fail_layouts:
   ri_vector_delete(vec);
+  return NULL;
 fail_alloc:
+  ri_arena_unref(arena);
+fail_arena:
 fail_args:
   return NULL;
 }
 
 
-ri_vector_t* ri_vector_deserialize(const void* req, size_t size, int fds[], unsigned *n_fds)
+static ri_vector_t* vector_deserialize(const void* req, size_t size, int fds[], unsigned *n_fds,
+                                       void *storage, size_t storage_size)
 {
   if (!n_fds || (*n_fds < 1))
     return NULL;
@@ -407,14 +933,30 @@ ri_vector_t* ri_vector_deserialize(const void* req, size_t size, int fds[], unsi
   if (!attrs)
     return NULL;
 
-  ri_vector_t *vec = ri_vector_map(&config, fds, n_fds);
+  ri_vector_t *vec = ri_vector_map(&config, fds, n_fds, storage, storage_size);
 
-  free(attrs);
+  ri_free(attrs);
 
   return vec;
 }
 
 
+ri_vector_t* ri_vector_deserialize(const void* req, size_t size, int fds[], unsigned *n_fds)
+{
+  return vector_deserialize(req, size, fds, n_fds, NULL, 0);
+}
+
+
+ri_vector_t* ri_vector_deserialize_init(const void* req, size_t size, int fds[], unsigned *n_fds,
+                                        void *storage, size_t storage_size)
+{
+  if (!storage)
+    return NULL;
+
+  return vector_deserialize(req, size, fds, n_fds, storage, storage_size);
+}
+
+
 unsigned ri_vector_num_producers(const ri_vector_t *vec)
 {
   return vec->n_producers;
@@ -438,11 +980,8 @@ ri_info_t ri_vector_get_info(const ri_vector_t* vec)
 
 void ri_vector_free_info(ri_vector_t* vec)
 {
-  if (vec->info.data) {
-    free(vec->info.data);
-    vec->info.data = NULL;
-    vec->info.size = 0;
-  }
+  vec->info.data = NULL;
+  vec->info.size = 0;
 }
 
 
@@ -470,3 +1009,323 @@ ri_consumer_t* ri_vector_take_consumer(ri_vector_t *vec, unsigned index)
 
   return consumer;
 }
+
+
+ri_stream_t* ri_vector_take_stream_reader(ri_vector_t *vec, unsigned index)
+{
+  if (index >= vec->n_readers)
+    return NULL;
+
+  ri_stream_t *stream = vec->readers[index];
+
+  vec->readers[index] = NULL;
+
+  return stream;
+}
+
+
+ri_stream_t* ri_vector_take_stream_writer(ri_vector_t *vec, unsigned index)
+{
+  if (index >= vec->n_writers)
+    return NULL;
+
+  ri_stream_t *stream = vec->writers[index];
+
+  vec->writers[index] = NULL;
+
+  return stream;
+}
+
+
+unsigned ri_vector_num_stream_readers(const ri_vector_t *vec)
+{
+  return vec->n_readers;
+}
+
+
+unsigned ri_vector_num_stream_writers(const ri_vector_t *vec)
+{
+  return vec->n_writers;
+}
+
+
+ri_table_t* ri_vector_take_table_reader(ri_vector_t *vec, unsigned index)
+{
+  if (index >= vec->n_table_readers)
+    return NULL;
+
+  ri_table_t *table = vec->table_readers[index];
+
+  vec->table_readers[index] = NULL;
+
+  return table;
+}
+
+
+ri_table_t* ri_vector_take_table_writer(ri_vector_t *vec, unsigned index)
+{
+  if (index >= vec->n_table_writers)
+    return NULL;
+
+  ri_table_t *table = vec->table_writers[index];
+
+  vec->table_writers[index] = NULL;
+
+  return table;
+}
+
+
+unsigned ri_vector_num_table_readers(const ri_vector_t *vec)
+{
+  return vec->n_table_readers;
+}
+
+
+unsigned ri_vector_num_table_writers(const ri_vector_t *vec)
+{
+  return vec->n_table_writers;
+}
+
+
+static bool vector_created(const ri_vector_t *vec, const ri_producer_t *producer)
+{
+  for (unsigned i = 0; i < vec->n_producers; i++) {
+    if (vec->created[i] == producer)
+      return true;
+  }
+
+  return false;
+}
+
+
+int ri_vector_tx_stage(ri_vector_t *vec, ri_producer_t *producer)
+{
+  /* the epoch of another vector doesn't cover its pushes */
+  if (!producer || !vector_created(vec, producer))
+    return -EINVAL;
+
+  for (unsigned i = 0; i < vec->n_staged; i++) {
+    if (vec->staged[i] == producer)
+      return -EALREADY;
+  }
+
+  if (vec->n_staged >= vec->n_producers)
+    return -ENOSPC;
+
+  vec->staged[vec->n_staged++] = producer;
+
+  return 0;
+}
+
+
+void ri_vector_tx_abort(ri_vector_t *vec)
+{
+  vec->n_staged = 0;
+}
+
+
+int ri_vector_tx_commit(ri_vector_t *vec)
+{
+  int r = 0;
+
+  /* odd while the staged messages are pushed, the fence orders it before
+   * the heads, so a consumer that sees one of them sees the odd epoch */
+  atomic_store_explicit(vec->tx_epoch, vec->epoch + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  for (unsigned i = 0; i < vec->n_staged; i++) {
+    if (ri_producer_force_push(vec->staged[i]) == RI_FORCE_PUSH_RESULT_ERROR)
+      r = -EIO;
+  }
+
+  vec->epoch += 2;
+  atomic_store_explicit(vec->tx_epoch, vec->epoch, memory_order_release);
+
+  vec->n_staged = 0;
+
+  return r;
+}
+
+
+int ri_vector_pop_consistent(ri_vector_t *vec, ri_consumer_t *consumers[], unsigned n, uint64_t *epoch)
+{
+  bool updated = false;
+
+  for (unsigned attempt = 0; attempt < RI_VECTOR_TX_ATTEMPTS; attempt++) {
+    uint64_t before = atomic_load_explicit(vec->rx_epoch, memory_order_acquire);
+
+    if (before & 1)
+      continue;
+
+    /* consumers that got the newest message already keep it */
+    for (unsigned i = 0; i < n; i++) {
+      ri_index_t current = ri_consumer_current(consumers[i]);
+
+      if (ri_consumer_flush(consumers[i]) == RI_POP_RESULT_ERROR)
+        return -EIO;
+
+      /* the held slot isn't reused, so a new message has another index */
+      if (ri_consumer_current(consumers[i]) != current)
+        updated = true;
+    }
+
+    uint64_t after = atomic_load_explicit(vec->rx_epoch, memory_order_acquire);
+
+    if (after == before) {
+      if (epoch)
+        *epoch = after / 2;
+
+      return updated ? 1 : 0;
+    }
+  }
+
+  return -EAGAIN;
+}
+
+
+ri_barrier_t* ri_vector_barrier(const ri_vector_t *vec, unsigned participant)
+{
+  if (vec->barrier_participants == 0)
+    return NULL;
+
+  return ri_barrier_map(vec->barriers, participant, vec->shm, vec->barrier_offset,
+                        vec->barrier_participants, vec->arena);
+}
+
+
+int ri_vector_poll_ready(const ri_vector_t *vec, uint64_t ready[], unsigned n_words)
+{
+  unsigned n = vec->n_consumers;
+
+  if ((size_t)n_words * RI_SIMD_MASK_BITS < n)
+    return -EINVAL;
+
+  memset(ready, 0, n_words * sizeof(ready[0]));
+
+  int n_ready = 0;
+
+  for (unsigned base = 0; base < n; base += RI_SIMD_MASK_BITS) {
+    unsigned len = n - base < RI_SIMD_MASK_BITS ? n - base : RI_SIMD_MASK_BITS;
+    ri_consumer_t **consumers = &vec->consumers[base];
+    uint64_t mask = 0;
+
+    if (vec->consumer_heads) {
+      ri_index_t current[RI_SIMD_MASK_BITS];
+      uint64_t owned = 0;
+      uint64_t lanes = 0;
+
+      for (unsigned i = 0; i < len; i++) {
+        current[i] = RI_INDEX_INVALID;
+
+        if (!consumers[i])
+          continue;
+
+        /* only the heads of lane 0 are packed */
+        if (ri_consumer_n_lanes(consumers[i]) > 1) {
+          if (ri_consumer_ready(consumers[i]))
+            lanes |= UINT64_C(1) << i;
+        } else {
+          current[i] = ri_consumer_current(consumers[i]);
+          owned |= UINT64_C(1) << i;
+        }
+      }
+
+      mask = (ri_simd_index_neq(&vec->consumer_heads[base], current, len) & owned) | lanes;
+    } else {
+      for (unsigned i = 0; i < len; i++) {
+        if (consumers[i] && ri_consumer_ready(consumers[i]))
+          mask |= UINT64_C(1) << i;
+      }
+    }
+
+    ready[base / RI_SIMD_MASK_BITS] = mask;
+    n_ready += __builtin_popcountll(mask);
+  }
+
+  return n_ready;
+}
+
+
+/* the message slots of every lane sit at the end of its queue */
+static int channel_resident(const ri_shm_t *shm, const ri_channel_layout_info_t *channel, size_t *resident)
+{
+  int r = ri_shm_resident(shm, channel->msgs_offset, channel->payload_size, resident);
+  if (r < 0)
+    return r;
+
+  if (channel->n_lanes < 2)
+    return 0;
+
+  size_t lane_size = channel->lanes_size / (channel->n_lanes - 1);
+
+  for (unsigned lane = 1; lane < channel->n_lanes; lane++) {
+    size_t offset = channel->lanes_offset + lane * lane_size - channel->payload_size;
+    size_t lane_resident;
+
+    r = ri_shm_resident(shm, offset, channel->payload_size, &lane_resident);
+    if (r < 0)
+      return r;
+
+    *resident += lane_resident;
+  }
+
+  return 0;
+}
+
+
+int ri_vector_layout(const ri_vector_t *vec, ri_vector_layout_info_t *info,
+                     ri_channel_layout_info_t consumers[],
+                     ri_channel_layout_info_t producers[])
+{
+  unsigned n_channels = vec->n_consumers + vec->n_producers;
+  size_t control_size = 0;
+  size_t payload_size = 0;
+
+  for (unsigned i = 0; i < n_channels; i++) {
+    ri_channel_layout_info_t channel = vec->channel_infos[i];
+
+    int r = channel_resident(vec->shm, &channel, &channel.resident);
+    if (r < 0)
+      return r;
+
+    control_size += channel.control_size;
+    payload_size += channel.n_lanes * channel.n_msgs * channel.msg_size + channel.blob_size;
+
+    if ((i < vec->n_consumers) && consumers)
+      consumers[i] = channel;
+    else if ((i >= vec->n_consumers) && producers)
+      producers[i - vec->n_consumers] = channel;
+  }
+
+  /* transaction epochs of both sides */
+  control_size += 2 * cacheline_size();
+
+  control_size += ri_barrier_shm_size(vec->barrier_participants);
+
+  if (!info)
+    return 0;
+
+  ri_shm_stat_t stat;
+
+  int r = ri_shm_stat(vec->shm, &stat);
+  if (r < 0)
+    return r;
+
+  size_t shm_size = ri_shm_size(vec->shm);
+
+  *info = (ri_vector_layout_info_t) {
+    .layout = vec->layout,
+    .shm_size = shm_size,
+    .control_size = control_size,
+    .payload_size = payload_size,
+    .stream_size = vec->stream_size,
+    .table_size = vec->table_size,
+    .padding = shm_size - control_size - payload_size - vec->stream_size - vec->table_size,
+    .storage_size = ri_arena_used(vec->arena),
+    .resident = stat.resident,
+    .locked = stat.locked,
+    .hugepage = stat.hugepage,
+  };
+
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include "watermark.h"
+
+#include "channel.h"
+#include "mem_utils.h"
+
+
+size_t ri_watermark_shm_size(const ri_attr_t *attr)
+{
+  if (!attr->watermark)
+    return 0;
+
+  /* the word is written by the consumer, the numbers by the producer */
+  return cacheline_aligned(sizeof(uint64_t)) +
+         cacheline_aligned(ri_channel_queue_len(attr) * sizeof(uint64_t));
+}
+
+
+void ri_watermark_init_shm(void *mem, const ri_attr_t *attr)
+{
+  _Atomic uint64_t *consumed = mem;
+  _Atomic uint64_t *seqs = mem_offset(mem, cacheline_size());
+
+  atomic_store_explicit(consumed, 0, memory_order_relaxed);
+
+  for (unsigned i = 0; i < ri_channel_queue_len(attr); i++)
+    atomic_store_explicit(&seqs[i], 0, memory_order_relaxed);
+}
+
+
+void ri_watermark_producer_init(ri_watermark_producer_t *watermark, void *mem)
+{
+  *watermark = (ri_watermark_producer_t) {
+    .consumed = mem,
+    .seqs = mem_offset(mem, cacheline_size()),
+  };
+}
+
+
+void ri_watermark_consumer_init(ri_watermark_consumer_t *watermark, void *mem)
+{
+  *watermark = (ri_watermark_consumer_t) {
+    .consumed = mem,
+    .seqs = mem_offset(mem, cacheline_size()),
+  };
+}
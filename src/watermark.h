@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtipc/rtipc.h"
+#include "index.h"
+
+/**
+ * Consumer progress of a channel with ri_attr_t.watermark set.
+ *
+ * The producer numbers its messages, starting with 1, and stores the
+ * number of every message in a per-slot array before the push publishes
+ * it. After every pop the consumer copies the number of its new message
+ * to the watermark word, which lives on a cacheline of its own, so the
+ * producer can calculate the lag without reading the queue's tail.
+ *
+ * The consumer always gets the oldest message not discarded yet (or the
+ * newest one with flush), so the difference of both numbers is exactly
+ * the number of queued messages once the consumer popped its first one.
+ * Before that it can exceed the capacity of the queue.
+ */
+
+typedef struct ri_watermark_producer {
+  _Atomic uint64_t *seqs;
+  const _Atomic uint64_t *consumed;
+  /* messages pushed so far, the number of the latest one */
+  uint64_t pushed;
+} ri_watermark_producer_t;
+
+
+typedef struct ri_watermark_consumer {
+  const _Atomic uint64_t *seqs;
+  _Atomic uint64_t *consumed;
+} ri_watermark_consumer_t;
+
+
+/* watermark word followed by the per-slot numbers, 0 if disabled */
+size_t ri_watermark_shm_size(const ri_attr_t *attr);
+
+void ri_watermark_init_shm(void *mem, const ri_attr_t *attr);
+
+void ri_watermark_producer_init(ri_watermark_producer_t *watermark, void *mem);
+
+void ri_watermark_consumer_init(ri_watermark_consumer_t *watermark, void *mem);
+
+
+static inline bool ri_watermark_enabled(const ri_watermark_producer_t *watermark)
+{
+  return watermark->seqs != NULL;
+}
+
+
+/* numbers the message in slot, called before it is pushed */
+static inline void ri_watermark_stamp(const ri_watermark_producer_t *watermark, ri_index_t slot)
+{
+  /* published with the chain, head and tail updates of the push */
+  atomic_store_explicit(&watermark->seqs[slot], watermark->pushed + 1, memory_order_relaxed);
+}
+
+
+/* the consumer got the message in slot */
+static inline void ri_watermark_consume(const ri_watermark_consumer_t *watermark, ri_index_t slot)
+{
+  uint64_t seq = atomic_load_explicit(&watermark->seqs[slot], memory_order_relaxed);
+
+  atomic_store_explicit(watermark->consumed, seq, memory_order_relaxed);
+}
+
+
+static inline uint64_t ri_watermark_consumed(const ri_watermark_producer_t *watermark)
+{
+  return atomic_load_explicit(watermark->consumed, memory_order_relaxed);
+}
+
+
+/* number of the message in slot, read by the consumer */
+static inline uint64_t ri_watermark_seq(const ri_watermark_consumer_t *watermark, ri_index_t slot)
+{
+  return atomic_load_explicit(&watermark->seqs[slot], memory_order_relaxed);
+}
+
+
+static inline uint64_t ri_watermark_last(const ri_watermark_consumer_t *watermark)
+{
+  return atomic_load_explicit(watermark->consumed, memory_order_relaxed);
+}
+
+
+/* messages published after the consumer's latest one */
+static inline unsigned ri_watermark_queued(uint64_t pushed, uint64_t consumed, unsigned capacity)
+{
+  /* both numbers are read at different times and may overtake each other */
+  if (consumed >= pushed)
+    return 0;
+
+  return pushed - consumed < capacity ? pushed - consumed : capacity;
+}